@@ -0,0 +1,160 @@
+#!/usr/bin/env node
+/**
+ * Benchmark the built WASM package (run `npm run build` first)
+ *
+ * Usage:
+ *   node scripts/bench.mjs [--iterations N] [--filter REGEX] [--out FILE]
+ *                          [--no-simd] [--variant NAME] [--browser]
+ *
+ * Results are written as JSON (to stdout, or FILE with --out) so runs can
+ * be compared between releases. --browser runs the same suite in headless
+ * Chrome through puppeteer, which must be installed separately.
+ */
+
+import { createServer } from 'http';
+import { existsSync, readFileSync, writeFileSync } from 'fs';
+import { dirname, extname, join, normalize } from 'path';
+import { fileURLToPath, pathToFileURL } from 'url';
+import { runSuite } from './bench/suite.mjs';
+
+const __dirname = dirname(fileURLToPath(import.meta.url));
+const rootDir = join(__dirname, '..');
+const entry = join(rootDir, 'dist', 'index.js');
+
+function parseArgs(argv) {
+  const args = { iterations: 5, filter: null, out: null, simd: undefined, variant: undefined, browser: false };
+  for (let i = 0; i < argv.length; i++) {
+    switch (argv[i]) {
+      case '--iterations':
+        args.iterations = Number(argv[++i]);
+        break;
+      case '--filter':
+        args.filter = new RegExp(argv[++i]);
+        break;
+      case '--out':
+        args.out = argv[++i];
+        break;
+      case '--no-simd':
+        args.simd = false;
+        break;
+      case '--variant':
+        args.variant = argv[++i];
+        break;
+      case '--browser':
+        args.browser = true;
+        break;
+      default:
+        console.error(`Unknown option: ${argv[i]}`);
+        process.exit(1);
+    }
+  }
+  return args;
+}
+
+/**
+ * Bind the module options to every factory the suite calls, so one
+ * variant is measured end to end
+ */
+function withOptions(lib, extra) {
+  return {
+    ...lib,
+    createLittleFS: (options = {}) => lib.createLittleFS({ ...extra, ...options }),
+    createLittleFSFromImage: (image, options = {}) => lib.createLittleFSFromImage(image, { ...extra, ...options }),
+  };
+}
+
+async function runNode(args) {
+  const lib = await import(pathToFileURL(entry).href);
+  const results = await runSuite(withOptions(lib, { simd: args.simd, variant: args.variant }), {
+    iterations: args.iterations,
+    filter: args.filter,
+    log: (line) => console.error(line),
+  });
+  return { runtime: `node ${process.version}`, results };
+}
+
+const MIME = { '.js': 'text/javascript', '.mjs': 'text/javascript', '.wasm': 'application/wasm', '.html': 'text/html' };
+
+async function runBrowser(args) {
+  let puppeteer;
+  try {
+    puppeteer = (await import('puppeteer')).default;
+  } catch {
+    console.error('--browser needs puppeteer: npm install --no-save puppeteer');
+    process.exit(1);
+  }
+
+  // Serve the repository so the page can import dist/ and the suite
+  const server = createServer((req, res) => {
+    const pathname = decodeURIComponent(new URL(req.url, 'http://x').pathname);
+    if (pathname === '/') {
+      res.writeHead(200, { 'Content-Type': 'text/html' }).end('<!doctype html><title>littlefs-wasm bench</title>');
+      return;
+    }
+    const path = normalize(join(rootDir, pathname));
+    if (!path.startsWith(rootDir) || !existsSync(path)) {
+      res.writeHead(404).end();
+      return;
+    }
+    res.writeHead(200, { 'Content-Type': MIME[extname(path)] ?? 'application/octet-stream' });
+    res.end(readFileSync(path));
+  });
+  await new Promise((resolve) => server.listen(0, '127.0.0.1', resolve));
+  const origin = `http://127.0.0.1:${server.address().port}`;
+
+  const browser = await puppeteer.launch({ headless: true });
+  try {
+    const page = await browser.newPage();
+    page.on('console', (msg) => console.error(msg.text()));
+    await page.goto(`${origin}/`);
+    const results = await page.evaluate(
+      async (origin, iterations, filter, simd, variant) => {
+        const lib = await import(`${origin}/dist/index.js`);
+        const { runSuite } = await import(`${origin}/scripts/bench/suite.mjs`);
+        const bound = {
+          ...lib,
+          createLittleFS: (o = {}) => lib.createLittleFS({ simd, variant, ...o }),
+          createLittleFSFromImage: (img, o = {}) => lib.createLittleFSFromImage(img, { simd, variant, ...o }),
+        };
+        return runSuite(bound, {
+          iterations,
+          filter: filter ? new RegExp(filter) : undefined,
+          log: (line) => console.log(line),
+        });
+      },
+      origin,
+      args.iterations,
+      args.filter?.source ?? null,
+      args.simd,
+      args.variant
+    );
+    return { runtime: await browser.version(), results };
+  } finally {
+    await browser.close();
+    server.close();
+  }
+}
+
+const args = parseArgs(process.argv.slice(2));
+if (!existsSync(entry)) {
+  console.error('dist/index.js not found - run `npm run build` first');
+  process.exit(1);
+}
+
+const pkg = JSON.parse(readFileSync(join(rootDir, 'package.json'), 'utf8'));
+const run = args.browser ? await runBrowser(args) : await runNode(args);
+const report = {
+  package: `${pkg.name}@${pkg.version}`,
+  date: new Date().toISOString(),
+  simd: args.simd ?? 'auto',
+  variant: args.variant ?? 'auto',
+  ...run,
+};
+
+const json = JSON.stringify(report, null, 2);
+if (args.out) {
+  writeFileSync(args.out, json + '\n');
+  console.error(`Wrote ${args.out}`);
+} else {
+  console.log(json);
+}
@@ -0,0 +1,335 @@
+/**
+ * LittleFS WASM benchmark cases
+ *
+ * Runs unchanged in Node and in a browser page: `lib` is the package entry
+ * point (dist/index.js). The vendor cases mirror vendor/littlefs/benches
+ * (same ORDER/N/SIZE/CHUNK_SIZE defines and PRNG) but go through the public
+ * JS API, so they include call overhead, string marshalling and copies.
+ */
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+// Geometry of the vendor bench runner: 1 MiB disk, 64-byte caches
+const BENCH_GEOMETRY = {
+  blockSize: 4096,
+  blockCount: 256,
+  cacheSize: 64,
+  lookaheadSize: 16,
+  blockCycles: -1,
+};
+
+const ORDERS = ['in-order', 'reversed-order', 'random-order'];
+
+const now = () => performance.now();
+
+/**
+ * xorshift32, identical to bench_prng in vendor/littlefs/runners/bench_runner.c
+ */
+function prng(state) {
+  let x = state.value;
+  x ^= x << 13;
+  x >>>= 0;
+  x ^= x >>> 17;
+  x ^= x << 5;
+  x >>>= 0;
+  state.value = x;
+  return x;
+}
+
+function fillChunk(buffer, seed) {
+  const state = { value: seed >>> 0 };
+  for (let i = 0; i < buffer.length; i++) buffer[i] = prng(state) & 0xff;
+  return buffer;
+}
+
+function orderIndex(order, i, n, state) {
+  if (order === 0) return i;
+  if (order === 1) return n - 1 - i;
+  return prng(state) % n;
+}
+
+const fileName = (prefix, i) => `${prefix}${i.toString(16).padStart(8, '0')}`;
+
+async function createFiles(lib, count, fileSize, options = BENCH_GEOMETRY) {
+  const fs = await lib.createLittleFS({ ...options, formatOnInit: true });
+  const chunk = new Uint8Array(fileSize);
+  for (let i = 0; i < count; i++) {
+    fs.writeFile(fileName('file', i), fillChunk(chunk, i).slice());
+  }
+  return fs;
+}
+
+function summarize(samples) {
+  const sorted = [...samples].sort((a, b) => a - b);
+  const mean = samples.reduce((sum, v) => sum + v, 0) / samples.length;
+  return {
+    min: sorted[0],
+    median: sorted[Math.floor(sorted.length / 2)],
+    mean,
+    max: sorted[sorted.length - 1],
+  };
+}
+
+// ============================================================================
+// Cases
+// ============================================================================
+
+/**
+ * Each case returns the measured milliseconds for one iteration; setup and
+ * teardown happen outside the timed region, as BENCH_START/BENCH_STOP do.
+ */
+const CASES = [];
+
+function define(name, defines, fn) {
+  CASES.push({ name, defines, fn });
+}
+
+const FILE_SIZE_128K = 128 * 1024;
+
+for (const order of [0, 1, 2]) {
+  define('bench_file_read', { ORDER: order, SIZE: FILE_SIZE_128K, CHUNK_SIZE: 64 }, async (lib, d) => {
+    const fs = await lib.createLittleFS({ ...BENCH_GEOMETRY, formatOnInit: true });
+    const chunks = Math.ceil(d.SIZE / d.CHUNK_SIZE);
+    const buffer = new Uint8Array(d.CHUNK_SIZE);
+    const writer = fs.openFile('file', 'w');
+    for (let i = 0; i < chunks; i++) writer.write(fillChunk(buffer, i));
+    writer.close();
+
+    const start = now();
+    const file = fs.openFile('file', 'r');
+    const state = { value: 42 };
+    for (let i = 0; i < chunks; i++) {
+      const index = orderIndex(d.ORDER, i, chunks, state);
+      file.seek(index * d.CHUNK_SIZE);
+      file.read(buffer);
+    }
+    file.close();
+    const ms = now() - start;
+    fs.destroy();
+    return ms;
+  });
+
+  define('bench_file_write', { ORDER: order, SIZE: FILE_SIZE_128K, CHUNK_SIZE: 64 }, async (lib, d) => {
+    const fs = await lib.createLittleFS({ ...BENCH_GEOMETRY, formatOnInit: true });
+    const chunks = Math.ceil(d.SIZE / d.CHUNK_SIZE);
+    const buffer = new Uint8Array(d.CHUNK_SIZE);
+
+    const start = now();
+    const file = fs.openFile('file', 'w');
+    const state = { value: 42 };
+    for (let i = 0; i < chunks; i++) {
+      const index = orderIndex(d.ORDER, i, chunks, state);
+      file.seek(index * d.CHUNK_SIZE);
+      file.write(fillChunk(buffer, index));
+    }
+    file.close();
+    const ms = now() - start;
+    fs.destroy();
+    return ms;
+  });
+}
+
+for (const order of [0, 1, 2]) {
+  define('bench_dir_open', { ORDER: order, N: 1024, FILE_SIZE: 8 }, async (lib, d) => {
+    const fs = await createFiles(lib, d.N, d.FILE_SIZE);
+    const start = now();
+    const state = { value: 42 };
+    for (let i = 0; i < d.N; i++) {
+      fs.readFile(fileName('file', orderIndex(d.ORDER, i, d.N, state)));
+    }
+    const ms = now() - start;
+    fs.destroy();
+    return ms;
+  });
+
+  define('bench_dir_creat', { ORDER: order, N: 1024, FILE_SIZE: 8 }, async (lib, d) => {
+    const fs = await lib.createLittleFS({ ...BENCH_GEOMETRY, formatOnInit: true });
+    const chunk = new Uint8Array(d.FILE_SIZE);
+    const start = now();
+    const state = { value: 42 };
+    for (let i = 0; i < d.N; i++) {
+      const index = orderIndex(d.ORDER, i, d.N, state);
+      fs.writeFile(fileName('file', index), fillChunk(chunk, index));
+    }
+    const ms = now() - start;
+    fs.destroy();
+    return ms;
+  });
+
+  define('bench_dir_remove', { ORDER: order, N: 1024, FILE_SIZE: 8 }, async (lib, d) => {
+    const fs = await createFiles(lib, d.N, d.FILE_SIZE);
+    const start = now();
+    const state = { value: 42 };
+    for (let i = 0; i < d.N; i++) {
+      try {
+        fs.deleteFile(fileName('file', orderIndex(d.ORDER, i, d.N, state)));
+      } catch (error) {
+        // Random order repeats names, as in the vendor bench
+        if (error.code !== -2) throw error;
+      }
+    }
+    const ms = now() - start;
+    fs.destroy();
+    return ms;
+  });
+
+  define('bench_dir_mkdir', { ORDER: order, N: 8 }, async (lib, d) => {
+    const fs = await lib.createLittleFS({ ...BENCH_GEOMETRY, formatOnInit: true });
+    const start = now();
+    const state = { value: 42 };
+    for (let i = 0; i < d.N; i++) {
+      try {
+        fs.mkdir(fileName('dir', orderIndex(d.ORDER, i, d.N, state)));
+      } catch (error) {
+        if (error.code !== -17) throw error;
+      }
+    }
+    const ms = now() - start;
+    fs.destroy();
+    return ms;
+  });
+}
+
+define('bench_dir_read', { N: 1024, FILE_SIZE: 8 }, async (lib, d) => {
+  const fs = await createFiles(lib, d.N, d.FILE_SIZE);
+  const start = now();
+  const entries = fs.list('/');
+  const ms = now() - start;
+  if (entries.length !== d.N) throw new Error(`bench_dir_read: listed ${entries.length} of ${d.N}`);
+  fs.destroy();
+  return ms;
+});
+
+for (const n of [0, 1024]) {
+  define('bench_superblocks_found', { N: n, FILE_SIZE: 8 }, async (lib, d) => {
+    const source = await createFiles(lib, d.N, d.FILE_SIZE);
+    const image = source.toImage();
+    source.destroy();
+    const start = now();
+    const fs = await lib.createLittleFSFromImage(image, BENCH_GEOMETRY);
+    const ms = now() - start;
+    fs.destroy();
+    return ms;
+  });
+}
+
+define('bench_superblocks_missing', {}, async (lib) => {
+  const blank = new Uint8Array(BENCH_GEOMETRY.blockSize * BENCH_GEOMETRY.blockCount).fill(0xff);
+  const start = now();
+  try {
+    (await lib.createLittleFSFromImage(blank, BENCH_GEOMETRY)).destroy();
+    throw new Error('bench_superblocks_missing: blank image mounted');
+  } catch (error) {
+    if (error.code !== -84) throw error;
+  }
+  return now() - start;
+});
+
+define('bench_superblocks_format', {}, async (lib) => {
+  const start = now();
+  const fs = await lib.createLittleFS({ ...BENCH_GEOMETRY, formatOnInit: true });
+  const ms = now() - start;
+  fs.destroy();
+  return ms;
+});
+
+// ----------------------------------------------------------------------------
+// Real workloads
+// ----------------------------------------------------------------------------
+
+// 4 MB ESP32 partition with esp_littlefs settings
+const ESP32_4MB = { preset: 'esp-idf', blockSize: 4096, blockCount: 1024 };
+
+function webAssets(count, size) {
+  const files = [];
+  for (let i = 0; i < count; i++) {
+    const dir = `/www/${(i % 64).toString(16)}`;
+    files.push({ path: `${dir}/asset${i}.bin`, data: fillChunk(new Uint8Array(size), i) });
+  }
+  return files;
+}
+
+let esp32Image = null;
+async function esp32ImageFor(lib) {
+  if (!esp32Image) {
+    const fs = await lib.createLittleFS({ ...ESP32_4MB, formatOnInit: true });
+    fs.writeFiles(webAssets(400, 6 * 1024));
+    esp32Image = fs.toImage();
+    fs.destroy();
+  }
+  return esp32Image;
+}
+
+define('workload_mount_esp32_4mb', { SIZE: 4 * 1024 * 1024 }, async (lib) => {
+  const image = await esp32ImageFor(lib);
+  const start = now();
+  const fs = await lib.createLittleFSFromImage(image, ESP32_4MB);
+  const ms = now() - start;
+  fs.destroy();
+  return ms;
+});
+
+define('workload_list_10k', { N: 10000 }, async (lib, d) => {
+  const fs = await lib.createLittleFS({ blockSize: 4096, blockCount: 4096, formatOnInit: true });
+  fs.writeFiles(webAssets(d.N, 16));
+  const start = now();
+  const entries = fs.list('/');
+  const ms = now() - start;
+  if (entries.filter((e) => e.type === 'file').length !== d.N) {
+    throw new Error('workload_list_10k: wrong entry count');
+  }
+  fs.destroy();
+  return ms;
+});
+
+define('workload_bulk_build_5k', { N: 5000, FILE_SIZE: 512 }, async (lib, d) => {
+  const files = webAssets(d.N, d.FILE_SIZE);
+  const start = now();
+  const fs = await lib.createLittleFS({ blockSize: 4096, blockCount: 2048, formatOnInit: true });
+  fs.writeFiles(files);
+  const ms = now() - start;
+  fs.destroy();
+  return ms;
+});
+
+define('workload_export_esp32_4mb', { SIZE: 4 * 1024 * 1024 }, async (lib) => {
+  const fs = await lib.createLittleFSFromImage(await esp32ImageFor(lib), ESP32_4MB);
+  const start = now();
+  const image = fs.toImage();
+  const ms = now() - start;
+  if (image.length !== 4 * 1024 * 1024) throw new Error('workload_export_esp32_4mb: wrong size');
+  fs.destroy();
+  return ms;
+});
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+/**
+ * Run every case matching `filter` and return JSON-ready results
+ * @param lib Package entry point module
+ * @param options.iterations Timed runs per case (after one warm-up run)
+ * @param options.filter Optional RegExp on case names
+ * @param options.log Progress callback
+ */
+export async function runSuite(lib, { iterations = 5, filter, log = () => {} } = {}) {
+  const results = [];
+  for (const { name, defines, fn } of CASES) {
+    if (filter && !filter.test(name)) continue;
+
+    await fn(lib, defines); // warm-up: JIT, module instantiation, image caches
+    const samples = [];
+    for (let i = 0; i < iterations; i++) {
+      samples.push(await fn(lib, defines));
+    }
+
+    const ms = summarize(samples);
+    const label = 'ORDER' in defines ? `${name} (${ORDERS[defines.ORDER]})` : name;
+    log(`${label.padEnd(44)} ${ms.median.toFixed(3).padStart(10)} ms`);
+    results.push({ name, defines, iterations, ms });
+  }
+  return results;
+}
@@ -19,12 +19,11 @@ const rootDir = join(__dirname, '..');
 const vendorDir = join(rootDir, 'vendor', 'littlefs');
 const srcDir = join(rootDir, 'src', 'c');
 const buildDir = join(rootDir, 'build');
-const distDir = join(rootDir, 'dist', 'wasm');
+// Next to the compiled TS loader, which imports './littlefs.js'
+const distDir = join(rootDir, 'dist', 'littlefs');
 
-// Emscripten compiler settings
+// Emscripten compiler settings (optimization level is per variant)
 const EMCC_FLAGS = [
-  // Optimization
-  '-O3',
   '-flto',
   
   // LittleFS configuration
@@ -32,9 +31,11 @@ const EMCC_FLAGS = [
   '-DLFS_NAME_MAX=255',             // Default LittleFS (some ESP-IDF uses 64, but image shows 255)
   '-DLFS_FILE_MAX=2147483647',      // 2GB max file size
   '-DLFS_ATTR_MAX=1022',            // Default attr max
+  '-DLFS_SHRINKNONRELOCATING',      // lfs_fs_grow may shrink (lfs_wasm_resize)
   
   // Memory settings
-  '-s', 'INITIAL_MEMORY=4194304',     // 4MB initial memory
+  '-s', 'INITIAL_MEMORY=4194304',     // 4MB unless the loader passes a size for the first image
+  '-s', 'IMPORTED_MEMORY=1',           // Memory created in JS, so Module.INITIAL_MEMORY applies
   '-s', 'ALLOW_MEMORY_GROWTH=1',       // Allow growth
   '-s', 'MAXIMUM_MEMORY=67108864',     // 64MB max
   '-s', 'STACK_SIZE=65536',            // 64KB stack
@@ -42,16 +43,25 @@ const EMCC_FLAGS = [
   // Export settings
   '-s', 'MODULARIZE=1',
   '-s', 'EXPORT_NAME="createLittleFS"',
-  '-s', 'ENVIRONMENT="web,worker"',
+  '-s', 'ENVIRONMENT="web,worker,node"',  // node for scripts/bench.mjs and Node users
+  '-s', 'EXPORT_ES6=1',                 // import.meta.url / createRequire instead of require()
   '-s', 'FILESYSTEM=0',                 // We don't need Emscripten's FS
   '-s', 'NO_EXIT_RUNTIME=1',
   
   // Exported functions
   '-s', `EXPORTED_FUNCTIONS=[
+    "_lfs_wasm_ctx_create",
+    "_lfs_wasm_ctx_destroy",
     "_lfs_wasm_init",
     "_lfs_wasm_init_from_image",
+    "_lfs_wasm_init_adopt",
+    "_lfs_wasm_init_borrow",
+    "_lfs_wasm_init_sparse",
+    "_lfs_wasm_init_external",
     "_lfs_wasm_set_disk_version",
     "_lfs_wasm_get_disk_version",
+    "_lfs_wasm_set_read_only",
+    "_lfs_wasm_set_tuning",
     "_lfs_wasm_get_fs_info",
     "_lfs_wasm_mount",
     "_lfs_wasm_unmount",
@@ -59,15 +69,72 @@ const EMCC_FLAGS = [
     "_lfs_wasm_mkdir",
     "_lfs_wasm_remove",
     "_lfs_wasm_rename",
+    "_lfs_wasm_remove_tree",
+    "_lfs_wasm_copy_tree",
+    "_lfs_wasm_move_tree",
     "_lfs_wasm_stat",
     "_lfs_wasm_dir_open",
     "_lfs_wasm_dir_read",
     "_lfs_wasm_dir_close",
+    "_lfs_wasm_list_tree",
+    "_lfs_wasm_list_tree_attrs",
+    "_lfs_wasm_list_buffer",
+    "_lfs_wasm_check",
+    "_lfs_wasm_file_open",
+    "_lfs_wasm_file_read",
+    "_lfs_wasm_file_write",
+    "_lfs_wasm_file_seek",
+    "_lfs_wasm_file_tell",
+    "_lfs_wasm_file_length",
+    "_lfs_wasm_file_truncate",
+    "_lfs_wasm_file_sync",
+    "_lfs_wasm_file_close",
     "_lfs_wasm_write_file",
+    "_lfs_wasm_write_file_attrs",
+    "_lfs_wasm_getattr",
+    "_lfs_wasm_setattr",
+    "_lfs_wasm_removeattr",
+    "_lfs_wasm_write_files",
+    "_lfs_wasm_batch_progress",
     "_lfs_wasm_read_file",
     "_lfs_wasm_file_size",
+    "_lfs_wasm_read_file_alloc",
+    "_lfs_wasm_read_result",
+    "_lfs_wasm_read_files",
+    "_lfs_wasm_set_dir_cache",
     "_lfs_wasm_get_image",
     "_lfs_wasm_get_image_size",
+    "_lfs_wasm_get_block_size",
+    "_lfs_wasm_get_backend",
+    "_lfs_wasm_get_storage_bytes",
+    "_lfs_wasm_block_data",
+    "_lfs_wasm_block_alloc",
+    "_lfs_wasm_get_dirty_map",
+    "_lfs_wasm_clear_dirty",
+    "_lfs_wasm_io_enable",
+    "_lfs_wasm_io_disable",
+    "_lfs_wasm_io_reset",
+    "_lfs_wasm_io_stats",
+    "_lfs_wasm_io_erase_counts",
+    "_lfs_wasm_io_trace",
+    "_lfs_wasm_io_trace_total",
+    "_lfs_wasm_io_trace_capacity",
+    "_lfs_wasm_fault_enable",
+    "_lfs_wasm_fault_disable",
+    "_lfs_wasm_fault_arm",
+    "_lfs_wasm_fault_wear",
+    "_lfs_wasm_fault_bad_block",
+    "_lfs_wasm_fault_state",
+    "_lfs_wasm_power_cycle",
+    "_lfs_wasm_optimize",
+    "_lfs_wasm_repack",
+    "_lfs_wasm_resize",
+    "_lfs_wasm_diff",
+    "_lfs_wasm_apply",
+    "_lfs_wasm_snapshot",
+    "_lfs_wasm_restore",
+    "_lfs_wasm_snapshot_release",
+    "_lfs_wasm_snapshot_blocks",
     "_lfs_wasm_fs_stat",
     "_lfs_wasm_cleanup",
     "_malloc",
@@ -88,6 +155,75 @@ const LFS_SOURCES = [
   'lfs_util.c',
 ];
 
+// CRC-32 kernel: 'slice8' (src/c/lfs_wasm_crc.c) or 'nibble' (lfs_util.c).
+// Both produce bit-identical images.
+const CRC_IMPL = process.env.LFS_WASM_CRC || 'slice8';
+
+function crcConfig() {
+  switch (CRC_IMPL) {
+    case 'slice8':
+      return {
+        sources: [join(srcDir, 'lfs_wasm_crc.c')],
+        flags: ['-DLFS_CRC=lfs_wasm_crc', `-include "${join(srcDir, 'lfs_wasm_crc.h')}"`],
+      };
+    case 'nibble':
+      return { sources: [], flags: [] };
+    default:
+      console.error(`❌ Unknown LFS_WASM_CRC '${CRC_IMPL}' (expected slice8 or nibble)`);
+      process.exit(1);
+  }
+}
+
+// The loader names its Cache API entries after PACKAGE_VERSION, so a stale
+// copy would let one release's .wasm be served to another's glue
+function checkPackageVersion() {
+  const { version } = JSON.parse(readFileSync(join(rootDir, 'package.json'), 'utf8'));
+  const loader = readFileSync(join(rootDir, 'src', 'ts', 'littlefs', 'index.ts'), 'utf8');
+  const match = loader.match(/const PACKAGE_VERSION = '([^']*)'/);
+  if (!match || match[1] !== version) {
+    console.error(`❌ PACKAGE_VERSION in src/ts/littlefs/index.ts is ${match ? `'${match[1]}'` : 'missing'}, package.json has '${version}'`);
+    process.exit(1);
+  }
+}
+
+// littlefs logs through printf (pulling in stdio) and asserts on every
+// block device access. The fast and read-only builds drop both; the glue
+// validates the configuration before littlefs sees it.
+const LEAN_FLAGS = ['-DLFS_NO_DEBUG', '-DLFS_NO_WARN', '-DLFS_NO_ERROR', '-DLFS_NO_ASSERT'];
+
+// Output variants. The loader picks littlefs-fast when the runtime has
+// SIMD and littlefs otherwise; littlefs-simd (SIMD with littlefs's asserts
+// and logging kept) and littlefs-readonly (LFS_READONLY at -Oz, about half
+// the code, for viewer pages) are chosen with the `variant` option.
+// littlefs-threads needs SharedArrayBuffer and is opt-in (the `threads`
+// option). Its pool plus the calling thread gives the 8 threads
+// lfs_wasm_read_files uses at most; with STRICT=2 a batch that finds the
+// pool busy reads with fewer threads instead of blocking.
+const VARIANTS = [
+  { name: 'littlefs', flags: [] },
+  { name: 'littlefs-simd', flags: ['-msimd128'] },
+  {
+    name: 'littlefs-fast',
+    // bulk-memory turns the block device memcpy/memset into memory.copy/fill
+    flags: ['-msimd128', '-mbulk-memory', ...LEAN_FLAGS],
+  },
+  {
+    name: 'littlefs-readonly',
+    optimize: '-Oz',
+    flags: ['-DLFS_READONLY', ...LEAN_FLAGS],
+  },
+  {
+    name: 'littlefs-threads',
+    flags: [
+      '-msimd128',
+      '-pthread',
+      '-DLFS_THREADSAFE',
+      '-s', 'PTHREAD_POOL_SIZE=7',
+      '-s', 'PTHREAD_POOL_SIZE_STRICT=2',
+    ],
+  },
+];
+
 function run(cmd, options = {}) {
   console.log(`> ${cmd}`);
   try {
@@ -141,6 +277,8 @@ function downloadLittleFS() {
 function build() {
   console.log('\n🔨 Building LittleFS WASM...');
   
+  checkPackageVersion();
+
   // Check for Emscripten
   if (!checkEmscripten()) {
     console.error('❌ Emscripten not found!');
@@ -160,9 +298,12 @@ function build() {
   mkdirSync(buildDir, { recursive: true });
   mkdirSync(distDir, { recursive: true });
   
+  const crc = crcConfig();
+
   // Build source list
   const sources = [
     join(srcDir, 'littlefs_wasm.c'),
+    ...crc.sources,
     ...LFS_SOURCES.map(f => join(vendorDir, f)),
   ];
   
@@ -172,15 +313,28 @@ function build() {
     `-I"${srcDir}"`,
   ];
   
+  for (const variant of VARIANTS) {
+    buildVariant(variant, sources, includes, crc.flags);
+  }
+  
+  console.log('\n✅ Build complete!');
+}
+
+function buildVariant(variant, sources, includes, extraFlags) {
+  console.log(`\n🔨 Building ${variant.name} (CRC: ${CRC_IMPL})...`);
+  
   // Output files
-  const jsOutput = join(distDir, 'littlefs.js');
-  const wasmOutput = join(distDir, 'littlefs.wasm');
+  const jsOutput = join(distDir, `${variant.name}.js`);
+  const wasmOutput = join(distDir, `${variant.name}.wasm`);
   
   // Build command
   const cmd = [
     'emcc',
     ...sources.map(s => `"${s}"`),
     ...includes,
+    ...extraFlags,
+    variant.optimize ?? '-O3',
+    ...variant.flags,
     EMCC_FLAGS,
     '-o', `"${jsOutput}"`,
   ].join(' ');
@@ -194,18 +348,20 @@ function build() {
   }
   
   // Convert to ES module by replacing 'var createLittleFS=' with 'export default'
-  console.log('\n📦 Converting to ES module...');
+  // (only needed for toolchains that ignore EXPORT_ES6)
   let jsContent = readFileSync(jsOutput, 'utf8');
-  jsContent = jsContent.replace(/^var createLittleFS=/, 'export default ');
-  // Remove CommonJS/AMD exports at the end
-  jsContent = jsContent.replace(/if\(typeof exports===.*$/, '');
-  writeFileSync(jsOutput, jsContent);
+  if (!/export default/.test(jsContent)) {
+    console.log('\n📦 Converting to ES module...');
+    jsContent = jsContent.replace(/^var createLittleFS=/, 'export default ');
+    // Remove CommonJS/AMD exports at the end
+    jsContent = jsContent.replace(/if\(typeof exports===.*$/, '');
+    writeFileSync(jsOutput, jsContent);
+  }
   
   // Show file sizes
   const jsSize = (readFileSync(jsOutput).length / 1024).toFixed(1);
   const wasmSize = (readFileSync(wasmOutput).length / 1024).toFixed(1);
   
-  console.log('\n✅ Build complete!');
   console.log(`   ${jsOutput} (${jsSize} KB)`);
   console.log(`   ${wasmOutput} (${wasmSize} KB)`);
 }
@@ -216,8 +372,12 @@ function clean() {
   if (existsSync(buildDir)) {
     rmSync(buildDir, { recursive: true });
   }
-  if (existsSync(distDir)) {
-    rmSync(distDir, { recursive: true });
+  // dist/littlefs also holds the compiled TS; remove only the WASM outputs
+  for (const variant of VARIANTS) {
+    for (const ext of ['js', 'wasm']) {
+      const file = join(distDir, `${variant.name}.${ext}`);
+      if (existsSync(file)) rmSync(file);
+    }
   }
   
   console.log('✅ Clean complete');
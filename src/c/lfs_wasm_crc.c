@@ -0,0 +1,68 @@
+/**
+ * LittleFS WASM - CRC-32 kernel
+ *
+ * Slice-by-8 replacement for the 16-entry nibble table in lfs_util.c. The
+ * nibble table processes 4 bits per step; slice-by-8 folds 8 bytes per step
+ * with eight 256-entry tables (8 KiB), which is the fastest portable scheme
+ * on WASM. CRC runs on every metadata fetch and commit, so this dominates
+ * mount and traversal time.
+ *
+ * WASM SIMD128 has no carry-less multiply, so PCLMUL-style folding is not
+ * available there; the -msimd128 build uses this same kernel.
+ */
+
+#include "lfs_wasm_crc.h"
+
+#define CRC32_POLY_REFLECTED 0xedb88320
+
+static uint32_t crc_table[8][256];
+static int crc_table_ready = 0;
+
+static void crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32_POLY_REFLECTED : (c >> 1);
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t prev = crc_table[t - 1][i];
+            crc_table[t][i] = (prev >> 8) ^ crc_table[0][prev & 0xff];
+        }
+    }
+    crc_table_ready = 1;
+}
+
+static inline uint32_t load_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+           (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint32_t lfs_wasm_crc(uint32_t crc, const void *buffer, size_t size) {
+    if (!crc_table_ready) crc_table_init();
+
+    const uint8_t *data = buffer;
+
+    while (size >= 8) {
+        uint32_t a = load_le32(data) ^ crc;
+        uint32_t b = load_le32(data + 4);
+        crc = crc_table[7][(a >>  0) & 0xff] ^
+              crc_table[6][(a >>  8) & 0xff] ^
+              crc_table[5][(a >> 16) & 0xff] ^
+              crc_table[4][(a >> 24) & 0xff] ^
+              crc_table[3][(b >>  0) & 0xff] ^
+              crc_table[2][(b >>  8) & 0xff] ^
+              crc_table[1][(b >> 16) & 0xff] ^
+              crc_table[0][(b >> 24) & 0xff];
+        data += 8;
+        size -= 8;
+    }
+
+    while (size--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+    }
+
+    return crc;
+}
@@ -0,0 +1,20 @@
+/**
+ * LittleFS WASM - CRC-32 kernel
+ *
+ * littlefs calls LFS_CRC instead of its own lfs_crc when the macro is
+ * defined. The build passes
+ *   -DLFS_CRC=lfs_wasm_crc -include lfs_wasm_crc.h
+ * so this declaration is visible wherever lfs_util.h is used.
+ */
+
+#ifndef LFS_WASM_CRC_H
+#define LFS_WASM_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Same contract as lfs_crc: reflected CRC-32 (polynomial 0x04c11db7) with
+// no pre/post inversion, so the on-disk format is unchanged
+uint32_t lfs_wasm_crc(uint32_t crc, const void *buffer, size_t size);
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ * LittleFS WASM - write API stand-ins for LFS_READONLY builds
+ *
+ * With LFS_READONLY, lfs.h drops the write calls and open flags and
+ * lfs_file_opencfg asserts on write flags. The glue keeps one set of
+ * exports for every build variant, so here each write call fails with
+ * LFS_ERR_IO (as the read_only option does at the block device) and
+ * opening for anything but reading is refused before littlefs sees it.
+ * Included by littlefs_wasm.c after lfs.h.
+ */
+
+#ifndef LFS_WASM_READONLY_H
+#define LFS_WASM_READONLY_H
+
+#include "lfs.h"
+
+// Same values as the lfs.h enum, so the glue's write paths still compile
+#define LFS_O_WRONLY  2
+#define LFS_O_RDWR    3
+#define LFS_O_CREAT   0x0100
+#define LFS_O_EXCL    0x0200
+#define LFS_O_TRUNC   0x0400
+#define LFS_O_APPEND  0x0800
+
+static inline int lfs_wasm_ro_file_open(lfs_t *lfs, lfs_file_t *file,
+                                        const char *path, int flags) {
+    if (flags != LFS_O_RDONLY) return LFS_ERR_IO;
+    return lfs_file_open(lfs, file, path, flags);
+}
+
+static inline int lfs_wasm_ro_file_opencfg(lfs_t *lfs, lfs_file_t *file, const char *path,
+                                           int flags, const struct lfs_file_config *cfg) {
+    if (flags != LFS_O_RDONLY) return LFS_ERR_IO;
+    return lfs_file_opencfg(lfs, file, path, flags, cfg);
+}
+
+// Declared by lfs.h but only defined with writes; a read-only file has
+// nothing to flush
+static inline int lfs_wasm_ro_file_sync(lfs_t *lfs, lfs_file_t *file) {
+    (void)lfs; (void)file;
+    return 0;
+}
+
+#define lfs_file_open     lfs_wasm_ro_file_open
+#define lfs_file_opencfg  lfs_wasm_ro_file_opencfg
+#define lfs_file_sync     lfs_wasm_ro_file_sync
+
+static inline int lfs_format(lfs_t *lfs, const struct lfs_config *cfg) {
+    (void)lfs; (void)cfg;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_remove(lfs_t *lfs, const char *path) {
+    (void)lfs; (void)path;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_rename(lfs_t *lfs, const char *oldpath, const char *newpath) {
+    (void)lfs; (void)oldpath; (void)newpath;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_setattr(lfs_t *lfs, const char *path, uint8_t type,
+                              const void *buffer, lfs_size_t size) {
+    (void)lfs; (void)path; (void)type; (void)buffer; (void)size;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_removeattr(lfs_t *lfs, const char *path, uint8_t type) {
+    (void)lfs; (void)path; (void)type;
+    return LFS_ERR_IO;
+}
+
+static inline lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
+                                         const void *buffer, lfs_size_t size) {
+    (void)lfs; (void)file; (void)buffer; (void)size;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
+    (void)lfs; (void)file; (void)size;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_mkdir(lfs_t *lfs, const char *path) {
+    (void)lfs; (void)path;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_fs_mkconsistent(lfs_t *lfs) {
+    (void)lfs;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_fs_gc(lfs_t *lfs) {
+    (void)lfs;
+    return LFS_ERR_IO;
+}
+
+static inline int lfs_fs_grow(lfs_t *lfs, lfs_size_t block_count) {
+    (void)lfs; (void)block_count;
+    return LFS_ERR_IO;
+}
+
+#endif
@@ -1,9 +1,13 @@
 /**
  * LittleFS WASM Glue Code
- * 
+ *
  * This file provides a RAM-backed block device for LittleFS and exports
  * functions to be called from JavaScript via WebAssembly.
- * 
+ *
+ * All state lives in a per-instance context (lfs_wasm_ctx_t) created with
+ * lfs_wasm_ctx_create(). Every export takes that context as its first
+ * argument, so one module instance can host many filesystems at once.
+ *
  * Compile with Emscripten:
  *   emcc src/c/littlefs_wasm.c third_party/littlefs/lfs.c third_party/littlefs/lfs_util.c \
  *        -I third_party/littlefs -o dist/littlefs/littlefs.js \
@@ -11,10 +15,21 @@
  */
 
 #include "lfs.h"
+#ifdef LFS_READONLY
+#include "lfs_wasm_readonly.h"
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#ifdef LFS_THREADSAFE
+#include <pthread.h>
+#endif
+
 // ============================================================================
 // Configuration - ESP-IDF compatible
 // ============================================================================
@@ -27,6 +42,10 @@
 #define DEFAULT_BLOCK_SIZE    4096
 #define DEFAULT_BLOCK_COUNT   256    // 1 MiB default
 #define DEFAULT_LOOKAHEAD     32
+#define LOOKAHEAD_FULL        0xFFFFFFFFu  // lookahead argument: one bit per block
+#define DEFAULT_READ_SIZE     1
+#define DEFAULT_PROG_SIZE     1
+#define DEFAULT_BLOCK_CYCLES  500
 
 // Use LFS_NAME_MAX from compile flags, or default to ESP-IDF value
 #ifndef LFS_NAME_MAX
@@ -36,61 +55,416 @@
 #define MAX_PATH_LENGTH       (LFS_NAME_MAX * 4)  // Allow nested paths
 #define MAX_FILES             16
 
+// Directory handles - separate from files because lfs_dir_t != lfs_file_t
+#define MAX_DIRS              8
+
+// Packed listing entry: u8 type, u32 size, u16 path length
+#define LIST_ENTRY_HEADER     7
+#define ENTRY_PATH_LEN(e)     ((uint32_t)(e)[5] | (uint32_t)(e)[6] << 8)
+
+// Change set entry: u8 op, then a listing entry; see lfs_wasm_diff
+#define CHANGE_ADDED          1
+#define CHANGE_REMOVED        2
+#define CHANGE_MODIFIED       3
+
+// Integrity check record: u8 type, i32 error, u32 size, u32 block count,
+// u16 path length; see lfs_wasm_check
+#define CHECK_RECORD_HEADER   15
+
+// Bulk write manifest entry: u32 data size, u16 path length, u16 attrs length
+#define BATCH_ENTRY_HEADER    8
+
+// Packed custom attribute: u8 type, u16 size, value bytes
+#define ATTR_RECORD_HEADER    3
+#define MAX_FILE_ATTRS        16     // attributes committed with one file write
+
+// Directories remembered as existing, so writes skip their parents' lfs_mkdir
+#define DIR_CACHE_SLOTS       128
+
 // Default disk version: 0 = auto-detect from image (supports v2.0 and v2.1)
 #define DEFAULT_DISK_VERSION  0
 
+// Upper bound on threads per lfs_wasm_read_files batch (LFS_THREADSAFE builds)
+#define READ_THREADS_MAX      16
+
 // ============================================================================
-// RAM Block Device
+// Filesystem Context
 // ============================================================================
 
-static uint8_t *ram_storage = NULL;
-static uint32_t storage_size = 0;
-static uint32_t block_size = DEFAULT_BLOCK_SIZE;
-static uint32_t block_count = DEFAULT_BLOCK_COUNT;
-static uint32_t disk_version = DEFAULT_DISK_VERSION;
+// I/O counters, see lfs_wasm_io_stats: operation count and bytes per op
+#define IO_OP_READ   0
+#define IO_OP_PROG   1
+#define IO_OP_ERASE  2
+#define IO_OP_SYNC   3
+#define IO_OPS       4
+
+// One trace record: u32 op, u32 block, u32 off, u32 size
+#define IO_TRACE_WORDS 4
+
+/**
+ * Block device instrumentation, allocated by lfs_wasm_io_enable
+ * The device callbacks are swapped for counting wrappers while enabled, so
+ * an uninstrumented context pays nothing.
+ */
+typedef struct lfs_wasm_io {
+    uint64_t counts[IO_OPS];
+    uint64_t bytes[IO_OPS];
+    uint32_t *erase_counts;   // per block, for wear estimates
+    uint32_t *trace;          // ring of trace_cap records, NULL if not tracing
+    uint32_t trace_cap;
+    uint32_t trace_total;     // records written since the last reset
 
-// LittleFS instance
-static lfs_t lfs;
-static struct lfs_config cfg;
-static int mounted = 0;
+    // The uninstrumented callbacks
+    int (*read)(const struct lfs_config *c, lfs_block_t block,
+                lfs_off_t off, void *buffer, lfs_size_t size);
+    int (*prog)(const struct lfs_config *c, lfs_block_t block,
+                lfs_off_t off, const void *buffer, lfs_size_t size);
+    int (*erase)(const struct lfs_config *c, lfs_block_t block);
+    int (*sync)(const struct lfs_config *c);
+} lfs_wasm_io_t;
 
-// File handles for open files
-static lfs_file_t open_files[MAX_FILES];
-static int file_in_use[MAX_FILES];
+// Bad block behaviour, as lfs_emubd_badblock_behavior_t in vendor/littlefs/bd
+#define FAULT_BAD_PROG_ERROR   0  // prog fails with LFS_ERR_CORRUPT
+#define FAULT_BAD_ERASE_ERROR  1  // erase fails with LFS_ERR_CORRUPT
+#define FAULT_BAD_READ_ERROR   2  // read fails with LFS_ERR_CORRUPT
+#define FAULT_BAD_PROG_NOOP    3  // prog silently does nothing
+#define FAULT_BAD_ERASE_NOOP   4  // erase silently does nothing
 
-// Directory handles - separate from files because lfs_dir_t != lfs_file_t
-#define MAX_DIRS 8
-static lfs_dir_t open_dirs[MAX_DIRS];
-static int dir_in_use[MAX_DIRS];
+// What the operation that loses power leaves behind
+#define FAULT_CUT_ATOMIC  0  // nothing: the operation never happened
+#define FAULT_CUT_TORN    1  // a prog writes only its first half
+
+// lfs_wasm_fault_arm: never cut power
+#define FAULT_NEVER       0xFFFFFFFFu
+
+/**
+ * Fault injection state, see lfs_wasm_fault_enable
+ * Wraps the raw device callbacks underneath any instrumentation, so I/O
+ * stats still count the operations that fail.
+ */
+typedef struct lfs_wasm_fault {
+    uint32_t cut_after;      // progs+erases that succeed before power is lost
+    uint32_t ops;            // progs+erases since the last arm
+    int cut_mode;
+    int power_lost;          // set by the cut; every prog/erase fails until a power cycle
+    uint32_t erase_cycles;   // blocks wear out after this many erases (0 = never)
+    int bad_behavior;
+    uint32_t *erases;        // per block
+    uint8_t *bad;            // per block, set by lfs_wasm_fault_bad_block
+
+    // The callbacks underneath
+    int (*read)(const struct lfs_config *c, lfs_block_t block,
+                lfs_off_t off, void *buffer, lfs_size_t size);
+    int (*prog)(const struct lfs_config *c, lfs_block_t block,
+                lfs_off_t off, const void *buffer, lfs_size_t size);
+    int (*erase)(const struct lfs_config *c, lfs_block_t block);
+} lfs_wasm_fault_t;
+
+/**
+ * Tunable LittleFS parameters, applied on the next init
+ * 0 selects the default for every field; see struct lfs_config in lfs.h
+ * for the meaning of each.
+ */
+typedef struct lfs_wasm_tuning {
+    uint32_t read_size;       // default 1
+    uint32_t prog_size;       // default 1
+    uint32_t cache_size;      // default block_size
+    int32_t block_cycles;     // default 500, -1 disables wear leveling
+    uint32_t compact_thresh;  // default littlefs (~88%), -1 never compacts
+    uint32_t metadata_max;    // default block_size
+    uint32_t inline_max;      // default littlefs, -1 disables inline files
+    uint32_t name_max;        // default LFS_NAME_MAX
+} lfs_wasm_tuning_t;
+
+/**
+ * Copy-on-write snapshot, see lfs_wasm_snapshot
+ * Only the newest snapshot saves blocks: a block is copied the first time
+ * it is programmed or erased after that snapshot. Older snapshots hold the
+ * blocks first written between them and the next one, so restoring one
+ * writes back every newer snapshot's blocks and then its own.
+ */
+typedef struct lfs_wasm_snapshot {
+    uint32_t id;
+    uint8_t **blocks;   // block_count entries; NULL = unchanged since the snapshot
+    uint32_t saved;     // non-NULL entries
+    struct lfs_wasm_snapshot *older;
+} lfs_wasm_snapshot_t;
+
+#ifdef LFS_THREADSAFE
+/**
+ * Read-only mount used by one lfs_wasm_read_files thread, kept across
+ * batches until the storage changes
+ */
+typedef struct lfs_wasm_reader {
+    lfs_t lfs;
+    struct lfs_config cfg;
+    int mounted;
+    uint32_t epoch;     // write_epoch of the context when mounted
+} lfs_wasm_reader_t;
+#endif
+
+// Block device behind a context, see lfs_wasm_get_backend
+#define BACKEND_RAM       0  // one contiguous heap image
+#define BACKEND_SPARSE    1  // per-block heap allocations, see lfs_wasm_init_sparse
+#define BACKEND_EXTERNAL  2  // JS callbacks, see lfs_wasm_init_external
+
+typedef struct lfs_wasm_ctx {
+    int backend;
+
+    // RAM block device (BACKEND_RAM only)
+    uint8_t *ram_storage;
+    uint32_t storage_size;
+    int borrowed;             // ram_storage belongs to the caller, see lfs_wasm_init_borrow
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t disk_version;
+    lfs_wasm_tuning_t tuning;
+
+    // Configure without prog and erase on the next init, see lfs_wasm_set_read_only
+    int read_only;
+
+    // Lookahead sized to the whole device (LOOKAHEAD_FULL), kept so across resizes
+    int full_lookahead;
+
+    // One bit per block, set by prog/erase since the last clear
+    uint8_t *dirty_map;
+
+    // Sparse block table (BACKEND_SPARSE only), NULL entries read as erased
+    uint8_t **sparse_blocks;
+    uint32_t sparse_allocated;
+
+    // External block cache (BACKEND_EXTERNAL only)
+    uint8_t *ext_cache;          // ext_cache_slots whole blocks
+    lfs_block_t *ext_cache_tags; // block held by each slot, or EXT_CACHE_EMPTY
+    uint32_t ext_cache_slots;
+
+    // LittleFS instance
+    lfs_t lfs;
+    struct lfs_config cfg;
+    int mounted;
+
+    // File handles for open files
+    lfs_file_t open_files[MAX_FILES];
+    int file_in_use[MAX_FILES];
+
+    // Directory handles
+    lfs_dir_t open_dirs[MAX_DIRS];
+    int dir_in_use[MAX_DIRS];
+
+    // Packed entry buffer for lfs_wasm_list_tree, reused between calls
+    uint8_t *list_buf;
+    uint32_t list_cap;
+    uint32_t list_len;
+
+    // Entries completed by the last lfs_wasm_write_files call
+    uint32_t batch_progress;
+
+    // Size or error of the last lfs_wasm_read_file_alloc call
+    int read_result;
+
+    // Direct-mapped cache of directory paths known to exist (owned
+    // strings); cleared on mount and rename, pruned on remove
+    char *dir_cache[DIR_CACHE_SLOTS];
+    int dir_cache_enabled;
+
+    // Block device instrumentation, NULL unless enabled
+    lfs_wasm_io_t *io;
+
+    // Fault injection, NULL unless enabled
+    lfs_wasm_fault_t *fault;
+
+    // Snapshots, newest first (RAM and sparse backends only)
+    lfs_wasm_snapshot_t *snapshots;
+    uint32_t next_snapshot_id;
+
+    // Erases counted during lfs_wasm_optimize, and the callback it wraps
+    uint32_t optimize_erases;
+    int (*optimize_erase)(const struct lfs_config *c, lfs_block_t block);
+
+    // Bumped by every change to the storage, so reader mounts know when
+    // their view is stale
+    uint32_t write_epoch;
+
+#ifdef LFS_THREADSAFE
+    // Recursive; taken by littlefs around every call (cfg.lock) and held
+    // across read batches and resizes, so writers never overlap readers
+    pthread_mutex_t lock;
+
+    // READ_THREADS_MAX - 1 reader mounts, allocated by the first parallel
+    // read batch and dropped on unmount
+    lfs_wasm_reader_t *readers;
+#endif
+} lfs_wasm_ctx_t;
+
+/**
+ * One file of an lfs_wasm_read_files batch
+ */
+typedef struct lfs_wasm_read_slot {
+    uint8_t *data;   // release with free(); NULL on error or for an empty file
+    int32_t size;    // bytes read, or negative error code
+} lfs_wasm_read_slot_t;
+
+/**
+ * Totals of an lfs_wasm_check pass
+ */
+typedef struct lfs_wasm_check_summary {
+    int32_t traverse_error;   // lfs_fs_traverse result, e.g. LFS_ERR_CORRUPT
+    uint32_t used;            // distinct blocks the traversal reached
+    uint32_t out_of_range;    // entry references past the end of the device
+    uint32_t shared;          // blocks claimed by more than one entry
+    uint32_t unreferenced;    // blocks the traversal reached but no entry claims
+} lfs_wasm_check_summary_t;
+
+// ============================================================================
+// Snapshots
+// ============================================================================
+
+// Saved state of a sparse block that had no memory: restoring frees it
+static uint8_t snap_unallocated;
+
+/**
+ * Save a block's current contents in the newest snapshot before its first
+ * write since then
+ * @return 0 on success, LFS_ERR_NOMEM if the copy couldn't be allocated
+ */
+static int snap_save(lfs_wasm_ctx_t *ctx, lfs_block_t block) {
+    lfs_wasm_snapshot_t *snap = ctx->snapshots;
+    if (!snap || snap->blocks[block]) return 0;
+
+    const uint8_t *data = ctx->backend == BACKEND_SPARSE
+        ? ctx->sparse_blocks[block]
+        : ctx->ram_storage + (size_t)block * ctx->block_size;
+    uint8_t *copy = &snap_unallocated;
+    if (data) {
+        copy = (uint8_t *)malloc(ctx->block_size);
+        if (!copy) return LFS_ERR_NOMEM;
+        memcpy(copy, data, ctx->block_size);
+    }
+    snap->blocks[block] = copy;
+    snap->saved++;
+    return 0;
+}
+
+static void snap_free_block(uint8_t *data) {
+    if (data != &snap_unallocated) free(data);
+}
+
+/**
+ * Put a saved block back into storage, taking ownership of it
+ */
+static void snap_write_back(lfs_wasm_ctx_t *ctx, lfs_block_t block, uint8_t *data) {
+    if (ctx->backend == BACKEND_SPARSE) {
+        uint8_t *live = ctx->sparse_blocks[block];
+        if (live) {
+            free(live);
+            ctx->sparse_allocated--;
+        }
+        if (data == &snap_unallocated) data = NULL;
+        if (data) ctx->sparse_allocated++;
+        ctx->sparse_blocks[block] = data;
+    } else {
+        uint8_t *live = ctx->ram_storage + (size_t)block * ctx->block_size;
+        if (data == &snap_unallocated) {
+            memset(live, 0xFF, ctx->block_size);
+        } else {
+            memcpy(live, data, ctx->block_size);
+            free(data);
+        }
+    }
+    // As mark_dirty: restoring rewrites the block
+    ctx->dirty_map[block >> 3] |= (uint8_t)(1u << (block & 7));
+    ctx->write_epoch++;
+}
+
+/**
+ * Unlink and free a snapshot
+ * Its blocks pass to the next older snapshot where that one has none: the
+ * block didn't change in between, so the copy is valid for it too.
+ */
+static void snap_drop(lfs_wasm_ctx_t *ctx, lfs_wasm_snapshot_t *snap) {
+    lfs_wasm_snapshot_t **link = &ctx->snapshots;
+    while (*link != snap) link = &(*link)->older;
+    *link = snap->older;
+
+    lfs_wasm_snapshot_t *older = snap->older;
+    for (uint32_t i = 0; snap->saved && i < ctx->block_count; i++) {
+        uint8_t *data = snap->blocks[i];
+        if (!data) continue;
+        if (older && !older->blocks[i]) {
+            older->blocks[i] = data;
+            older->saved++;
+        } else {
+            snap_free_block(data);
+        }
+        snap->saved--;
+    }
+    free(snap->blocks);
+    free(snap);
+}
+
+// Free every snapshot; nothing older survives, so nothing is merged
+static void snap_drop_all(lfs_wasm_ctx_t *ctx) {
+    while (ctx->snapshots) {
+        lfs_wasm_snapshot_t *snap = ctx->snapshots;
+        ctx->snapshots = snap->older;
+        for (uint32_t i = 0; snap->saved && i < ctx->block_count; i++) {
+            if (!snap->blocks[i]) continue;
+            snap_free_block(snap->blocks[i]);
+            snap->saved--;
+        }
+        free(snap->blocks);
+        free(snap);
+    }
+}
+
+static lfs_wasm_snapshot_t *snap_find(lfs_wasm_ctx_t *ctx, uint32_t id) {
+    lfs_wasm_snapshot_t *snap = ctx->snapshots;
+    while (snap && snap->id != id) snap = snap->older;
+    return snap;
+}
 
 // ============================================================================
 // Block Device Operations
 // ============================================================================
 
+static inline void mark_dirty(lfs_wasm_ctx_t *ctx, lfs_block_t block) {
+    ctx->dirty_map[block >> 3] |= (uint8_t)(1u << (block & 7));
+    ctx->write_epoch++;
+}
+
 static int ram_read(const struct lfs_config *c, lfs_block_t block,
                     lfs_off_t off, void *buffer, lfs_size_t size) {
-    if (!ram_storage) return LFS_ERR_IO;
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (!ctx->ram_storage) return LFS_ERR_IO;
     uint32_t addr = block * c->block_size + off;
-    if (addr + size > storage_size) return LFS_ERR_IO;
-    memcpy(buffer, ram_storage + addr, size);
+    if (addr + size > ctx->storage_size) return LFS_ERR_IO;
+    memcpy(buffer, ctx->ram_storage + addr, size);
     return 0;
 }
 
 static int ram_prog(const struct lfs_config *c, lfs_block_t block,
                     lfs_off_t off, const void *buffer, lfs_size_t size) {
-    if (!ram_storage) return LFS_ERR_IO;
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (!ctx->ram_storage) return LFS_ERR_IO;
     uint32_t addr = block * c->block_size + off;
-    if (addr + size > storage_size) return LFS_ERR_IO;
-    memcpy(ram_storage + addr, buffer, size);
+    if (addr + size > ctx->storage_size) return LFS_ERR_IO;
+    int err = snap_save(ctx, block);
+    if (err) return err;
+    memcpy(ctx->ram_storage + addr, buffer, size);
+    mark_dirty(ctx, block);
     return 0;
 }
 
 static int ram_erase(const struct lfs_config *c, lfs_block_t block) {
-    if (!ram_storage) return LFS_ERR_IO;
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (!ctx->ram_storage) return LFS_ERR_IO;
     uint32_t addr = block * c->block_size;
-    if (addr + c->block_size > storage_size) return LFS_ERR_IO;
+    if (addr + c->block_size > ctx->storage_size) return LFS_ERR_IO;
+    int err = snap_save(ctx, block);
+    if (err) return err;
     // NOR flash erases to 0xFF
-    memset(ram_storage + addr, 0xFF, c->block_size);
+    memset(ctx->ram_storage + addr, 0xFF, c->block_size);
+    mark_dirty(ctx, block);
     return 0;
 }
 
@@ -99,443 +473,3680 @@ static int ram_sync(const struct lfs_config *c) {
     return 0;
 }
 
+// Read-only configurations: writes fail before reaching any backend
+static int ro_prog(const struct lfs_config *c, lfs_block_t block,
+                   lfs_off_t off, const void *buffer, lfs_size_t size) {
+    (void)c; (void)block; (void)off; (void)buffer; (void)size;
+    return LFS_ERR_IO;
+}
+
+static int ro_erase(const struct lfs_config *c, lfs_block_t block) {
+    (void)c; (void)block;
+    return LFS_ERR_IO;
+}
+
+#ifdef LFS_THREADSAFE
+static int ctx_lock(const struct lfs_config *c) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    return pthread_mutex_lock(&ctx->lock) ? LFS_ERR_IO : 0;
+}
+
+static int ctx_unlock(const struct lfs_config *c) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    return pthread_mutex_unlock(&ctx->lock) ? LFS_ERR_IO : 0;
+}
+
+#define CTX_LOCK(ctx)    pthread_mutex_lock(&(ctx)->lock)
+#define CTX_UNLOCK(ctx)  pthread_mutex_unlock(&(ctx)->lock)
+#else
+#define CTX_LOCK(ctx)    ((void)0)
+#define CTX_UNLOCK(ctx)  ((void)0)
+#endif
+
 // ============================================================================
-// Exported Functions (called from JavaScript)
+// Sparse Block Device
 // ============================================================================
 
-/**
- * Set the disk version for new filesystems
- * @param version Disk version (e.g., 0x00020000 for v2.0, 0x00020001 for v2.1)
- *                Use 0 for latest version
+/*
+ * Blocks are allocated on first prog, so a mostly empty partition costs
+ * heap in proportion to the data written rather than the partition size.
+ * Unallocated blocks read as erased; erasing an allocated block keeps its
+ * memory, since littlefs almost always progs it again right away.
  */
-void lfs_wasm_set_disk_version(uint32_t version) {
-    disk_version = version;
-}
 
 /**
- * Get the current disk version setting
- * @return Current disk version
+ * Allocation of a sparse block, filled with 0xFF on first use
+ * @return Block memory, or NULL if allocation failed
  */
-uint32_t lfs_wasm_get_disk_version(void) {
-    return disk_version;
+static uint8_t *sparse_alloc(lfs_wasm_ctx_t *ctx, lfs_block_t block) {
+    uint8_t *data = ctx->sparse_blocks[block];
+    if (!data) {
+        data = (uint8_t *)malloc(ctx->block_size);
+        if (!data) return NULL;
+        memset(data, 0xFF, ctx->block_size);
+        ctx->sparse_blocks[block] = data;
+        ctx->sparse_allocated++;
+    }
+    return data;
 }
 
-/**
- * Initialize the filesystem with given parameters
- * @param blk_size Block size in bytes (default 4096)
- * @param blk_count Number of blocks
- * @param lookahead Lookahead buffer size
- * @return 0 on success, negative error code on failure
- */
-int lfs_wasm_init(uint32_t blk_size, uint32_t blk_count, uint32_t lookahead) {
-    // Free existing storage if any
-    if (ram_storage) {
-        if (mounted) {
-            lfs_unmount(&lfs);
-            mounted = 0;
-        }
-        free(ram_storage);
-        ram_storage = NULL;
+static int sparse_read(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, void *buffer, lfs_size_t size) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (block >= ctx->block_count || off + size > c->block_size) return LFS_ERR_IO;
+    const uint8_t *data = ctx->sparse_blocks[block];
+    if (data) {
+        memcpy(buffer, data + off, size);
+    } else {
+        memset(buffer, 0xFF, size);
     }
+    return 0;
+}
 
-    // Use defaults if zero
-    block_size = blk_size > 0 ? blk_size : DEFAULT_BLOCK_SIZE;
-    block_count = blk_count > 0 ? blk_count : DEFAULT_BLOCK_COUNT;
-    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+static int sparse_prog(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, const void *buffer, lfs_size_t size) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (block >= ctx->block_count || off + size > c->block_size) return LFS_ERR_IO;
+    int err = snap_save(ctx, block);
+    if (err) return err;
+    uint8_t *data = sparse_alloc(ctx, block);
+    if (!data) return LFS_ERR_NOMEM;
+    memcpy(data + off, buffer, size);
+    mark_dirty(ctx, block);
+    return 0;
+}
 
-    storage_size = block_size * block_count;
-    ram_storage = (uint8_t *)malloc(storage_size);
-    if (!ram_storage) return LFS_ERR_NOMEM;
+static int sparse_erase(const struct lfs_config *c, lfs_block_t block) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (block >= ctx->block_count) return LFS_ERR_IO;
+    int err = snap_save(ctx, block);
+    if (err) return err;
+    if (ctx->sparse_blocks[block]) {
+        memset(ctx->sparse_blocks[block], 0xFF, c->block_size);
+    }
+    mark_dirty(ctx, block);
+    return 0;
+}
 
-    // Initialize to 0xFF (NOR flash erased state)
-    memset(ram_storage, 0xFF, storage_size);
+// ============================================================================
+// External Block Device
+// ============================================================================
 
-    // Initialize file and directory handles
-    memset(file_in_use, 0, sizeof(file_in_use));
-    memset(dir_in_use, 0, sizeof(dir_in_use));
+// Operations passed to the JS block device dispatcher
+#define EXT_OP_READ   0
+#define EXT_OP_PROG   1
+#define EXT_OP_ERASE  2
+#define EXT_OP_SYNC   3
 
-    // Configure LittleFS
-    memset(&cfg, 0, sizeof(cfg));
-    cfg.read = ram_read;
-    cfg.prog = ram_prog;
-    cfg.erase = ram_erase;
-    cfg.sync = ram_sync;
-    cfg.read_size = 1;
-    cfg.prog_size = 1;
-    cfg.block_size = block_size;
-    cfg.block_count = block_count;
-    cfg.cache_size = block_size;
-    cfg.lookahead_size = la_size;
-    cfg.block_cycles = 500;
-    cfg.name_max = LFS_NAME_MAX;  // ESP-IDF uses 64
-    cfg.file_max = 0;             // Use default
-    cfg.attr_max = 0;             // Use default
-#ifdef LFS_MULTIVERSION
-    cfg.disk_version = 0;  // 0 = auto-detect version from image (supports v2.0 and v2.1)
+#define EXT_CACHE_EMPTY ((lfs_block_t)-1)
+
+#ifdef __EMSCRIPTEN__
+// Calls Module.lfsBlockDevice(ctx, op, block, off, ptr, size), installed by
+// the TS bindings. It must complete synchronously (OPFS sync access handles,
+// Node fs.*Sync) and return 0 or a negative LFS_ERR_* code.
+EM_JS(int, ext_call, (lfs_wasm_ctx_t *ctx, int op, uint32_t block, uint32_t off,
+                      void *buffer, uint32_t size), {
+    var dispatch = Module['lfsBlockDevice'];
+    if (!dispatch) return -5;
+    return dispatch(ctx, op, block, off, buffer, size);
+});
+#else
+// Native builds have no JS host, so external devices always fail
+static int ext_call(lfs_wasm_ctx_t *ctx, int op, uint32_t block, uint32_t off,
+                    void *buffer, uint32_t size) {
+    (void)ctx; (void)op; (void)block; (void)off; (void)buffer; (void)size;
+    return LFS_ERR_IO;
+}
 #endif
 
+/*
+ * A direct-mapped, write-through cache of whole blocks sits in front of the
+ * JS device. littlefs re-reads the same metadata blocks constantly, and each
+ * miss costs a JS call plus a host I/O, while progs and erases always go
+ * straight through so the backing store is never stale.
+ */
+
+static int ext_read(const struct lfs_config *c, lfs_block_t block,
+                    lfs_off_t off, void *buffer, lfs_size_t size) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (block >= ctx->block_count || off + size > c->block_size) return LFS_ERR_IO;
+
+    if (!ctx->ext_cache_slots) {
+        return ext_call(ctx, EXT_OP_READ, block, off, buffer, size);
+    }
+
+    uint32_t slot = block % ctx->ext_cache_slots;
+    uint8_t *cached = ctx->ext_cache + (size_t)slot * c->block_size;
+    if (ctx->ext_cache_tags[slot] != block) {
+        ctx->ext_cache_tags[slot] = EXT_CACHE_EMPTY;
+        int err = ext_call(ctx, EXT_OP_READ, block, 0, cached, c->block_size);
+        if (err) return err;
+        ctx->ext_cache_tags[slot] = block;
+    }
+    memcpy(buffer, cached + off, size);
     return 0;
 }
 
-/**
- * Initialize from an existing image
- * @param image Pointer to the image data
- * @param image_size Size of the image in bytes
- * @param blk_size Block size (0 = auto-detect from image size)
- * @param blk_count Number of blocks (0 = calculate from image_size/blk_size)
- * @param lookahead Lookahead buffer size (0 = use default)
- * @return 0 on success, negative error code on failure
- */
-int lfs_wasm_init_from_image(uint8_t *image, uint32_t image_size, uint32_t blk_size, uint32_t blk_count, uint32_t lookahead) {
-    // Free existing storage
-    if (ram_storage) {
-        if (mounted) {
-            lfs_unmount(&lfs);
-            mounted = 0;
+static int ext_prog(const struct lfs_config *c, lfs_block_t block,
+                    lfs_off_t off, const void *buffer, lfs_size_t size) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (block >= ctx->block_count || off + size > c->block_size) return LFS_ERR_IO;
+
+    int err = ext_call(ctx, EXT_OP_PROG, block, off, (void *)buffer, size);
+    if (err) return err;
+
+    if (ctx->ext_cache_slots) {
+        uint32_t slot = block % ctx->ext_cache_slots;
+        if (ctx->ext_cache_tags[slot] == block) {
+            memcpy(ctx->ext_cache + (size_t)slot * c->block_size + off, buffer, size);
         }
-        free(ram_storage);
-        ram_storage = NULL;
     }
+    mark_dirty(ctx, block);
+    return 0;
+}
 
-    // Determine block size
-    block_size = blk_size > 0 ? blk_size : DEFAULT_BLOCK_SIZE;
-    
-    // Determine block count
-    if (blk_count > 0) {
-        block_count = blk_count;
-    } else {
-        block_count = image_size / block_size;
-    }
-    
-    storage_size = block_size * block_count;
-    
-    // Use lookahead or default
-    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+static int ext_erase(const struct lfs_config *c, lfs_block_t block) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    if (block >= ctx->block_count) return LFS_ERR_IO;
 
-    if (storage_size == 0 || block_count == 0) {
-        return LFS_ERR_INVAL;
+    int err = ext_call(ctx, EXT_OP_ERASE, block, 0, NULL, c->block_size);
+    if (err) return err;
+
+    if (ctx->ext_cache_slots) {
+        uint32_t slot = block % ctx->ext_cache_slots;
+        if (ctx->ext_cache_tags[slot] == block) {
+            memset(ctx->ext_cache + (size_t)slot * c->block_size, 0xFF, c->block_size);
+        }
     }
+    mark_dirty(ctx, block);
+    return 0;
+}
 
-    ram_storage = (uint8_t *)malloc(storage_size);
-    if (!ram_storage) return LFS_ERR_NOMEM;
+static int ext_sync(const struct lfs_config *c) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    return ext_call(ctx, EXT_OP_SYNC, 0, 0, NULL, 0);
+}
 
-    // Copy image data (only up to image_size, not storage_size which might be larger)
-    uint32_t copy_size = image_size < storage_size ? image_size : storage_size;
-    memcpy(ram_storage, image, copy_size);
-    
-    // Fill rest with 0xFF if image is smaller than storage
-    if (copy_size < storage_size) {
-        memset(ram_storage + copy_size, 0xFF, storage_size - copy_size);
+// ============================================================================
+// Block Device Instrumentation
+// ============================================================================
+
+static void io_record(lfs_wasm_io_t *io, uint32_t op, lfs_block_t block,
+                      lfs_off_t off, lfs_size_t size) {
+    io->counts[op]++;
+    io->bytes[op] += size;
+    if (io->trace) {
+        uint32_t *rec = io->trace + (size_t)(io->trace_total % io->trace_cap) * IO_TRACE_WORDS;
+        rec[0] = op;
+        rec[1] = block;
+        rec[2] = off;
+        rec[3] = size;
+        io->trace_total++;
     }
+}
 
-    // Initialize file and directory handles
-    memset(file_in_use, 0, sizeof(file_in_use));
-    memset(dir_in_use, 0, sizeof(dir_in_use));
+static int io_read(const struct lfs_config *c, lfs_block_t block,
+                   lfs_off_t off, void *buffer, lfs_size_t size) {
+    lfs_wasm_io_t *io = ((lfs_wasm_ctx_t *)c->context)->io;
+    io_record(io, IO_OP_READ, block, off, size);
+    return io->read(c, block, off, buffer, size);
+}
 
-    // Configure LittleFS
-    memset(&cfg, 0, sizeof(cfg));
-    cfg.read = ram_read;
-    cfg.prog = ram_prog;
-    cfg.erase = ram_erase;
-    cfg.sync = ram_sync;
-    cfg.read_size = 1;
-    cfg.prog_size = 1;
-    cfg.block_size = block_size;
-    cfg.block_count = block_count;
-    cfg.cache_size = block_size;
-    cfg.lookahead_size = la_size;
-    cfg.block_cycles = 500;
-    cfg.name_max = LFS_NAME_MAX;  // ESP-IDF uses 64
-    cfg.file_max = 0;             // Use default
-    cfg.attr_max = 0;             // Use default
-#ifdef LFS_MULTIVERSION
-    cfg.disk_version = 0;  // 0 = auto-detect version from image (supports v2.0 and v2.1)
-#endif
+static int io_prog(const struct lfs_config *c, lfs_block_t block,
+                   lfs_off_t off, const void *buffer, lfs_size_t size) {
+    lfs_wasm_io_t *io = ((lfs_wasm_ctx_t *)c->context)->io;
+    io_record(io, IO_OP_PROG, block, off, size);
+    return io->prog(c, block, off, buffer, size);
+}
 
-    return 0;
+static int io_erase(const struct lfs_config *c, lfs_block_t block) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    lfs_wasm_io_t *io = ctx->io;
+    io_record(io, IO_OP_ERASE, block, 0, c->block_size);
+    if (block < ctx->block_count) io->erase_counts[block]++;
+    return io->erase(c, block);
+}
+
+static int io_sync(const struct lfs_config *c) {
+    lfs_wasm_io_t *io = ((lfs_wasm_ctx_t *)c->context)->io;
+    io_record(io, IO_OP_SYNC, 0, 0, 0);
+    return io->sync(c);
+}
+
+// Counts the block rewrites of one lfs_wasm_optimize call
+static int optimize_erase(const struct lfs_config *c, lfs_block_t block) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    ctx->optimize_erases++;
+    return ctx->optimize_erase(c, block);
 }
 
 /**
- * Get the filesystem info including disk version
- * Must be called after mount
- * @param version_out Pointer to store disk version
- * @return 0 on success, negative error code on failure
+ * Restore the uninstrumented callbacks and free the counters
  */
-int lfs_wasm_get_fs_info(uint32_t *version_out) {
-    if (!mounted) return LFS_ERR_INVAL;
-    
-    struct lfs_fsinfo fsinfo;
-    int err = lfs_fs_stat(&lfs, &fsinfo);
-    if (err < 0) return err;
-    
-    if (version_out) {
-        *version_out = fsinfo.disk_version;
-    }
-    return 0;
+static void io_disable(lfs_wasm_ctx_t *ctx) {
+    lfs_wasm_io_t *io = ctx->io;
+    if (!io) return;
+    ctx->cfg.read = io->read;
+    ctx->cfg.prog = io->prog;
+    ctx->cfg.erase = io->erase;
+    ctx->cfg.sync = io->sync;
+    free(io->erase_counts);
+    free(io->trace);
+    free(io);
+    ctx->io = NULL;
 }
 
-/**
- * Mount the filesystem
- * @return 0 on success, negative error code on failure
+// ============================================================================
+// Fault Injection
+// ============================================================================
+
+/*
+ * Power loss and bad blocks in the manner of lfs_emubd, layered over the
+ * context's own backend so snapshots, sparse storage and I/O stats keep
+ * working. Power loss doesn't stop littlefs mid-call as a real reset
+ * would: once the cut has happened every prog and erase fails with
+ * LFS_ERR_IO, the call unwinds, and lfs_wasm_power_cycle remounts what
+ * reached the device.
  */
-int lfs_wasm_mount(void) {
-    if (!ram_storage) return LFS_ERR_INVAL;
-    if (mounted) return 0;
 
-    int err = lfs_mount(&lfs, &cfg);
-    if (err == 0) {
-        mounted = 1;
-        
-        // Read the actual disk version from the mounted filesystem
-        // and store it so we preserve it on subsequent writes
-        struct lfs_fsinfo fsinfo;
-        if (lfs_fs_stat(&lfs, &fsinfo) == 0) {
-            disk_version = fsinfo.disk_version;
-#ifdef LFS_MULTIVERSION
-            cfg.disk_version = disk_version;  // Update config to match mounted version
-#endif
-        }
-    }
-    return err;
+static inline int fault_block_bad(lfs_wasm_fault_t *fault, lfs_block_t block) {
+    return fault->bad[block] ||
+           (fault->erase_cycles && fault->erases[block] >= fault->erase_cycles);
 }
 
 /**
- * Unmount the filesystem
- * @return 0 on success, negative error code on failure
+ * Count one prog or erase against the power budget
+ * @return 1 if the device still has power for it, 0 if it is the one that
+ *         loses power (power_lost is then set), -1 if power is already gone
  */
-int lfs_wasm_unmount(void) {
-    if (!mounted) return 0;
-    int err = lfs_unmount(&lfs);
-    if (err == 0) {
-        mounted = 0;
+static int fault_power(lfs_wasm_fault_t *fault) {
+    if (fault->power_lost) return -1;
+    if (fault->cut_after != FAULT_NEVER && fault->ops >= fault->cut_after) {
+        fault->power_lost = 1;
+        return 0;
     }
-    return err;
+    fault->ops++;
+    return 1;
 }
 
-/**
- * Format the filesystem
- * @return 0 on success, negative error code on failure
- */
-int lfs_wasm_format(void) {
-    if (!ram_storage) return LFS_ERR_INVAL;
-    
-    if (mounted) {
-        lfs_unmount(&lfs);
-        mounted = 0;
+static int fault_read(const struct lfs_config *c, lfs_block_t block,
+                      lfs_off_t off, void *buffer, lfs_size_t size) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (block < ctx->block_count && fault->bad_behavior == FAULT_BAD_READ_ERROR &&
+        fault_block_bad(fault, block)) {
+        return LFS_ERR_CORRUPT;
     }
-    
-    return lfs_format(&lfs, &cfg);
+    return fault->read(c, block, off, buffer, size);
 }
 
-/**
- * Create a directory
- * @param path Directory path
- * @return 0 on success, negative error code on failure
- */
-int lfs_wasm_mkdir(const char *path) {
-    if (!mounted) return LFS_ERR_INVAL;
-    return lfs_mkdir(&lfs, path);
+static int fault_prog(const struct lfs_config *c, lfs_block_t block,
+                      lfs_off_t off, const void *buffer, lfs_size_t size) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    lfs_wasm_fault_t *fault = ctx->fault;
+    int power = fault_power(fault);
+    if (power == 0 && fault->cut_mode == FAULT_CUT_TORN && size / 2 > 0) {
+        fault->prog(c, block, off, buffer, size / 2);
+    }
+    if (power <= 0) return LFS_ERR_IO;
+
+    if (block < ctx->block_count && fault_block_bad(fault, block)) {
+        if (fault->bad_behavior == FAULT_BAD_PROG_ERROR) return LFS_ERR_CORRUPT;
+        if (fault->bad_behavior == FAULT_BAD_PROG_NOOP) return 0;
+    }
+    return fault->prog(c, block, off, buffer, size);
 }
 
-/**
- * Remove a file or empty directory
- * @param path Path to remove
- * @return 0 on success, negative error code on failure
- */
-int lfs_wasm_remove(const char *path) {
-    if (!mounted) return LFS_ERR_INVAL;
-    return lfs_remove(&lfs, path);
+static int fault_erase(const struct lfs_config *c, lfs_block_t block) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)c->context;
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (fault_power(fault) <= 0) return LFS_ERR_IO;
+
+    if (block < ctx->block_count) {
+        if (fault_block_bad(fault, block)) {
+            if (fault->bad_behavior == FAULT_BAD_ERASE_ERROR) return LFS_ERR_CORRUPT;
+            if (fault->bad_behavior == FAULT_BAD_ERASE_NOOP) return 0;
+        }
+        fault->erases[block]++;
+    }
+    return fault->erase(c, block);
 }
 
 /**
- * Rename a file or directory
- * @param oldpath Current path
- * @param newpath New path
- * @return 0 on success, negative error code on failure
+ * Restore the callbacks beneath the fault layer and free its state
  */
-int lfs_wasm_rename(const char *oldpath, const char *newpath) {
-    if (!mounted) return LFS_ERR_INVAL;
-    return lfs_rename(&lfs, oldpath, newpath);
+static void fault_disable(lfs_wasm_ctx_t *ctx) {
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (!fault) return;
+    // Beneath the I/O counters when they are enabled, else in the config
+    if (ctx->io) {
+        ctx->io->read = fault->read;
+        ctx->io->prog = fault->prog;
+        ctx->io->erase = fault->erase;
+    } else {
+        ctx->cfg.read = fault->read;
+        ctx->cfg.prog = fault->prog;
+        ctx->cfg.erase = fault->erase;
+    }
+    free(fault->erases);
+    free(fault->bad);
+    free(fault);
+    ctx->fault = NULL;
 }
 
-/**
- * Get file/directory info
- * @param path Path to query
- * @param out_type Output: 1 for file, 2 for directory
+// ============================================================================
+// Directory Cache
+// ============================================================================
+
+// FNV-1a
+static uint32_t path_hash(const char *path, uint32_t len) {
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)path[i]) * 16777619u;
+    }
+    return h;
+}
+
+static char **dir_cache_slot(lfs_wasm_ctx_t *ctx, const char *path, uint32_t len) {
+    return &ctx->dir_cache[path_hash(path, len) % DIR_CACHE_SLOTS];
+}
+
+static int dir_cache_has(lfs_wasm_ctx_t *ctx, const char *path, uint32_t len) {
+    if (!ctx->dir_cache_enabled) return 0;
+    const char *cached = *dir_cache_slot(ctx, path, len);
+    return cached && strncmp(cached, path, len) == 0 && cached[len] == '\0';
+}
+
+static void dir_cache_add(lfs_wasm_ctx_t *ctx, const char *path, uint32_t len) {
+    if (!ctx->dir_cache_enabled) return;
+    char **slot = dir_cache_slot(ctx, path, len);
+    char *copy = (char *)malloc(len + 1);
+    if (!copy) return; // Only a missed shortcut
+    memcpy(copy, path, len);
+    copy[len] = '\0';
+    free(*slot);
+    *slot = copy;
+}
+
+static void dir_cache_clear(lfs_wasm_ctx_t *ctx) {
+    for (int i = 0; i < DIR_CACHE_SLOTS; i++) {
+        free(ctx->dir_cache[i]);
+        ctx->dir_cache[i] = NULL;
+    }
+}
+
+/**
+ * Drop a removed path from the cache
+ * A directory can only be removed once empty, so nothing below it can be
+ * cached. Paths spelled another way than "/a/b" (".", "..", repeated or
+ * trailing slashes) might alias a cached entry, so they clear everything.
+ */
+static void dir_cache_forget(lfs_wasm_ctx_t *ctx, const char *path) {
+    uint32_t len = strlen(path);
+    int canonical = len > 1 && path[0] == '/' && path[len - 1] != '/';
+    for (uint32_t i = 0; canonical && i < len; i++) {
+        if (path[i] == '/' && (path[i + 1] == '/' || path[i + 1] == '.')) canonical = 0;
+    }
+    if (!canonical) {
+        dir_cache_clear(ctx);
+        return;
+    }
+    char **slot = dir_cache_slot(ctx, path, len);
+    if (*slot && strcmp(*slot, path) == 0) {
+        free(*slot);
+        *slot = NULL;
+    }
+}
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+/**
+ * Close every open file and directory handle
+ * Files are closed (and therefore synced) so no buffered data is lost.
+ */
+static void ctx_close_handles(lfs_wasm_ctx_t *ctx) {
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (ctx->file_in_use[i]) {
+            lfs_file_close(&ctx->lfs, &ctx->open_files[i]);
+            ctx->file_in_use[i] = 0;
+        }
+    }
+    for (int i = 0; i < MAX_DIRS; i++) {
+        if (ctx->dir_in_use[i]) {
+            lfs_dir_close(&ctx->lfs, &ctx->open_dirs[i]);
+            ctx->dir_in_use[i] = 0;
+        }
+    }
+}
+
+/**
+ * Unmount and free the reader mounts of lfs_wasm_read_files
+ */
+static void readers_release(lfs_wasm_ctx_t *ctx) {
+#ifdef LFS_THREADSAFE
+    if (!ctx->readers) return;
+    for (uint32_t i = 0; i < READ_THREADS_MAX - 1; i++) {
+        if (ctx->readers[i].mounted) lfs_unmount(&ctx->readers[i].lfs);
+    }
+    free(ctx->readers);
+    ctx->readers = NULL;
+#else
+    (void)ctx;
+#endif
+}
+
+/**
+ * Unmount and free the RAM storage of a context
+ * The context itself (including its disk version setting) stays valid.
+ */
+static void ctx_release(lfs_wasm_ctx_t *ctx) {
+    if (ctx->mounted) {
+        ctx_close_handles(ctx);
+        lfs_unmount(&ctx->lfs);
+        ctx->mounted = 0;
+    }
+    readers_release(ctx);
+    fault_disable(ctx);
+    io_disable(ctx);
+    dir_cache_clear(ctx);
+    snap_drop_all(ctx);
+    if (ctx->ram_storage) {
+        if (!ctx->borrowed) free(ctx->ram_storage);
+        ctx->ram_storage = NULL;
+    }
+    ctx->borrowed = 0;
+    if (ctx->dirty_map) {
+        free(ctx->dirty_map);
+        ctx->dirty_map = NULL;
+    }
+    if (ctx->list_buf) {
+        free(ctx->list_buf);
+        ctx->list_buf = NULL;
+        ctx->list_cap = 0;
+        ctx->list_len = 0;
+    }
+    if (ctx->ext_cache) {
+        free(ctx->ext_cache);
+        ctx->ext_cache = NULL;
+    }
+    if (ctx->ext_cache_tags) {
+        free(ctx->ext_cache_tags);
+        ctx->ext_cache_tags = NULL;
+    }
+    ctx->ext_cache_slots = 0;
+    if (ctx->sparse_blocks) {
+        for (uint32_t i = 0; i < ctx->block_count; i++) {
+            free(ctx->sparse_blocks[i]);
+        }
+        free(ctx->sparse_blocks);
+        ctx->sparse_blocks = NULL;
+    }
+    ctx->sparse_allocated = 0;
+    ctx->backend = BACKEND_RAM;
+    ctx->storage_size = 0;
+}
+
+/**
+ * Whether the context has a block device to mount or format
+ */
+static inline int ctx_has_storage(const lfs_wasm_ctx_t *ctx) {
+    switch (ctx->backend) {
+        case BACKEND_SPARSE:   return ctx->sparse_blocks != NULL;
+        case BACKEND_EXTERNAL: return 1;
+        default:               return ctx->ram_storage != NULL;
+    }
+}
+
+/**
+ * Check a requested disk version against what this driver can write:
+ * 0 (latest) or the current major with a minor no newer than ours
+ */
+static int disk_version_valid(uint32_t version) {
+    return !version || ((0xffff & (version >> 16)) == LFS_DISK_VERSION_MAJOR &&
+                        (0xffff & version) <= LFS_DISK_VERSION_MINOR);
+}
+
+/**
+ * Check the constraints lfs_init asserts on, so bad options come back as
+ * LFS_ERR_INVAL instead of aborting the module (or, in builds without
+ * asserts, running on with them broken)
+ */
+static int config_valid(const struct lfs_config *cfg) {
+    if (cfg->block_size < 128) return 0;
+    if (cfg->cache_size % cfg->read_size || cfg->cache_size % cfg->prog_size) return 0;
+    if (cfg->block_size % cfg->cache_size) return 0;
+    if (cfg->compact_thresh && cfg->compact_thresh != (lfs_size_t)-1 &&
+        (cfg->compact_thresh < cfg->block_size / 2 || cfg->compact_thresh > cfg->block_size)) {
+        return 0;
+    }
+    if (cfg->metadata_max) {
+        if (cfg->metadata_max > cfg->block_size) return 0;
+        if (cfg->metadata_max % cfg->read_size || cfg->metadata_max % cfg->prog_size) return 0;
+        if (cfg->block_size % cfg->metadata_max) return 0;
+    }
+    if (cfg->inline_max && cfg->inline_max != (lfs_size_t)-1) {
+        lfs_size_t meta = cfg->metadata_max ? cfg->metadata_max : cfg->block_size;
+        if (cfg->inline_max > cfg->cache_size || cfg->inline_max > LFS_ATTR_MAX ||
+            cfg->inline_max > meta / 8) {
+            return 0;
+        }
+    }
+    if (cfg->name_max > LFS_NAME_MAX) return 0;
+#ifdef LFS_MULTIVERSION
+    if (!disk_version_valid(cfg->disk_version)) return 0;
+#endif
+    return 1;
+}
+
+/**
+ * Lookahead bytes for one bit per block, in multiples of 8 bytes
+ */
+static inline uint32_t full_lookahead_size(uint32_t block_count) {
+    return (block_count + 63) / 64 * 8;
+}
+
+/**
+ * Reset handles and fill in the LittleFS configuration for the
+ * context's current geometry and tuning
+ * @return 0 on success, LFS_ERR_INVAL for an invalid configuration,
+ *         LFS_ERR_NOMEM if the dirty map can't be allocated
+ */
+static int ctx_configure(lfs_wasm_ctx_t *ctx, uint32_t la_size) {
+    const lfs_wasm_tuning_t *t = &ctx->tuning;
+
+    // Configure LittleFS
+    struct lfs_config *cfg = &ctx->cfg;
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->context = ctx;
+    switch (ctx->backend) {
+        case BACKEND_SPARSE:
+            cfg->read = sparse_read;
+            cfg->prog = sparse_prog;
+            cfg->erase = sparse_erase;
+            cfg->sync = ram_sync;
+            break;
+        case BACKEND_EXTERNAL:
+            cfg->read = ext_read;
+            cfg->prog = ext_prog;
+            cfg->erase = ext_erase;
+            cfg->sync = ext_sync;
+            break;
+        default:
+            cfg->read = ram_read;
+            cfg->prog = ram_prog;
+            cfg->erase = ram_erase;
+            cfg->sync = ram_sync;
+            break;
+    }
+    if (ctx->read_only || ctx->borrowed) {
+        cfg->prog = ro_prog;
+        cfg->erase = ro_erase;
+    }
+    cfg->read_size = t->read_size ? t->read_size : DEFAULT_READ_SIZE;
+    cfg->prog_size = t->prog_size ? t->prog_size : DEFAULT_PROG_SIZE;
+    cfg->block_size = ctx->block_size;
+    cfg->block_count = ctx->block_count;
+    cfg->cache_size = t->cache_size ? t->cache_size : ctx->block_size;
+    // With one bit per block a single traversal covers the whole device,
+    // so littlefs only rescans after allocating its way around all of it
+    ctx->full_lookahead = la_size == LOOKAHEAD_FULL;
+    cfg->lookahead_size = ctx->full_lookahead ? full_lookahead_size(ctx->block_count) : la_size;
+    cfg->block_cycles = t->block_cycles ? t->block_cycles : DEFAULT_BLOCK_CYCLES;
+    cfg->compact_thresh = t->compact_thresh;
+    cfg->metadata_max = t->metadata_max;
+    cfg->inline_max = t->inline_max;
+    cfg->name_max = t->name_max ? t->name_max : LFS_NAME_MAX;  // ESP-IDF uses 64
+    cfg->file_max = 0;             // Use default
+    cfg->attr_max = 0;             // Use default
+#ifdef LFS_MULTIVERSION
+    cfg->disk_version = 0;  // 0 = latest; set from the image on mount, from ctx on format
+#endif
+#ifdef LFS_THREADSAFE
+    cfg->lock = ctx_lock;
+    cfg->unlock = ctx_unlock;
+#endif
+
+    if (!config_valid(cfg)) return LFS_ERR_INVAL;
+
+    // Start with every block clean
+    ctx->dirty_map = (uint8_t *)calloc((ctx->block_count + 7) / 8, 1);
+    if (!ctx->dirty_map) return LFS_ERR_NOMEM;
+
+    // Initialize file and directory handles
+    memset(ctx->file_in_use, 0, sizeof(ctx->file_in_use));
+    memset(ctx->dir_in_use, 0, sizeof(ctx->dir_in_use));
+
+    return 0;
+}
+
+/**
+ * Resolve block size/count for an image and store them in the context
+ * @return Resulting storage size in bytes, or 0 if the geometry is invalid
+ */
+static uint32_t ctx_image_geometry(lfs_wasm_ctx_t *ctx, uint32_t image_size,
+                                   uint32_t blk_size, uint32_t blk_count) {
+    // Determine block size
+    ctx->block_size = blk_size > 0 ? blk_size : DEFAULT_BLOCK_SIZE;
+
+    // Determine block count
+    if (blk_count > 0) {
+        ctx->block_count = blk_count;
+    } else {
+        ctx->block_count = image_size / ctx->block_size;
+    }
+
+    return ctx->block_size * ctx->block_count;
+}
+
+/**
+ * lfs_mkdir for path[0..len) unless it's known to exist
+ * Errors are ignored; the subsequent open reports anything that matters.
+ * path is modified temporarily and restored.
+ */
+static void ctx_ensure_dir(lfs_wasm_ctx_t *ctx, char *path, uint32_t len) {
+    if (dir_cache_has(ctx, path, len)) return;
+    char saved = path[len];
+    path[len] = '\0';
+    int err = lfs_mkdir(&ctx->lfs, path);
+    path[len] = saved;
+    // EXIST may also be a file, but then every later open fails just the same
+    if (err == 0 || err == LFS_ERR_EXIST) dir_cache_add(ctx, path, len);
+}
+
+/**
+ * Create every parent directory of path (mkdir -p of dirname)
+ */
+static void ctx_mkdir_parents(lfs_wasm_ctx_t *ctx, const char *path) {
+    char dir_path[MAX_PATH_LENGTH];
+    strncpy(dir_path, path, MAX_PATH_LENGTH - 1);
+    dir_path[MAX_PATH_LENGTH - 1] = '\0';
+
+    for (char *p = dir_path + 1; *p; p++) {
+        if (*p == '/') ctx_ensure_dir(ctx, dir_path, p - dir_path);
+    }
+}
+
+static inline int is_dot_entry(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+/**
+ * Make room for need more bytes at the end of the list buffer
+ * @return Pointer to the reserved bytes, or NULL if out of memory
+ */
+static uint8_t *list_reserve(lfs_wasm_ctx_t *ctx, uint32_t need) {
+    uint32_t end = ctx->list_len + need;
+    if (end > ctx->list_cap) {
+        uint32_t cap = ctx->list_cap ? ctx->list_cap : 4096;
+        while (cap < end) cap *= 2;
+        uint8_t *buf = (uint8_t *)realloc(ctx->list_buf, cap);
+        if (!buf) return NULL;
+        ctx->list_buf = buf;
+        ctx->list_cap = cap;
+    }
+    uint8_t *p = ctx->list_buf + ctx->list_len;
+    ctx->list_len = end;
+    return p;
+}
+
+static void put_entry(uint8_t *p, uint8_t type, uint32_t size, const char *path, uint32_t path_len) {
+    p[0] = type;
+    p[1] = (uint8_t)(size >> 0);
+    p[2] = (uint8_t)(size >> 8);
+    p[3] = (uint8_t)(size >> 16);
+    p[4] = (uint8_t)(size >> 24);
+    p[5] = (uint8_t)(path_len >> 0);
+    p[6] = (uint8_t)(path_len >> 8);
+    memcpy(p + LIST_ENTRY_HEADER, path, path_len);
+}
+
+/**
+ * Append one packed entry to the list buffer
+ * Layout (little-endian): u8 type, u32 size, u16 path_len, path bytes
+ */
+static int list_append(lfs_wasm_ctx_t *ctx, uint8_t type, uint32_t size,
+                       const char *path, uint32_t path_len) {
+    uint8_t *p = list_reserve(ctx, LIST_ENTRY_HEADER + path_len);
+    if (!p) return LFS_ERR_NOMEM;
+    put_entry(p, type, size, path, path_len);
+    return 0;
+}
+
+/**
+ * Append the requested custom attributes of path after its listing entry:
+ * u8 count, then one packed attribute record per type that is set
+ * @param types Attribute types to fetch
+ */
+static int list_append_attrs(lfs_wasm_ctx_t *ctx, const char *path,
+                             const uint8_t *types, uint32_t type_count) {
+    uint32_t count_at = ctx->list_len;
+    if (!list_reserve(ctx, 1)) return LFS_ERR_NOMEM;
+
+    uint8_t count = 0;
+    for (uint32_t i = 0; i < type_count; i++) {
+        // Read straight into the buffer, then give back the unused tail
+        uint8_t *p = list_reserve(ctx, ATTR_RECORD_HEADER + LFS_ATTR_MAX);
+        if (!p) return LFS_ERR_NOMEM;
+        lfs_ssize_t size = lfs_getattr(&ctx->lfs, path, types[i],
+                                       p + ATTR_RECORD_HEADER, LFS_ATTR_MAX);
+        if (size < 0) {
+            ctx->list_len -= ATTR_RECORD_HEADER + LFS_ATTR_MAX;
+            if (size == LFS_ERR_NOATTR) continue;
+            return size;
+        }
+        p[0] = types[i];
+        p[1] = (uint8_t)(size >> 0);
+        p[2] = (uint8_t)(size >> 8);
+        ctx->list_len -= LFS_ATTR_MAX - size;
+        count++;
+    }
+    ctx->list_buf[count_at] = count;
+    return 0;
+}
+
+/**
+ * Depth-first walk of the directory in path[0..path_len), appending every
+ * entry in the same pre-order the JS listing always produced
+ * @param path Shared path buffer of MAX_PATH_LENGTH bytes, NUL-terminated
+ *             at path_len; restored before returning
+ * @param types Custom attribute types to append to each entry (may be
+ *              NULL when type_count is 0)
+ */
+static int list_walk(lfs_wasm_ctx_t *ctx, char *path, uint32_t path_len, int recursive,
+                     const uint8_t *types, uint32_t type_count) {
+    lfs_dir_t dir;
+    int err = lfs_dir_open(&ctx->lfs, &dir, path_len ? path : "/");
+    if (err < 0) return err;
+
+    struct lfs_info info;
+    while ((err = lfs_dir_read(&ctx->lfs, &dir, &info)) > 0) {
+        if (is_dot_entry(info.name)) continue;
+
+        uint32_t name_len = strlen(info.name);
+        uint32_t child_len = path_len + 1 + name_len;
+        if (child_len >= MAX_PATH_LENGTH) {
+            err = LFS_ERR_NAMETOOLONG;
+            break;
+        }
+        path[path_len] = '/';
+        memcpy(path + path_len + 1, info.name, name_len + 1);
+
+        int is_dir = info.type == LFS_TYPE_DIR;
+        err = list_append(ctx, is_dir ? 2 : 1, is_dir ? 0 : info.size, path, child_len);
+        if (!err && type_count) {
+            err = list_append_attrs(ctx, path, types, type_count);
+        }
+        if (!err && is_dir && recursive) {
+            err = list_walk(ctx, path, child_len, recursive, types, type_count);
+        }
+        path[path_len] = '\0';
+        if (err) break;
+    }
+
+    lfs_dir_close(&ctx->lfs, &dir);
+    return err;
+}
+
+/**
+ * Copy path into a MAX_PATH_LENGTH walk buffer without trailing slashes
+ * ("/" becomes the empty string, the root for the tree walks)
+ * @return Length copied, or LFS_ERR_NAMETOOLONG
+ */
+static int walk_path_init(char *buf, const char *path) {
+    uint32_t len = strlen(path);
+    if (len >= MAX_PATH_LENGTH) return LFS_ERR_NAMETOOLONG;
+    memcpy(buf, path, len + 1);
+    while (len > 0 && buf[len - 1] == '/') {
+        buf[--len] = '\0';
+    }
+    return len;
+}
+
+/**
+ * Whether path[0..len) is root[0..root_len) or lies below it
+ */
+static inline int path_within(const char *path, uint32_t len, const char *root, uint32_t root_len) {
+    return len >= root_len && memcmp(path, root, root_len) == 0 &&
+           (len == root_len || path[root_len] == '/' || root_len == 0);
+}
+
+/**
+ * Parse packed attribute records (u8 type, u16 size, value bytes) into
+ * lfs_attr entries that point into buf
+ * @param attrs Room for MAX_FILE_ATTRS entries
+ * @return Number of attributes, or LFS_ERR_INVAL if malformed or too many
+ */
+static int attrs_unpack(const uint8_t *buf, uint32_t len, struct lfs_attr *attrs) {
+    uint32_t count = 0;
+    uint32_t off = 0;
+    while (off < len) {
+        if (count == MAX_FILE_ATTRS || off + ATTR_RECORD_HEADER > len) return LFS_ERR_INVAL;
+        uint32_t size = (uint32_t)buf[off + 1] | (uint32_t)buf[off + 2] << 8;
+        if (off + ATTR_RECORD_HEADER + size > len) return LFS_ERR_INVAL;
+        attrs[count].type = buf[off];
+        attrs[count].buffer = (void *)(buf + off + ATTR_RECORD_HEADER);
+        attrs[count].size = size;
+        count++;
+        off += ATTR_RECORD_HEADER + size;
+    }
+    return count;
+}
+
+/**
+ * Create, truncate and write a whole file in one open/close cycle
+ * The attributes are committed together with the file on close, so they
+ * cost no metadata commit of their own.
+ * @param attrs Custom attributes to set (may be NULL when attr_count is 0)
+ * @return 0 on success, negative error code on failure
+ */
+static int ctx_write_whole(lfs_wasm_ctx_t *ctx, const char *path,
+                           const uint8_t *data, uint32_t size,
+                           struct lfs_attr *attrs, uint32_t attr_count) {
+    struct lfs_file_config file_cfg = {0};
+    file_cfg.attrs = attrs;
+    file_cfg.attr_count = attr_count;
+
+    lfs_file_t file;
+    int err = lfs_file_opencfg(&ctx->lfs, &file, path,
+                               LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC, &file_cfg);
+    if (err < 0) return err;
+
+    lfs_ssize_t written = lfs_file_write(&ctx->lfs, &file, data, size);
+    // Close commits the file, so its result matters as much as the write
+    err = lfs_file_close(&ctx->lfs, &file);
+
+    if (written < 0) return written;
+    if (err < 0) return err;
+    if ((uint32_t)written != size) return LFS_ERR_IO;
+
+    return 0;
+}
+
+/**
+ * Restart block allocation from block 0 on the next allocation
+ * Does what lfs_alloc_drop does internally, with the window moved to the
+ * device start: after a resize the old window may cover blocks that no
+ * longer exist, and repacked images stay packed at the low end.
+ */
+static void ctx_alloc_rewind(lfs_wasm_ctx_t *ctx) {
+    ctx->lfs.lookahead.start = 0;
+    ctx->lfs.lookahead.size = 0;
+    ctx->lfs.lookahead.next = 0;
+    ctx->lfs.lookahead.ckpoint = ctx->lfs.block_count;
+}
+
+/**
+ * Reallocate the storage, dirty map and erase counters for block_count
+ * blocks. New blocks read as erased and start clean; the block counts in
+ * the context are left to the caller.
+ * @return 0 on success, LFS_ERR_NOMEM on failure (storage unchanged in
+ *         size from littlefs's point of view)
+ */
+static int ctx_resize_storage(lfs_wasm_ctx_t *ctx, uint32_t block_count) {
+    uint32_t old_count = ctx->block_count;
+    size_t new_size = (size_t)ctx->block_size * block_count;
+    ctx->write_epoch++;
+
+    if (ctx->backend == BACKEND_SPARSE) {
+        for (uint32_t i = block_count; i < old_count; i++) {
+            if (ctx->sparse_blocks[i]) {
+                free(ctx->sparse_blocks[i]);
+                ctx->sparse_blocks[i] = NULL;
+                ctx->sparse_allocated--;
+            }
+        }
+        uint8_t **blocks = (uint8_t **)realloc(ctx->sparse_blocks, block_count * sizeof(uint8_t *));
+        if (!blocks) return LFS_ERR_NOMEM;
+        for (uint32_t i = old_count; i < block_count; i++) blocks[i] = NULL;
+        ctx->sparse_blocks = blocks;
+    } else {
+        uint8_t *storage = (uint8_t *)realloc(ctx->ram_storage, new_size);
+        if (!storage) return LFS_ERR_NOMEM;
+        if (block_count > old_count) {
+            size_t old_size = (size_t)ctx->block_size * old_count;
+            memset(storage + old_size, 0xFF, new_size - old_size);
+        }
+        ctx->ram_storage = storage;
+    }
+
+    // Bits past the new end would resurface on a later grow
+    for (uint32_t i = block_count; i < old_count; i++) {
+        ctx->dirty_map[i >> 3] &= (uint8_t)~(1u << (i & 7));
+    }
+    uint32_t old_bytes = (old_count + 7) / 8, new_bytes = (block_count + 7) / 8;
+    uint8_t *map = (uint8_t *)realloc(ctx->dirty_map, new_bytes);
+    if (!map) return LFS_ERR_NOMEM;
+    if (new_bytes > old_bytes) memset(map + old_bytes, 0, new_bytes - old_bytes);
+    ctx->dirty_map = map;
+
+    if (ctx->io) {
+        uint32_t *counts = (uint32_t *)realloc(ctx->io->erase_counts, block_count * sizeof(uint32_t));
+        if (!counts) return LFS_ERR_NOMEM;
+        for (uint32_t i = old_count; i < block_count; i++) counts[i] = 0;
+        ctx->io->erase_counts = counts;
+    }
+    if (ctx->fault) {
+        uint32_t *erases = (uint32_t *)realloc(ctx->fault->erases, block_count * sizeof(uint32_t));
+        if (!erases) return LFS_ERR_NOMEM;
+        for (uint32_t i = old_count; i < block_count; i++) erases[i] = 0;
+        ctx->fault->erases = erases;
+        uint8_t *bad = (uint8_t *)realloc(ctx->fault->bad, block_count);
+        if (!bad) return LFS_ERR_NOMEM;
+        if (block_count > old_count) memset(bad + old_count, 0, block_count - old_count);
+        ctx->fault->bad = bad;
+    }
+    return 0;
+}
+
+/**
+ * Index the entries of a packed buffer so they can be sorted in place
+ * @param prefix Bytes before the list entry layout in each entry (0 for
+ *               lfs_wasm_list_tree output, 1 for change sets)
+ * @param out_entries Output: array of entry pointers to free()
+ * @param out_count Output: number of entries
+ * @return 0 on success, LFS_ERR_INVAL if the buffer is truncated,
+ *         LFS_ERR_NOMEM if out of memory
+ */
+static int entry_index(const uint8_t *buf, uint32_t len, uint32_t prefix,
+                       const uint8_t ***out_entries, uint32_t *out_count) {
+    uint32_t count = 0;
+    for (uint32_t off = 0; off < len; count++) {
+        if (off + prefix + LIST_ENTRY_HEADER > len) return LFS_ERR_INVAL;
+        off += prefix + LIST_ENTRY_HEADER + ENTRY_PATH_LEN(buf + off + prefix);
+        if (off > len) return LFS_ERR_INVAL;
+    }
+    const uint8_t **entries = (const uint8_t **)malloc((count + 1) * sizeof(*entries));
+    if (!entries) return LFS_ERR_NOMEM;
+    for (uint32_t i = 0, off = 0; i < count; i++) {
+        entries[i] = buf + off;
+        off += prefix + LIST_ENTRY_HEADER + ENTRY_PATH_LEN(buf + off + prefix);
+    }
+    *out_entries = entries;
+    *out_count = count;
+    return 0;
+}
+
+static int entry_path_cmp(const uint8_t *ea, const uint8_t *eb) {
+    uint32_t la = ENTRY_PATH_LEN(ea), lb = ENTRY_PATH_LEN(eb);
+    int cmp = memcmp(ea + LIST_ENTRY_HEADER, eb + LIST_ENTRY_HEADER, la < lb ? la : lb);
+    if (cmp) return cmp;
+    return la < lb ? -1 : la > lb;
+}
+
+// qsort callback: list entries in plain path order
+static int path_order(const void *a, const void *b) {
+    return entry_path_cmp(*(const uint8_t *const *)a, *(const uint8_t *const *)b);
+}
+
+/**
+ * Compare the contents of two files of equal size
+ * @param buf_a, buf_b Staging buffers of buf_size bytes each
+ * @return 1 if equal, 0 if not, or negative error code
+ */
+static int files_equal(lfs_wasm_ctx_t *a, lfs_wasm_ctx_t *b, const char *path,
+                       uint8_t *buf_a, uint8_t *buf_b, uint32_t buf_size) {
+    lfs_file_t fa, fb;
+    int err = lfs_file_open(&a->lfs, &fa, path, LFS_O_RDONLY);
+    if (err < 0) return err;
+    err = lfs_file_open(&b->lfs, &fb, path, LFS_O_RDONLY);
+    if (err < 0) {
+        lfs_file_close(&a->lfs, &fa);
+        return err;
+    }
+
+    int result = 1;
+    while (result == 1) {
+        lfs_ssize_t na = lfs_file_read(&a->lfs, &fa, buf_a, buf_size);
+        lfs_ssize_t nb = lfs_file_read(&b->lfs, &fb, buf_b, buf_size);
+        if (na < 0 || nb < 0) {
+            result = na < 0 ? na : nb;
+        } else if (na != nb || memcmp(buf_a, buf_b, na) != 0) {
+            result = 0;
+        } else if (na == 0) {
+            break;
+        }
+    }
+
+    lfs_file_close(&a->lfs, &fa);
+    lfs_file_close(&b->lfs, &fb);
+    return result;
+}
+
+/**
+ * Append a change (op byte + copy of the list entry) to the list buffer
+ */
+static int change_append(lfs_wasm_ctx_t *ctx, uint8_t op, const uint8_t *entry) {
+    uint32_t size = LIST_ENTRY_HEADER + ENTRY_PATH_LEN(entry);
+    uint8_t *p = list_reserve(ctx, 1 + size);
+    if (!p) return LFS_ERR_NOMEM;
+    p[0] = op;
+    memcpy(p + 1, entry, size);
+    return 0;
+}
+
+/**
+ * Take ownership of the list buffer, leaving the context an empty one
+ */
+static uint8_t *list_take(lfs_wasm_ctx_t *ctx) {
+    uint8_t *buf = ctx->list_buf;
+    ctx->list_buf = NULL;
+    ctx->list_cap = 0;
+    ctx->list_len = 0;
+    return buf;
+}
+
+/**
+ * Order packed list entries for lfs_wasm_repack: directories first, by
+ * path (so parents precede children), then files grouped by directory
+ * and sorted by name within it
+ */
+static int repack_compare(const void *a, const void *b) {
+    const uint8_t *ea = *(const uint8_t *const *)a;
+    const uint8_t *eb = *(const uint8_t *const *)b;
+    if (ea[0] != eb[0]) return ea[0] == 2 ? -1 : 1;
+
+    uint32_t la = ENTRY_PATH_LEN(ea);
+    uint32_t lb = ENTRY_PATH_LEN(eb);
+    const char *pa = (const char *)ea + LIST_ENTRY_HEADER;
+    const char *pb = (const char *)eb + LIST_ENTRY_HEADER;
+
+    // For files, compare the parent directories before the names
+    uint32_t da = 0, db = 0;
+    if (ea[0] == 1) {
+        for (uint32_t i = 0; i < la; i++) if (pa[i] == '/') da = i;
+        for (uint32_t i = 0; i < lb; i++) if (pb[i] == '/') db = i;
+        int cmp = memcmp(pa, pb, da < db ? da : db);
+        if (cmp) return cmp;
+        if (da != db) return da < db ? -1 : 1;
+    }
+
+    la -= da;
+    lb -= db;
+    int cmp = memcmp(pa + da, pb + db, la < lb ? la : lb);
+    if (cmp) return cmp;
+    return la < lb ? -1 : la > lb;
+}
+
+/**
+ * Custom attribute types to carry across a copy, with room for their values
+ * littlefs can't enumerate attributes, so only the named types are read.
+ */
+typedef struct attr_carry {
+    const uint8_t *types;
+    uint32_t count;                          // at most MAX_FILE_ATTRS
+    uint8_t *values;                         // count * LFS_ATTR_MAX bytes
+    struct lfs_attr attrs[MAX_FILE_ATTRS];
+    uint32_t found;                          // attrs filled by attr_carry_fetch
+} attr_carry_t;
+
+/**
+ * Set up a carry for type_count types
+ * @return 0 on success (with nothing allocated for no types), or
+ *         LFS_ERR_INVAL / LFS_ERR_NOMEM
+ */
+static int attr_carry_init(attr_carry_t *carry, const uint8_t *types, uint32_t type_count) {
+    memset(carry, 0, sizeof(*carry));
+    if (type_count > MAX_FILE_ATTRS) return LFS_ERR_INVAL;
+    if (type_count == 0) return 0;
+    carry->values = (uint8_t *)malloc((size_t)type_count * LFS_ATTR_MAX);
+    if (!carry->values) return LFS_ERR_NOMEM;
+    carry->types = types;
+    carry->count = type_count;
+    return 0;
+}
+
+static void attr_carry_free(attr_carry_t *carry) {
+    free(carry->values);
+    carry->values = NULL;
+}
+
+/**
+ * Read the carried types that path has set into carry->attrs
+ * @return 0 on success, negative error code on failure
+ */
+static int attr_carry_fetch(attr_carry_t *carry, lfs_t *lfs, const char *path) {
+    carry->found = 0;
+    for (uint32_t i = 0; i < carry->count; i++) {
+        uint8_t *value = carry->values + (size_t)i * LFS_ATTR_MAX;
+        lfs_ssize_t size = lfs_getattr(lfs, path, carry->types[i], value, LFS_ATTR_MAX);
+        if (size == LFS_ERR_NOATTR) continue;
+        if (size < 0) return size;
+        struct lfs_attr *attr = &carry->attrs[carry->found++];
+        attr->type = carry->types[i];
+        attr->buffer = value;
+        attr->size = size;
+    }
+    return 0;
+}
+
+/**
+ * Remove the carried types that the last attr_carry_fetch didn't find from
+ * path, so a replaced entry doesn't keep attributes its source lacks
+ */
+static int attr_carry_prune(attr_carry_t *carry, lfs_t *lfs, const char *path) {
+    for (uint32_t i = 0; i < carry->count; i++) {
+        uint32_t k = 0;
+        while (k < carry->found && carry->attrs[k].type != carry->types[i]) k++;
+        if (k < carry->found) continue;
+
+        uint8_t probe;
+        lfs_ssize_t size = lfs_getattr(lfs, path, carry->types[i], &probe, 0);
+        if (size == LFS_ERR_NOATTR) continue;
+        int err = size < 0 ? (int)size : lfs_removeattr(lfs, path, carry->types[i]);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+/**
+ * Copy the carried attributes of directory src_path in src to dst_path in
+ * dst, one lfs_setattr commit each (files take theirs with the file's own
+ * commit). src and dst may be the same context.
+ * @param prune Also remove carried types src doesn't have
+ */
+static int attr_carry_dir(attr_carry_t *carry, lfs_wasm_ctx_t *dst, const char *dst_path,
+                          lfs_wasm_ctx_t *src, const char *src_path, int prune) {
+    if (!carry || !carry->count) return 0;
+    int err = attr_carry_fetch(carry, &src->lfs, src_path);
+    for (uint32_t i = 0; i < carry->found && err >= 0; i++) {
+        err = lfs_setattr(&dst->lfs, dst_path, carry->attrs[i].type,
+                          carry->attrs[i].buffer, carry->attrs[i].size);
+    }
+    if (err >= 0 && prune) err = attr_carry_prune(carry, &dst->lfs, dst_path);
+    return err;
+}
+
+/**
+ * Compare the carried attributes of path in a and b
+ * @param ca, cb Carries over the same types, one per side
+ * @return 1 if every carried type is equal or unset on both sides, 0 if
+ *         not, or negative error code
+ */
+static int attrs_equal(attr_carry_t *ca, attr_carry_t *cb,
+                       lfs_wasm_ctx_t *a, lfs_wasm_ctx_t *b, const char *path) {
+    int err = attr_carry_fetch(ca, &a->lfs, path);
+    if (err == 0) err = attr_carry_fetch(cb, &b->lfs, path);
+    if (err < 0) return err;
+    if (ca->found != cb->found) return 0;
+    // Both were fetched in type order, so set types line up
+    for (uint32_t i = 0; i < ca->found; i++) {
+        const struct lfs_attr *x = &ca->attrs[i], *y = &cb->attrs[i];
+        if (x->type != y->type || x->size != y->size ||
+            memcmp(x->buffer, y->buffer, x->size) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Copy one file's contents from src_path in src to dst_path in dst
+ * src and dst may be the same context.
+ * @param flags Open flags for the destination on top of LFS_O_WRONLY |
+ *              LFS_O_CREAT (LFS_O_EXCL for new trees, LFS_O_TRUNC to replace)
+ * @param buf Staging buffer of buf_size bytes
+ * @param carry Attribute types to copy along, committed with the file; a
+ *              replaced file also loses carried types the source lacks.
+ *              NULL copies contents only.
+ */
+static int ctx_copy_file(lfs_wasm_ctx_t *dst, const char *dst_path,
+                         lfs_wasm_ctx_t *src, const char *src_path,
+                         int flags, uint8_t *buf, uint32_t buf_size,
+                         attr_carry_t *carry) {
+    struct lfs_file_config file_cfg = {0};
+    if (carry && carry->count) {
+        int err = attr_carry_fetch(carry, &src->lfs, src_path);
+        if (err < 0) return err;
+        file_cfg.attrs = carry->attrs;
+        file_cfg.attr_count = carry->found;
+    }
+
+    lfs_file_t in, out;
+    int err = lfs_file_open(&src->lfs, &in, src_path, LFS_O_RDONLY);
+    if (err < 0) return err;
+    err = lfs_file_opencfg(&dst->lfs, &out, dst_path, LFS_O_WRONLY | LFS_O_CREAT | flags, &file_cfg);
+    if (err < 0) {
+        lfs_file_close(&src->lfs, &in);
+        return err;
+    }
+
+    lfs_ssize_t n;
+    while ((n = lfs_file_read(&src->lfs, &in, buf, buf_size)) > 0) {
+        lfs_ssize_t written = lfs_file_write(&dst->lfs, &out, buf, n);
+        if (written < 0) {
+            n = written;
+            break;
+        }
+    }
+    err = lfs_file_close(&dst->lfs, &out);
+    lfs_file_close(&src->lfs, &in);
+
+    if (n < 0) return n;
+    if (err == 0 && carry && carry->count && (flags & LFS_O_TRUNC)) {
+        err = attr_carry_prune(carry, &dst->lfs, dst_path);
+    }
+    return err;
+}
+
+/**
+ * Depth-first removal of everything below the directory in path[0..path_len)
+ * littlefs moves open directory iterators past removed entries, so one
+ * pass over each directory suffices.
+ * @param path Shared path buffer as for list_walk; restored before returning
+ * @param count Incremented per removed entry
+ */
+static int tree_remove(lfs_wasm_ctx_t *ctx, char *path, uint32_t path_len, uint32_t *count) {
+    lfs_dir_t dir;
+    int err = lfs_dir_open(&ctx->lfs, &dir, path_len ? path : "/");
+    if (err < 0) return err;
+
+    struct lfs_info info;
+    while ((err = lfs_dir_read(&ctx->lfs, &dir, &info)) > 0) {
+        if (is_dot_entry(info.name)) continue;
+
+        uint32_t name_len = strlen(info.name);
+        uint32_t child_len = path_len + 1 + name_len;
+        if (child_len >= MAX_PATH_LENGTH) {
+            err = LFS_ERR_NAMETOOLONG;
+            break;
+        }
+        path[path_len] = '/';
+        memcpy(path + path_len + 1, info.name, name_len + 1);
+
+        err = info.type == LFS_TYPE_DIR ? tree_remove(ctx, path, child_len, count) : 0;
+        if (!err) err = lfs_remove(&ctx->lfs, path);
+        if (!err) {
+            dir_cache_forget(ctx, path);
+            (*count)++;
+        }
+        path[path_len] = '\0';
+        if (err) break;
+    }
+
+    lfs_dir_close(&ctx->lfs, &dir);
+    return err;
+}
+
+/**
+ * Depth-first copy of the directory in src[0..src_len) into the existing,
+ * empty directory dst[0..dst_len), file contents streamed through buf
+ * @param src, dst Shared path buffers as for list_walk; restored before
+ *                 returning
+ * @param carry Attribute types to copy along with each entry
+ * @param count Incremented per copied entry
+ */
+static int tree_copy(lfs_wasm_ctx_t *ctx, char *src, uint32_t src_len,
+                     char *dst, uint32_t dst_len, uint8_t *buf, uint32_t buf_size,
+                     attr_carry_t *carry, uint32_t *count) {
+    lfs_dir_t dir;
+    int err = lfs_dir_open(&ctx->lfs, &dir, src_len ? src : "/");
+    if (err < 0) return err;
+
+    struct lfs_info info;
+    while ((err = lfs_dir_read(&ctx->lfs, &dir, &info)) > 0) {
+        if (is_dot_entry(info.name)) continue;
+
+        uint32_t name_len = strlen(info.name);
+        uint32_t src_child = src_len + 1 + name_len;
+        uint32_t dst_child = dst_len + 1 + name_len;
+        if (src_child >= MAX_PATH_LENGTH || dst_child >= MAX_PATH_LENGTH) {
+            err = LFS_ERR_NAMETOOLONG;
+            break;
+        }
+        src[src_len] = '/';
+        memcpy(src + src_len + 1, info.name, name_len + 1);
+        dst[dst_len] = '/';
+        memcpy(dst + dst_len + 1, info.name, name_len + 1);
+
+        if (info.type == LFS_TYPE_DIR) {
+            err = lfs_mkdir(&ctx->lfs, dst);
+            if (!err) {
+                dir_cache_add(ctx, dst, dst_child);
+                err = attr_carry_dir(carry, ctx, dst, ctx, src, 0);
+            }
+            if (!err) err = tree_copy(ctx, src, src_child, dst, dst_child, buf, buf_size, carry, count);
+        } else {
+            err = ctx_copy_file(ctx, dst, ctx, src, LFS_O_EXCL, buf, buf_size, carry);
+        }
+        if (!err) (*count)++;
+        src[src_len] = '\0';
+        dst[dst_len] = '\0';
+        if (err) break;
+    }
+
+    lfs_dir_close(&ctx->lfs, &dir);
+    return err;
+}
+
+/**
+ * mkdir -p for path[0..dir_len), skipping the leading components it shares
+ * with the directory created by the previous call (kept in prev/prev_len)
+ * path is modified temporarily and restored.
+ */
+static void batch_mkdirs(lfs_wasm_ctx_t *ctx, char *path, uint32_t dir_len,
+                         char *prev, uint32_t *prev_len) {
+    // Longest common prefix that ends on a component boundary in both
+    uint32_t common = 0;
+    uint32_t limit = dir_len < *prev_len ? dir_len : *prev_len;
+    for (uint32_t i = 0; i <= limit; i++) {
+        int end_a = i == dir_len || path[i] == '/';
+        int end_b = i == *prev_len || prev[i] == '/';
+        if (end_a && end_b) common = i;
+        if (i == limit || path[i] != prev[i]) break;
+    }
+
+    for (uint32_t i = common + 1; i <= dir_len; i++) {
+        if (i == dir_len || path[i] == '/') ctx_ensure_dir(ctx, path, i);
+    }
+
+    memcpy(prev, path, dir_len);
+    *prev_len = dir_len;
+}
+
+/**
+ * Read a whole file into a new buffer, resolving the path once
+ * @param out_size Output: bytes read, or negative error code
+ * @return Buffer to release with free(), or NULL on error or for an
+ *         empty file
+ */
+static uint8_t *read_alloc(lfs_t *lfs, const char *path, int *out_size) {
+    lfs_file_t file;
+    int err = lfs_file_open(lfs, &file, path, LFS_O_RDONLY);
+    if (err < 0) {
+        *out_size = err;
+        return NULL;
+    }
+
+    uint8_t *data = NULL;
+    lfs_soff_t size = lfs_file_size(lfs, &file);
+    if (size > 0) {
+        data = (uint8_t *)malloc(size);
+        if (!data) {
+            size = LFS_ERR_NOMEM;
+        } else {
+            lfs_ssize_t read = lfs_file_read(lfs, &file, data, size);
+            if (read < 0) {
+                free(data);
+                data = NULL;
+            }
+            size = read;
+        }
+    }
+    lfs_file_close(lfs, &file);
+
+    *out_size = size;
+    return data;
+}
+
+/**
+ * Look up an open file handle
+ * @return File pointer, or NULL if the handle is not open
+ */
+static lfs_file_t* ctx_file(lfs_wasm_ctx_t *ctx, int handle) {
+    if (handle < 0 || handle >= MAX_FILES || !ctx->file_in_use[handle]) {
+        return NULL;
+    }
+    return &ctx->open_files[handle];
+}
+
+// ============================================================================
+// Integrity Check
+// ============================================================================
+
+typedef struct check_state {
+    lfs_wasm_ctx_t *ctx;
+    uint8_t *claimed;    // one bit per block, set by the entry that owns it
+    uint8_t *reached;    // one bit per block, set by lfs_fs_traverse
+    lfs_wasm_check_summary_t *summary;
+} check_state_t;
+
+// Set a bitmap bit, returning whether it was already set
+static inline int map_test_set(uint8_t *map, lfs_block_t block) {
+    uint8_t bit = (uint8_t)(1u << (block & 7));
+    int was = (map[block >> 3] & bit) != 0;
+    map[block >> 3] |= bit;
+    return was;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 0);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Start a check record in the list buffer
+ * @return Offset of the record, or LFS_ERR_NOMEM
+ */
+static int check_record(lfs_wasm_ctx_t *ctx, uint8_t type, int err, uint32_t size,
+                        const char *path, uint32_t path_len) {
+    uint8_t *p = list_reserve(ctx, CHECK_RECORD_HEADER + path_len);
+    if (!p) return LFS_ERR_NOMEM;
+    p[0] = type;
+    put_u32(p + 1, (uint32_t)err);
+    put_u32(p + 5, size);
+    put_u32(p + 9, 0);
+    p[13] = (uint8_t)(path_len >> 0);
+    p[14] = (uint8_t)(path_len >> 8);
+    memcpy(p + CHECK_RECORD_HEADER, path, path_len);
+    return (int)(p - ctx->list_buf);
+}
+
+// Keep the first error of a record
+static void check_record_error(lfs_wasm_ctx_t *ctx, uint32_t rec, int err) {
+    uint8_t *p = ctx->list_buf + rec;
+    if (err < 0 && get_u32(p + 1) == 0) put_u32(p + 1, (uint32_t)err);
+}
+
+/**
+ * Add a block to a record and claim it for that entry
+ * @return 0, LFS_ERR_CORRUPT if it is out of range or already claimed
+ *         (the record's error is set), or LFS_ERR_NOMEM
+ */
+static int check_claim(check_state_t *st, uint32_t rec, lfs_block_t block) {
+    lfs_wasm_ctx_t *ctx = st->ctx;
+    uint8_t *p = list_reserve(ctx, 4);
+    if (!p) return LFS_ERR_NOMEM;
+    put_u32(p, block);
+    uint8_t *count = ctx->list_buf + rec + 9;
+    put_u32(count, get_u32(count) + 1);
+
+    if (block >= ctx->block_count) {
+        st->summary->out_of_range++;
+    } else if (map_test_set(st->claimed, block)) {
+        st->summary->shared++;
+    } else {
+        return 0;
+    }
+    check_record_error(ctx, rec, LFS_ERR_CORRUPT);
+    return LFS_ERR_CORRUPT;
+}
+
+// lfs_ctz_index: CTZ skip-list index of the block holding byte off
+static lfs_off_t ctz_index(lfs_size_t block_size, lfs_off_t off) {
+    lfs_off_t b = block_size - 2*4;
+    lfs_off_t i = off / b;
+    if (i == 0) return 0;
+    return (off - 4*(lfs_popc(i-1)+2)) / b;
+}
+
+/**
+ * Claim a file's CTZ skip-list from the last block back, as
+ * lfs_ctz_traverse walks it
+ * @return 0, LFS_ERR_NOMEM, or the first error met along the chain
+ */
+static int check_ctz(check_state_t *st, uint32_t rec, lfs_block_t head, lfs_size_t size) {
+    lfs_wasm_ctx_t *ctx = st->ctx;
+    lfs_off_t index = ctz_index(ctx->block_size, size - 1);
+    int result = 0;
+    while (1) {
+        int err = check_claim(st, rec, head);
+        if (err == LFS_ERR_NOMEM) return err;
+        if (err && !result) result = err;
+        // A pointer off the device ends the chain; a shared block doesn't
+        if (index == 0 || head >= ctx->block_count) return result;
+
+        lfs_block_t heads[2];
+        int count = 2 - (index & 1);
+        err = ctx->cfg.read(&ctx->cfg, head, 0, heads, count * sizeof(lfs_block_t));
+        if (err) return err;
+        for (int i = 0; i < count - 1; i++) {
+            err = check_claim(st, rec, lfs_fromle32(heads[i]));
+            if (err == LFS_ERR_NOMEM) return err;
+            if (err && !result) result = err;
+        }
+        head = lfs_fromle32(heads[count - 1]);
+        index -= count;
+    }
+}
+
+/**
+ * Record a file and the blocks of its contents
+ * @return 0, or LFS_ERR_NOMEM (errors in the file go to its record)
+ */
+static int check_file(check_state_t *st, const char *path, uint32_t path_len, uint32_t size) {
+    lfs_wasm_ctx_t *ctx = st->ctx;
+    int rec = check_record(ctx, LFS_TYPE_REG, 0, size, path, path_len);
+    if (rec < 0) return rec;
+
+    lfs_file_t file;
+    int err = lfs_file_open(&ctx->lfs, &file, path, LFS_O_RDONLY);
+    if (err) {
+        check_record_error(ctx, rec, err);
+        return err == LFS_ERR_NOMEM ? err : 0;
+    }
+    if (!(file.flags & LFS_F_INLINE) && file.ctz.size > 0) {
+        err = check_ctz(st, rec, file.ctz.head, file.ctz.size);
+    }
+    lfs_file_close(&ctx->lfs, &file);
+    if (err == LFS_ERR_NOMEM) return err;
+    check_record_error(ctx, rec, err);
+    return 0;
+}
+
+/**
+ * Append a metadata pair to a growing list unless it is the last one
+ * @return 0 or LFS_ERR_NOMEM
+ */
+static int pairs_add(lfs_block_t **pairs, uint32_t *count, uint32_t *cap, const lfs_block_t pair[2]) {
+    lfs_block_t *last = *count ? *pairs + *count - 2 : NULL;
+    if (last && ((last[0] == pair[0] && last[1] == pair[1]) ||
+                 (last[0] == pair[1] && last[1] == pair[0]))) {
+        return 0;
+    }
+    if (*count == *cap) {
+        uint32_t grown_cap = *cap ? *cap * 2 : 8;
+        lfs_block_t *grown = (lfs_block_t *)realloc(*pairs, grown_cap * sizeof(lfs_block_t));
+        if (!grown) return LFS_ERR_NOMEM;
+        *pairs = grown;
+        *cap = grown_cap;
+    }
+    (*pairs)[(*count)++] = pair[0];
+    (*pairs)[(*count)++] = pair[1];
+    return 0;
+}
+
+/**
+ * Record the directory in path[0..path_len) after everything below it,
+ * with the metadata pairs its log spans
+ * @param path Shared path buffer of MAX_PATH_LENGTH bytes, NUL-terminated
+ *             at path_len; restored before returning
+ * @return 0, or LFS_ERR_NOMEM (other errors go to the records)
+ */
+static int check_walk(check_state_t *st, char *path, uint32_t path_len) {
+    lfs_wasm_ctx_t *ctx = st->ctx;
+    lfs_block_t *pairs = NULL;
+    uint32_t pair_count = 0, pair_cap = 0;
+    int err = 0;
+
+    lfs_dir_t dir;
+    int dir_err = lfs_dir_open(&ctx->lfs, &dir, path_len ? path : "/");
+    if (!dir_err) {
+        struct lfs_info info;
+        err = pairs_add(&pairs, &pair_count, &pair_cap, dir.m.pair);
+        while (!err && (dir_err = lfs_dir_read(&ctx->lfs, &dir, &info)) > 0) {
+            // lfs_dir_read moves on to the next pair of a split directory
+            err = pairs_add(&pairs, &pair_count, &pair_cap, dir.m.pair);
+            if (err) break;
+            if (is_dot_entry(info.name)) continue;
+
+            uint32_t name_len = strlen(info.name);
+            uint32_t child_len = path_len + 1 + name_len;
+            if (child_len >= MAX_PATH_LENGTH) {
+                dir_err = LFS_ERR_NAMETOOLONG;
+                break;
+            }
+            path[path_len] = '/';
+            memcpy(path + path_len + 1, info.name, name_len + 1);
+            err = info.type == LFS_TYPE_DIR
+                ? check_walk(st, path, child_len)
+                : check_file(st, path, child_len, info.size);
+            path[path_len] = '\0';
+        }
+        if (dir_err > 0) dir_err = 0;
+        lfs_dir_close(&ctx->lfs, &dir);
+    }
+
+    if (!err) {
+        int rec = check_record(ctx, LFS_TYPE_DIR, dir_err, 0,
+                               path_len ? path : "/", path_len ? path_len : 1);
+        err = rec < 0 ? rec : 0;
+        for (uint32_t i = 0; !err && i < pair_count; i++) {
+            err = check_claim(st, rec, pairs[i]);
+            if (err != LFS_ERR_NOMEM) err = 0;
+        }
+    }
+    free(pairs);
+    return err;
+}
+
+static int check_traverse(void *data, lfs_block_t block) {
+    check_state_t *st = (check_state_t *)data;
+    if (block < st->ctx->block_count && !map_test_set(st->reached, block)) {
+        st->summary->used++;
+    }
+    return 0;
+}
+
+// ============================================================================
+// Parallel Reads
+// ============================================================================
+
+/*
+ * littlefs keeps caches and iterator state in lfs_t, so one mount can't
+ * serve two threads, but any number of mounts can read the same blocks as
+ * long as nothing writes them. A read batch therefore holds the context
+ * lock (littlefs takes it for every call, so writers wait) and hands the
+ * paths out to threads that each mount the storage read-only. Those mounts
+ * stay up between batches and are only redone once write_epoch shows the
+ * storage changed, so a run of reads with no writes in between mounts once.
+ */
+
+typedef struct read_batch {
+    lfs_wasm_ctx_t *ctx;
+    const char **paths;
+    uint32_t count;
+    uint32_t next;               // next path to claim (atomic)
+    lfs_wasm_read_slot_t *out;
+} read_batch_t;
+
+#ifdef LFS_THREADSAFE
+typedef struct read_worker {
+    read_batch_t *batch;
+    lfs_wasm_reader_t *reader;
+} read_worker_t;
+#endif
+
+/**
+ * Read paths from the batch until none are left
+ */
+static void read_batch_drain(lfs_t *lfs, read_batch_t *batch) {
+    uint32_t i;
+    while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count) {
+        int size;
+        batch->out[i].data = read_alloc(lfs, batch->paths[i], &size);
+        batch->out[i].size = size;
+    }
+}
+
+#ifdef LFS_THREADSAFE
+// The batch already holds the context lock for its whole duration
+static int reader_lock(const struct lfs_config *c) {
+    (void)c;
+    return 0;
+}
+
+/**
+ * Thread body: read through the worker's own read-only mount
+ * The mount is reused when nothing was written since it was made and
+ * redone otherwise. Batches only get here without I/O instrumentation or
+ * fault injection, which sit behind the context's own block device
+ * callbacks. If the mount fails the thread just leaves its share to the
+ * others.
+ */
+static void *read_batch_thread(void *arg) {
+    read_worker_t *worker = (read_worker_t *)arg;
+    read_batch_t *batch = worker->batch;
+    lfs_wasm_reader_t *reader = worker->reader;
+    lfs_wasm_ctx_t *ctx = batch->ctx;
+
+    if (reader->mounted && reader->epoch != ctx->write_epoch) {
+        lfs_unmount(&reader->lfs);
+        reader->mounted = 0;
+    }
+    if (!reader->mounted) {
+        struct lfs_config *cfg = &reader->cfg;
+        *cfg = ctx->cfg;
+        cfg->read = ctx->backend == BACKEND_SPARSE ? sparse_read : ram_read;
+        cfg->prog = ro_prog;
+        cfg->erase = ro_erase;
+        cfg->sync = ram_sync;
+        cfg->lock = reader_lock;
+        cfg->unlock = reader_lock;
+        cfg->read_buffer = NULL;
+        cfg->prog_buffer = NULL;
+        cfg->lookahead_buffer = NULL;
+        reader->mounted = lfs_mount(&reader->lfs, cfg) == 0;
+        reader->epoch = ctx->write_epoch;
+    }
+    if (reader->mounted) read_batch_drain(&reader->lfs, batch);
+    return NULL;
+}
+#endif
+
+// ============================================================================
+// Exported Functions (called from JavaScript)
+// ============================================================================
+
+/**
+ * Create a new filesystem context
+ * The context holds no storage until lfs_wasm_init or
+ * lfs_wasm_init_from_image is called on it.
+ * @return Context pointer, or NULL if out of memory
+ */
+lfs_wasm_ctx_t* lfs_wasm_ctx_create(void) {
+    lfs_wasm_ctx_t *ctx = (lfs_wasm_ctx_t *)calloc(1, sizeof(lfs_wasm_ctx_t));
+    if (!ctx) return NULL;
+
+    ctx->block_size = DEFAULT_BLOCK_SIZE;
+    ctx->block_count = DEFAULT_BLOCK_COUNT;
+    ctx->disk_version = DEFAULT_DISK_VERSION;
+    ctx->dir_cache_enabled = 1;
+#ifdef LFS_THREADSAFE
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    int err = pthread_mutex_init(&ctx->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (err) {
+        free(ctx);
+        return NULL;
+    }
+#endif
+    return ctx;
+}
+
+/**
+ * Destroy a filesystem context, unmounting and freeing its storage
+ * @param ctx Context from lfs_wasm_ctx_create (NULL is ignored)
+ */
+void lfs_wasm_ctx_destroy(lfs_wasm_ctx_t *ctx) {
+    if (!ctx) return;
+    ctx_release(ctx);
+#ifdef LFS_THREADSAFE
+    pthread_mutex_destroy(&ctx->lock);
+#endif
+    free(ctx);
+}
+
+/**
+ * Configure without prog and erase from the next init on
+ * Every write then fails with LFS_ERR_IO before reaching the storage, so
+ * mounting and reading an image can't change a byte of it.
+ */
+void lfs_wasm_set_read_only(lfs_wasm_ctx_t *ctx, int read_only) {
+    ctx->read_only = read_only ? 1 : 0;
+}
+
+/**
+ * Set the disk version for new filesystems; formatting with one this
+ * driver cannot write (another major, or a newer minor) fails with
+ * LFS_ERR_INVAL
+ * @param version Disk version (e.g., 0x00020000 for v2.0, 0x00020001 for v2.1)
+ *                Use 0 for latest version
+ */
+void lfs_wasm_set_disk_version(lfs_wasm_ctx_t *ctx, uint32_t version) {
+    ctx->disk_version = version;
+}
+
+/**
+ * Get the current disk version setting
+ * @return Current disk version
+ */
+uint32_t lfs_wasm_get_disk_version(lfs_wasm_ctx_t *ctx) {
+    return ctx->disk_version;
+}
+
+/**
+ * Set the tuning parameters used by the next init on this context
+ * Pass 0 for any parameter to use its default. Invalid combinations are
+ * reported by the init call as LFS_ERR_INVAL.
+ * @param read_size Minimum read size in bytes
+ * @param prog_size Minimum program size in bytes
+ * @param cache_size Read/program cache size; must divide block_size
+ * @param block_cycles Erase cycles before relocating metadata (-1 = never)
+ * @param compact_thresh Metadata compaction threshold in bytes (-1 = never)
+ * @param metadata_max Metadata log size limit in bytes
+ * @param inline_max Inline file size limit in bytes (-1 = disable)
+ * @param name_max File name length limit (<= LFS_NAME_MAX), stored on format
+ */
+void lfs_wasm_set_tuning(lfs_wasm_ctx_t *ctx, uint32_t read_size, uint32_t prog_size,
+                         uint32_t cache_size, int32_t block_cycles, uint32_t compact_thresh,
+                         uint32_t metadata_max, uint32_t inline_max, uint32_t name_max) {
+    ctx->tuning.read_size = read_size;
+    ctx->tuning.prog_size = prog_size;
+    ctx->tuning.cache_size = cache_size;
+    ctx->tuning.block_cycles = block_cycles;
+    ctx->tuning.compact_thresh = compact_thresh;
+    ctx->tuning.metadata_max = metadata_max;
+    ctx->tuning.inline_max = inline_max;
+    ctx->tuning.name_max = name_max;
+}
+
+/**
+ * Initialize the filesystem with given parameters
+ * @param blk_size Block size in bytes (default 4096)
+ * @param blk_count Number of blocks
+ * @param lookahead Lookahead buffer size (0 = use default,
+ *                  LOOKAHEAD_FULL = one bit per block)
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_init(lfs_wasm_ctx_t *ctx, uint32_t blk_size, uint32_t blk_count, uint32_t lookahead) {
+    // Free existing storage if any
+    ctx_release(ctx);
+
+    // Use defaults if zero
+    ctx->block_size = blk_size > 0 ? blk_size : DEFAULT_BLOCK_SIZE;
+    ctx->block_count = blk_count > 0 ? blk_count : DEFAULT_BLOCK_COUNT;
+    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+
+    int err = ctx_configure(ctx, la_size);
+    if (err) return err;
+
+    uint32_t storage_size = ctx->block_size * ctx->block_count;
+    ctx->ram_storage = (uint8_t *)malloc(storage_size);
+    if (!ctx->ram_storage) {
+        ctx_release(ctx);
+        return LFS_ERR_NOMEM;
+    }
+    ctx->storage_size = storage_size;
+
+    // Initialize to 0xFF (NOR flash erased state)
+    memset(ctx->ram_storage, 0xFF, storage_size);
+
+    return 0;
+}
+
+/**
+ * Initialize from an existing image
+ * @param image Pointer to the image data
+ * @param image_size Size of the image in bytes
+ * @param blk_size Block size (0 = auto-detect from image size)
+ * @param blk_count Number of blocks (0 = calculate from image_size/blk_size)
+ * @param lookahead Lookahead buffer size (0 = use default,
+ *                  LOOKAHEAD_FULL = one bit per block)
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_init_from_image(lfs_wasm_ctx_t *ctx, uint8_t *image, uint32_t image_size,
+                             uint32_t blk_size, uint32_t blk_count, uint32_t lookahead) {
+    // Free existing storage
+    ctx_release(ctx);
+
+    uint32_t storage_size = ctx_image_geometry(ctx, image_size, blk_size, blk_count);
+    if (storage_size == 0) {
+        return LFS_ERR_INVAL;
+    }
+
+    // Use lookahead or default
+    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+
+    int err = ctx_configure(ctx, la_size);
+    if (err) return err;
+
+    ctx->ram_storage = (uint8_t *)malloc(storage_size);
+    if (!ctx->ram_storage) {
+        ctx_release(ctx);
+        return LFS_ERR_NOMEM;
+    }
+    ctx->storage_size = storage_size;
+
+    // Copy image data (only up to image_size, not storage_size which might be larger)
+    uint32_t copy_size = image_size < storage_size ? image_size : storage_size;
+    memcpy(ctx->ram_storage, image, copy_size);
+
+    // Fill rest with 0xFF if image is smaller than storage
+    if (copy_size < storage_size) {
+        memset(ctx->ram_storage + copy_size, 0xFF, storage_size - copy_size);
+    }
+
+    return 0;
+}
+
+/**
+ * Initialize from an image already in the WASM heap, without copying it
+ * The RAM block device takes ownership of the buffer, which must have been
+ * allocated with malloc (e.g. Module._malloc from JS). If the image is
+ * smaller than the requested geometry the buffer is grown with realloc and
+ * padded with 0xFF.
+ * @param image malloc'd buffer holding the image data
+ * @param image_size Size of the image in bytes
+ * @param blk_size Block size (0 = default)
+ * @param blk_count Number of blocks (0 = calculate from image_size/blk_size)
+ * @param lookahead Lookahead buffer size (0 = use default,
+ *                  LOOKAHEAD_FULL = one bit per block)
+ * @return 0 on success (buffer is now owned by ctx), negative error code on
+ *         failure (buffer is still owned by the caller)
+ */
+int lfs_wasm_init_adopt(lfs_wasm_ctx_t *ctx, uint8_t *image, uint32_t image_size,
+                        uint32_t blk_size, uint32_t blk_count, uint32_t lookahead) {
+    if (!image) return LFS_ERR_INVAL;
+
+    // Free existing storage
+    ctx_release(ctx);
+
+    uint32_t storage_size = ctx_image_geometry(ctx, image_size, blk_size, blk_count);
+    if (storage_size == 0) {
+        return LFS_ERR_INVAL;
+    }
+
+    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+
+    int err = ctx_configure(ctx, la_size);
+    if (err) return err;
+
+    // Pad short images to the full partition size; realloc usually extends
+    // in place at the top of the heap
+    if (image_size < storage_size) {
+        uint8_t *grown = (uint8_t *)realloc(image, storage_size);
+        if (!grown) {
+            ctx_release(ctx);
+            return LFS_ERR_NOMEM;
+        }
+        memset(grown + image_size, 0xFF, storage_size - image_size);
+        image = grown;
+    }
+
+    ctx->ram_storage = image;
+    ctx->storage_size = storage_size;
+
+    return 0;
+}
+
+/**
+ * Initialize read-only over an image the caller keeps owning
+ * Nothing is copied and the buffer is never written or freed; it must
+ * stay valid until the next init or cleanup. A short image isn't padded:
+ * reads past its end fail with LFS_ERR_IO.
+ * @param image Image data in the WASM heap
+ * @param image_size Size of the image in bytes
+ * @param blk_size Block size (0 = default)
+ * @param blk_count Number of blocks (0 = calculate from image_size/blk_size)
+ * @param lookahead Lookahead buffer size (0 = use default,
+ *                  LOOKAHEAD_FULL = one bit per block)
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_init_borrow(lfs_wasm_ctx_t *ctx, uint8_t *image, uint32_t image_size,
+                         uint32_t blk_size, uint32_t blk_count, uint32_t lookahead) {
+    if (!image) return LFS_ERR_INVAL;
+
+    ctx_release(ctx);
+
+    uint32_t storage_size = ctx_image_geometry(ctx, image_size, blk_size, blk_count);
+    if (storage_size == 0) {
+        return LFS_ERR_INVAL;
+    }
+
+    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+
+    ctx->borrowed = 1;
+    int err = ctx_configure(ctx, la_size);
+    if (err) {
+        ctx_release(ctx);
+        return err;
+    }
+
+    ctx->ram_storage = image;
+    ctx->storage_size = image_size < storage_size ? image_size : storage_size;
+
+    return 0;
+}
+
+/**
+ * Initialize with sparse RAM storage
+ * Nothing is allocated per block until it is first programmed, so init is
+ * O(block_count) pointers instead of a full image malloc + memset.
+ * lfs_wasm_get_image returns NULL in this mode; use lfs_wasm_block_data.
+ * @param blk_size Block size in bytes (0 = default)
+ * @param blk_count Number of blocks (0 = default)
+ * @param lookahead Lookahead buffer size (0 = use default,
+ *                  LOOKAHEAD_FULL = one bit per block)
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_init_sparse(lfs_wasm_ctx_t *ctx, uint32_t blk_size, uint32_t blk_count,
+                         uint32_t lookahead) {
+    // Free existing storage
+    ctx_release(ctx);
+
+    ctx->block_size = blk_size > 0 ? blk_size : DEFAULT_BLOCK_SIZE;
+    ctx->block_count = blk_count > 0 ? blk_count : DEFAULT_BLOCK_COUNT;
+    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+
+    ctx->backend = BACKEND_SPARSE;
+    int err = ctx_configure(ctx, la_size);
+    if (err) {
+        ctx_release(ctx);
+        return err;
+    }
+
+    ctx->sparse_blocks = (uint8_t **)calloc(ctx->block_count, sizeof(uint8_t *));
+    if (!ctx->sparse_blocks) {
+        ctx_release(ctx);
+        return LFS_ERR_NOMEM;
+    }
+    ctx->storage_size = ctx->block_size * ctx->block_count;
+
+    return 0;
+}
+
+/**
+ * Initialize on an external block device implemented in JS
+ * Reads, progs, erases and syncs go through Module.lfsBlockDevice, so the
+ * image does not have to fit in (or be copied into) WASM memory.
+ * lfs_wasm_get_image returns NULL in this mode; get_image_size still reports
+ * the device size.
+ * @param blk_size Block size in bytes (0 = default)
+ * @param blk_count Number of blocks (0 = default)
+ * @param lookahead Lookahead buffer size (0 = use default,
+ *                  LOOKAHEAD_FULL = one bit per block)
+ * @param cache_blocks Number of whole blocks cached in WASM memory (0 = none)
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_init_external(lfs_wasm_ctx_t *ctx, uint32_t blk_size, uint32_t blk_count,
+                           uint32_t lookahead, uint32_t cache_blocks) {
+    // Free existing storage
+    ctx_release(ctx);
+
+    ctx->block_size = blk_size > 0 ? blk_size : DEFAULT_BLOCK_SIZE;
+    ctx->block_count = blk_count > 0 ? blk_count : DEFAULT_BLOCK_COUNT;
+    uint32_t la_size = lookahead > 0 ? lookahead : DEFAULT_LOOKAHEAD;
+
+    ctx->backend = BACKEND_EXTERNAL;
+    int err = ctx_configure(ctx, la_size);
+    if (err) {
+        ctx_release(ctx);
+        return err;
+    }
+    ctx->storage_size = ctx->block_size * ctx->block_count;
+
+    if (cache_blocks > 0) {
+        ctx->ext_cache = (uint8_t *)malloc((size_t)cache_blocks * ctx->block_size);
+        ctx->ext_cache_tags = (lfs_block_t *)malloc(cache_blocks * sizeof(lfs_block_t));
+        if (!ctx->ext_cache || !ctx->ext_cache_tags) {
+            ctx_release(ctx);
+            return LFS_ERR_NOMEM;
+        }
+        for (uint32_t i = 0; i < cache_blocks; i++) {
+            ctx->ext_cache_tags[i] = EXT_CACHE_EMPTY;
+        }
+        ctx->ext_cache_slots = cache_blocks;
+    }
+
+    return 0;
+}
+
+/**
+ * Get the filesystem info including disk version
+ * Must be called after mount
+ * @param version_out Pointer to store disk version
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_get_fs_info(lfs_wasm_ctx_t *ctx, uint32_t *version_out) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    struct lfs_fsinfo fsinfo;
+    int err = lfs_fs_stat(&ctx->lfs, &fsinfo);
+    if (err < 0) return err;
+
+    if (version_out) {
+        *version_out = fsinfo.disk_version;
+    }
+    return 0;
+}
+
+/**
+ * Mount the filesystem
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_mount(lfs_wasm_ctx_t *ctx) {
+    if (!ctx_has_storage(ctx)) return LFS_ERR_INVAL;
+    if (ctx->mounted) return 0;
+
+    // Blocks may have been loaded directly (lfs_wasm_block_alloc)
+    ctx->write_epoch++;
+    dir_cache_clear(ctx);
+    int err = lfs_mount(&ctx->lfs, &ctx->cfg);
+    if (err == 0) {
+        ctx->mounted = 1;
+
+        // Read the actual disk version from the mounted filesystem
+        // and store it so we preserve it on subsequent writes
+        struct lfs_fsinfo fsinfo;
+        if (lfs_fs_stat(&ctx->lfs, &fsinfo) == 0) {
+            ctx->disk_version = fsinfo.disk_version;
+#ifdef LFS_MULTIVERSION
+            ctx->cfg.disk_version = ctx->disk_version;  // Update config to match mounted version
+#endif
+        }
+    }
+    return err;
+}
+
+/**
+ * Unmount the filesystem
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_unmount(lfs_wasm_ctx_t *ctx) {
+    if (!ctx->mounted) return 0;
+    ctx_close_handles(ctx);
+    readers_release(ctx);
+    int err = lfs_unmount(&ctx->lfs);
+    if (err == 0) {
+        ctx->mounted = 0;
+    }
+    return err;
+}
+
+/**
+ * Format the filesystem
+ * @return 0 on success, LFS_ERR_INVAL for an unsupported disk version,
+ *         negative error code on failure
+ */
+int lfs_wasm_format(lfs_wasm_ctx_t *ctx) {
+    if (!ctx_has_storage(ctx)) return LFS_ERR_INVAL;
+    if (!disk_version_valid(ctx->disk_version)) return LFS_ERR_INVAL;
+
+    if (ctx->mounted) {
+        ctx_close_handles(ctx);
+        lfs_unmount(&ctx->lfs);
+        ctx->mounted = 0;
+    }
+
+#ifdef LFS_MULTIVERSION
+    // Format with the requested version (0 = latest)
+    ctx->cfg.disk_version = ctx->disk_version;
+#endif
+    return lfs_format(&ctx->lfs, &ctx->cfg);
+}
+
+/**
+ * Create a directory
+ * @param path Directory path
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_mkdir(lfs_wasm_ctx_t *ctx, const char *path) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    int err = lfs_mkdir(&ctx->lfs, path);
+    if (err == 0) dir_cache_add(ctx, path, strlen(path));
+    return err;
+}
+
+/**
+ * Remove a file or empty directory
+ * @param path Path to remove
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_remove(lfs_wasm_ctx_t *ctx, const char *path) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    int err = lfs_remove(&ctx->lfs, path);
+    if (err == 0) dir_cache_forget(ctx, path);
+    return err;
+}
+
+/**
+ * Rename a file or directory
+ * @param oldpath Current path
+ * @param newpath New path
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_rename(lfs_wasm_ctx_t *ctx, const char *oldpath, const char *newpath) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    int err = lfs_rename(&ctx->lfs, oldpath, newpath);
+    if (err == 0) dir_cache_clear(ctx);
+    return err;
+}
+
+/**
+ * Remove a file, or a directory and everything below it, in one walk
+ * Removing "/" empties the filesystem and keeps the root.
+ * @param path Path to remove
+ * @return Number of entries removed, or negative error code
+ */
+int lfs_wasm_remove_tree(lfs_wasm_ctx_t *ctx, const char *path) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    char walk_path[MAX_PATH_LENGTH];
+    int len = walk_path_init(walk_path, path);
+    if (len < 0) return len;
+
+    struct lfs_info info;
+    int err = lfs_stat(&ctx->lfs, len ? walk_path : "/", &info);
+    if (err < 0) return err;
+
+    uint32_t count = 0;
+    if (info.type == LFS_TYPE_DIR) {
+        err = tree_remove(ctx, walk_path, len, &count);
+        if (err < 0) return err;
+    }
+    if (len == 0) return count;
+
+    err = lfs_remove(&ctx->lfs, walk_path);
+    if (err < 0) return err;
+    dir_cache_forget(ctx, walk_path);
+    return count + 1;
+}
+
+/**
+ * Copy a file, or a directory and everything below it, to a new path
+ * Missing parents of the destination are created; the destination itself
+ * must not exist, nor lie inside the source.
+ * @param from Source path
+ * @param to Destination path
+ * @param types Custom attribute types to copy along (at most
+ *              MAX_FILE_ATTRS); others are dropped
+ * @return Number of entries copied, or negative error code
+ */
+int lfs_wasm_copy_tree(lfs_wasm_ctx_t *ctx, const char *from, const char *to,
+                       const uint8_t *types, uint32_t type_count) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    char src[MAX_PATH_LENGTH], dst[MAX_PATH_LENGTH];
+    int src_len = walk_path_init(src, from);
+    if (src_len < 0) return src_len;
+    int dst_len = walk_path_init(dst, to);
+    if (dst_len < 0) return dst_len;
+    if (dst_len == 0) return LFS_ERR_EXIST;
+    if (path_within(dst, dst_len, src, src_len)) return LFS_ERR_INVAL;
+
+    struct lfs_info info;
+    int err = lfs_stat(&ctx->lfs, src_len ? src : "/", &info);
+    if (err < 0) return err;
+
+    attr_carry_t carry;
+    err = attr_carry_init(&carry, types, type_count);
+    if (err < 0) return err;
+    uint8_t *buf = (uint8_t *)malloc(ctx->block_size);
+    if (!buf) {
+        attr_carry_free(&carry);
+        return LFS_ERR_NOMEM;
+    }
+
+    ctx_mkdir_parents(ctx, dst);
+    uint32_t count = 0;
+    if (info.type == LFS_TYPE_DIR) {
+        err = lfs_mkdir(&ctx->lfs, dst);
+        if (!err) {
+            dir_cache_add(ctx, dst, dst_len);
+            err = attr_carry_dir(&carry, ctx, dst, ctx, src_len ? src : "/", 0);
+        }
+        if (!err) err = tree_copy(ctx, src, src_len, dst, dst_len, buf, ctx->block_size, &carry, &count);
+    } else {
+        err = ctx_copy_file(ctx, dst, ctx, src, LFS_O_EXCL, buf, ctx->block_size, &carry);
+    }
+
+    free(buf);
+    attr_carry_free(&carry);
+    return err < 0 ? err : (int)count + 1;
+}
+
+/**
+ * Move a file or directory to a new path, creating missing parents
+ * littlefs moves a directory by relinking it, so this never walks the tree.
+ * Moving a directory inside itself is rejected instead of orphaning it.
+ * @param from Current path
+ * @param to New path (an existing file, or empty directory, is replaced)
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_move_tree(lfs_wasm_ctx_t *ctx, const char *from, const char *to) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    char src[MAX_PATH_LENGTH], dst[MAX_PATH_LENGTH];
+    int src_len = walk_path_init(src, from);
+    if (src_len < 0) return src_len;
+    int dst_len = walk_path_init(dst, to);
+    if (dst_len < 0) return dst_len;
+    if (src_len == 0 || dst_len == 0) return LFS_ERR_INVAL;
+    if (dst_len != src_len && path_within(dst, dst_len, src, src_len)) return LFS_ERR_INVAL;
+
+    ctx_mkdir_parents(ctx, dst);
+    int err = lfs_rename(&ctx->lfs, src, dst);
+    if (err == 0) dir_cache_clear(ctx);
+    return err;
+}
+
+/**
+ * Get file/directory info
+ * @param path Path to query
+ * @param out_type Output: 1 for file, 2 for directory
  * @param out_size Output: size in bytes (for files)
  * @return 0 on success, negative error code on failure
  */
-int lfs_wasm_stat(const char *path, int *out_type, uint32_t *out_size) {
-    if (!mounted) return LFS_ERR_INVAL;
-    
+int lfs_wasm_stat(lfs_wasm_ctx_t *ctx, const char *path, int *out_type, uint32_t *out_size) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    struct lfs_info info;
+    int err = lfs_stat(&ctx->lfs, path, &info);
+    if (err < 0) return err;
+
+    *out_type = (info.type == LFS_TYPE_DIR) ? 2 : 1;
+    *out_size = info.size;
+    return 0;
+}
+
+/**
+ * Open a directory for reading
+ * @param path Directory path
+ * @return Handle (>= 0) on success, negative error code on failure
+ */
+int lfs_wasm_dir_open(lfs_wasm_ctx_t *ctx, const char *path) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    // Find a free directory slot
+    int slot = -1;
+    for (int i = 0; i < MAX_DIRS; i++) {
+        if (!ctx->dir_in_use[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) return LFS_ERR_NOMEM;
+
+    int err = lfs_dir_open(&ctx->lfs, &ctx->open_dirs[slot], path);
+    if (err < 0) return err;
+
+    ctx->dir_in_use[slot] = 1;
+    return slot;
+}
+
+/**
+ * Read next directory entry
+ * @param handle Directory handle from lfs_wasm_dir_open
+ * @param out_name Buffer for entry name
+ * @param out_name_len Size of name buffer
+ * @param out_type Output: 1 for file, 2 for directory
+ * @param out_size Output: size in bytes
+ * @return 1 if entry read, 0 if end of directory, negative on error
+ */
+int lfs_wasm_dir_read(lfs_wasm_ctx_t *ctx, int handle, char *out_name, int out_name_len,
+                       int *out_type, uint32_t *out_size) {
+    if (handle < 0 || handle >= MAX_DIRS || !ctx->dir_in_use[handle]) {
+        return LFS_ERR_INVAL;
+    }
+
+    struct lfs_info info;
+
+    // Skip . and ..
+    int res;
+    do {
+        res = lfs_dir_read(&ctx->lfs, &ctx->open_dirs[handle], &info);
+        if (res <= 0) return res;
+    } while (is_dot_entry(info.name));
+
+    strncpy(out_name, info.name, out_name_len - 1);
+    out_name[out_name_len - 1] = '\0';
+    *out_type = (info.type == LFS_TYPE_DIR) ? 2 : 1;
+    *out_size = info.size;
+
+    return 1;
+}
+
+/**
+ * List a directory tree into one packed buffer
+ * Entries are serialized back to back as
+ *   u8 type (1 = file, 2 = dir), u32 size, u16 path_len, path bytes
+ * (little-endian, not NUL-terminated), with full paths in depth-first
+ * pre-order. Read them from lfs_wasm_list_buffer; the buffer stays valid
+ * until the next call on this context.
+ * @param path Directory to list
+ * @param recursive Non-zero to descend into subdirectories
+ * @return Packed size in bytes, or negative error code
+ */
+int lfs_wasm_list_tree(lfs_wasm_ctx_t *ctx, const char *path, int recursive) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    // Children of "/" are "/name", children of "/a" or "/a/" are "/a/name"
+    char walk_path[MAX_PATH_LENGTH];
+    int len = walk_path_init(walk_path, path);
+    if (len < 0) return len;
+
+    ctx->list_len = 0;
+    int err = list_walk(ctx, walk_path, len, recursive, NULL, 0);
+    if (err < 0) return err;
+    return ctx->list_len;
+}
+
+/**
+ * List a directory tree together with custom attributes
+ * Same layout as lfs_wasm_list_tree, except each entry is followed by
+ *   u8 count, then count records of u8 type, u16 size, value bytes
+ * for the requested types that are set on it. Costs one attribute lookup
+ * per entry and type.
+ * @param path Directory to list
+ * @param recursive Non-zero to descend into subdirectories
+ * @param types Attribute types to fetch
+ * @param type_count Number of types (at most 255)
+ * @return Packed size in bytes, or negative error code
+ */
+int lfs_wasm_list_tree_attrs(lfs_wasm_ctx_t *ctx, const char *path, int recursive,
+                             const uint8_t *types, uint32_t type_count) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    if (type_count > 255) return LFS_ERR_INVAL;
+
+    char walk_path[MAX_PATH_LENGTH];
+    int len = walk_path_init(walk_path, path);
+    if (len < 0) return len;
+
+    ctx->list_len = 0;
+    int err = list_walk(ctx, walk_path, len, recursive, types, type_count);
+    if (err < 0) return err;
+    return ctx->list_len;
+}
+
+/**
+ * Get the packed buffer filled by lfs_wasm_list_tree
+ * @return Pointer to the entries, or NULL if nothing was listed yet
+ */
+uint8_t* lfs_wasm_list_buffer(lfs_wasm_ctx_t *ctx) {
+    return ctx->list_buf;
+}
+
+/**
+ * Validate the mounted filesystem in one pass, without writing to it
+ * Walks every directory (fetching, and so checking the CRCs of, each
+ * metadata pair of its log) and every file's CTZ skip-list, then runs
+ * lfs_fs_traverse over the metadata thread. File data itself carries no
+ * checksum in littlefs and isn't read. The list buffer receives a record
+ * per entry, each directory after its contents; layout (little-endian):
+ * u8 type, i32 error, u32 size, u32 block count, u16 path length, path
+ * bytes, then the blocks as u32 (a directory's metadata pairs, a file's
+ * CTZ chain from the last block back, none for inline files)
+ * @param out_summary Output: totals, see lfs_wasm_check_summary_t
+ * @return Bytes written to the list buffer, or negative error code
+ */
+int lfs_wasm_check(lfs_wasm_ctx_t *ctx, lfs_wasm_check_summary_t *out_summary) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    uint32_t map_bytes = (ctx->block_count + 7) / 8;
+    check_state_t st = { ctx, NULL, NULL, out_summary };
+    memset(out_summary, 0, sizeof(*out_summary));
+    st.claimed = (uint8_t *)calloc(map_bytes, 1);
+    st.reached = (uint8_t *)calloc(map_bytes, 1);
+    if (!st.claimed || !st.reached) {
+        free(st.claimed);
+        free(st.reached);
+        return LFS_ERR_NOMEM;
+    }
+
+    // Block reads below go around littlefs, so take its lock for the pass
+    CTX_LOCK(ctx);
+    ctx->list_len = 0;
+    char walk_path[MAX_PATH_LENGTH] = "";
+    int err = check_walk(&st, walk_path, 0);
+    if (!err) {
+        out_summary->traverse_error = lfs_fs_traverse(&ctx->lfs, check_traverse, &st);
+        for (uint32_t i = 0; i < map_bytes; i++) {
+            out_summary->unreferenced += lfs_popc(st.reached[i] & (uint8_t)~st.claimed[i]);
+        }
+    }
+    CTX_UNLOCK(ctx);
+
+    free(st.claimed);
+    free(st.reached);
+    return err < 0 ? err : (int)ctx->list_len;
+}
+
+/**
+ * Close a directory
+ * @param handle Directory handle
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_dir_close(lfs_wasm_ctx_t *ctx, int handle) {
+    if (handle < 0 || handle >= MAX_DIRS || !ctx->dir_in_use[handle]) {
+        return LFS_ERR_INVAL;
+    }
+
+    int err = lfs_dir_close(&ctx->lfs, &ctx->open_dirs[handle]);
+    ctx->dir_in_use[handle] = 0;
+    return err;
+}
+
+/**
+ * Open a file handle for streaming access
+ * With LFS_O_CREAT, missing parent directories are created like
+ * lfs_wasm_write_file does.
+ * @param path File path
+ * @param flags LFS_O_* open flags
+ * @return Handle (>= 0) on success, negative error code on failure
+ */
+int lfs_wasm_file_open(lfs_wasm_ctx_t *ctx, const char *path, int flags) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    // Find a free file slot
+    int slot = -1;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!ctx->file_in_use[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) return LFS_ERR_NOMEM;
+
+    if (flags & LFS_O_CREAT) {
+        ctx_mkdir_parents(ctx, path);
+    }
+
+    int err = lfs_file_open(&ctx->lfs, &ctx->open_files[slot], path, flags);
+    if (err < 0) return err;
+
+    ctx->file_in_use[slot] = 1;
+    return slot;
+}
+
+/**
+ * Read from an open file at its current position
+ * @param handle File handle from lfs_wasm_file_open
+ * @param out_data Output buffer
+ * @param size Maximum bytes to read
+ * @return Number of bytes read (0 at end of file), or negative error code
+ */
+int lfs_wasm_file_read(lfs_wasm_ctx_t *ctx, int handle, uint8_t *out_data, uint32_t size) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+    return lfs_file_read(&ctx->lfs, file, out_data, size);
+}
+
+/**
+ * Write to an open file at its current position
+ * @param handle File handle from lfs_wasm_file_open
+ * @param data Data to write
+ * @param size Data size in bytes
+ * @return Number of bytes written, or negative error code
+ */
+int lfs_wasm_file_write(lfs_wasm_ctx_t *ctx, int handle, const uint8_t *data, uint32_t size) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+    return lfs_file_write(&ctx->lfs, file, data, size);
+}
+
+/**
+ * Change the position of an open file
+ * @param handle File handle from lfs_wasm_file_open
+ * @param off Offset relative to whence
+ * @param whence LFS_SEEK_SET, LFS_SEEK_CUR or LFS_SEEK_END
+ * @return New position, or negative error code
+ */
+int lfs_wasm_file_seek(lfs_wasm_ctx_t *ctx, int handle, int32_t off, int whence) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+    return lfs_file_seek(&ctx->lfs, file, off, whence);
+}
+
+/**
+ * Get the current position of an open file
+ * @param handle File handle from lfs_wasm_file_open
+ * @return Position, or negative error code
+ */
+int lfs_wasm_file_tell(lfs_wasm_ctx_t *ctx, int handle) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+    return lfs_file_tell(&ctx->lfs, file);
+}
+
+/**
+ * Get the size of an open file, including unsynced writes
+ * @param handle File handle from lfs_wasm_file_open
+ * @return File size in bytes, or negative error code
+ */
+int lfs_wasm_file_length(lfs_wasm_ctx_t *ctx, int handle) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+    return lfs_file_size(&ctx->lfs, file);
+}
+
+/**
+ * Truncate or extend an open file
+ * @param handle File handle from lfs_wasm_file_open
+ * @param size New size in bytes
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_file_truncate(lfs_wasm_ctx_t *ctx, int handle, uint32_t size) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+    return lfs_file_truncate(&ctx->lfs, file, size);
+}
+
+/**
+ * Flush pending writes of an open file to storage
+ * @param handle File handle from lfs_wasm_file_open
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_file_sync(lfs_wasm_ctx_t *ctx, int handle) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+    return lfs_file_sync(&ctx->lfs, file);
+}
+
+/**
+ * Close an open file, syncing pending writes
+ * @param handle File handle from lfs_wasm_file_open
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_file_close(lfs_wasm_ctx_t *ctx, int handle) {
+    lfs_file_t *file = ctx_file(ctx, handle);
+    if (!file) return LFS_ERR_BADF;
+
+    int err = lfs_file_close(&ctx->lfs, file);
+    ctx->file_in_use[handle] = 0;
+    return err;
+}
+
+/**
+ * Write a file (creates parent directories if needed)
+ * @param path File path
+ * @param data File data
+ * @param size Data size in bytes
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_write_file(lfs_wasm_ctx_t *ctx, const char *path, const uint8_t *data, uint32_t size) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    // Create parent directories
+    ctx_mkdir_parents(ctx, path);
+
+    return ctx_write_whole(ctx, path, data, size, NULL, 0);
+}
+
+/**
+ * Write a file and set custom attributes in the same commit
+ * @param path File path
+ * @param data File data
+ * @param size Data size in bytes
+ * @param attrs Packed records of u8 type, u16 size, value bytes
+ * @param attrs_len Size of attrs in bytes
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_write_file_attrs(lfs_wasm_ctx_t *ctx, const char *path, const uint8_t *data,
+                              uint32_t size, const uint8_t *attrs, uint32_t attrs_len) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    struct lfs_attr file_attrs[MAX_FILE_ATTRS];
+    int count = attrs_unpack(attrs, attrs_len, file_attrs);
+    if (count < 0) return count;
+
+    ctx_mkdir_parents(ctx, path);
+
+    return ctx_write_whole(ctx, path, data, size, file_attrs, count);
+}
+
+/**
+ * Get a custom attribute of a file or directory
+ * @param path Path
+ * @param type Attribute type (0-255)
+ * @param out Buffer for the value
+ * @param size Buffer size; longer values are truncated
+ * @return Stored size of the attribute, or negative error code
+ *         (LFS_ERR_NOATTR if it is not set)
+ */
+int lfs_wasm_getattr(lfs_wasm_ctx_t *ctx, const char *path, uint32_t type,
+                     uint8_t *out, uint32_t size) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    return lfs_getattr(&ctx->lfs, path, (uint8_t)type, out, size);
+}
+
+/**
+ * Set a custom attribute of a file or directory
+ * @param path Path
+ * @param type Attribute type (0-255)
+ * @param data Value
+ * @param size Value size, at most the configured attr_max
+ * @return 0 on success, negative error code on failure
+ */
+int lfs_wasm_setattr(lfs_wasm_ctx_t *ctx, const char *path, uint32_t type,
+                     const uint8_t *data, uint32_t size) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    return lfs_setattr(&ctx->lfs, path, (uint8_t)type, data, size);
+}
+
+/**
+ * Remove a custom attribute of a file or directory
+ * @param path Path
+ * @param type Attribute type (0-255)
+ * @return 0 on success (also if it was not set), negative error code on failure
+ */
+int lfs_wasm_removeattr(lfs_wasm_ctx_t *ctx, const char *path, uint32_t type) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    return lfs_removeattr(&ctx->lfs, path, (uint8_t)type);
+}
+
+/**
+ * Write many files in one call
+ * buf holds a manifest of count entries followed by the concatenated file
+ * contents in manifest order. Each manifest entry is
+ *   u32 data_size, u16 path_len, u16 attrs_len, path bytes (no NUL),
+ *   attrs_len bytes of packed attribute records (u8 type, u16 size, value)
+ * in little-endian. The attributes are committed together with the file.
+ * Parent directories are created as needed; callers should sort entries
+ * by directory so shared parents are only created once and consecutive
+ * commits hit the same metadata pair.
+ * @param buf Packed manifest and payload
+ * @param manifest_len Size of the manifest part in bytes
+ * @param count Number of entries
+ * @return Number of files written, or negative error code. On error,
+ *         lfs_wasm_batch_progress gives the index of the failing entry.
+ */
+int lfs_wasm_write_files(lfs_wasm_ctx_t *ctx, const uint8_t *buf, uint32_t manifest_len, uint32_t count) {
+    ctx->batch_progress = 0;
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    const uint8_t *entry = buf;
+    const uint8_t *manifest_end = buf + manifest_len;
+    const uint8_t *data = manifest_end;
+
+    char path[MAX_PATH_LENGTH];
+    char prev_dir[MAX_PATH_LENGTH];
+    uint32_t prev_len = 0;
+    struct lfs_attr attrs[MAX_FILE_ATTRS];
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (entry + BATCH_ENTRY_HEADER > manifest_end) return LFS_ERR_INVAL;
+        uint32_t size = (uint32_t)entry[0] | (uint32_t)entry[1] << 8 |
+                        (uint32_t)entry[2] << 16 | (uint32_t)entry[3] << 24;
+        uint32_t path_len = (uint32_t)entry[4] | (uint32_t)entry[5] << 8;
+        uint32_t attrs_len = (uint32_t)entry[6] | (uint32_t)entry[7] << 8;
+        const uint8_t *name = entry + BATCH_ENTRY_HEADER;
+        if (name + path_len + attrs_len > manifest_end) return LFS_ERR_INVAL;
+        if (path_len >= MAX_PATH_LENGTH) return LFS_ERR_NAMETOOLONG;
+        memcpy(path, name, path_len);
+        path[path_len] = '\0';
+
+        // Parent directory is everything before the last '/'
+        uint32_t dir_len = path_len;
+        while (dir_len > 0 && path[dir_len - 1] != '/') dir_len--;
+        if (dir_len > 0) dir_len--;
+        batch_mkdirs(ctx, path, dir_len, prev_dir, &prev_len);
+
+        int attr_count = attrs_unpack(name + path_len, attrs_len, attrs);
+        if (attr_count < 0) return attr_count;
+
+        int err = ctx_write_whole(ctx, path, data, size, attrs, attr_count);
+        if (err < 0) return err;
+
+        entry = name + path_len + attrs_len;
+        data += size;
+        ctx->batch_progress = i + 1;
+    }
+
+    return count;
+}
+
+/**
+ * Get how many entries the last lfs_wasm_write_files call completed
+ * @return Number of entries written before returning or failing
+ */
+uint32_t lfs_wasm_batch_progress(lfs_wasm_ctx_t *ctx) {
+    return ctx->batch_progress;
+}
+
+/**
+ * Read a file
+ * @param path File path
+ * @param out_data Output buffer (caller allocates)
+ * @param max_size Maximum bytes to read
+ * @return Number of bytes read, or negative error code
+ */
+int lfs_wasm_read_file(lfs_wasm_ctx_t *ctx, const char *path, uint8_t *out_data, uint32_t max_size) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    lfs_file_t file;
+    int err = lfs_file_open(&ctx->lfs, &file, path, LFS_O_RDONLY);
+    if (err < 0) return err;
+
+    lfs_ssize_t read = lfs_file_read(&ctx->lfs, &file, out_data, max_size);
+    lfs_file_close(&ctx->lfs, &file);
+
+    return read;
+}
+
+/**
+ * Read a whole file into a new buffer, resolving the path once
+ * Replaces lfs_wasm_file_size + lfs_wasm_read_file, which look the path
+ * up twice. The size (or error) is in lfs_wasm_read_result.
+ * @param path File path
+ * @return Buffer to release with free(), or NULL on error or for an
+ *         empty file
+ */
+uint8_t* lfs_wasm_read_file_alloc(lfs_wasm_ctx_t *ctx, const char *path) {
+    ctx->read_result = LFS_ERR_INVAL;
+    if (!ctx->mounted) return NULL;
+    return read_alloc(&ctx->lfs, path, &ctx->read_result);
+}
+
+/**
+ * Get the size read by the last lfs_wasm_read_file_alloc call
+ * @return Bytes read, or negative error code
+ */
+int lfs_wasm_read_result(lfs_wasm_ctx_t *ctx) {
+    return ctx->read_result;
+}
+
+/**
+ * Read a batch of whole files into new buffers
+ * In LFS_THREADSAFE builds up to `threads` threads (the caller included)
+ * read in parallel, each through its own read-only mount, kept for later
+ * batches until the next write or unmount; writers to this context wait
+ * until the batch is done. Other builds, external block
+ * devices (whose callbacks run on the calling thread), and contexts with
+ * I/O statistics or fault injection enabled read sequentially.
+ * @param paths count NUL-terminated paths, back to back
+ * @param count Number of paths
+ * @param threads Threads to use; 0 or 1 reads on the calling thread only
+ * @param out count slots, filled in path order
+ * @return 0 on success, negative error code if the batch couldn't start
+ */
+int lfs_wasm_read_files(lfs_wasm_ctx_t *ctx, const char *paths, uint32_t count,
+                        uint32_t threads, lfs_wasm_read_slot_t *out) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    if (count == 0) return 0;
+
+    const char **index = (const char **)malloc(count * sizeof(*index));
+    if (!index) return LFS_ERR_NOMEM;
+    for (uint32_t i = 0; i < count; i++) {
+        index[i] = paths;
+        paths += strlen(paths) + 1;
+    }
+    read_batch_t batch = { ctx, index, count, 0, out };
+
+    CTX_LOCK(ctx);
+#ifdef LFS_THREADSAFE
+    pthread_t workers[READ_THREADS_MAX];
+    read_worker_t args[READ_THREADS_MAX];
+    uint32_t spawned = 0;
+    // The counters and the fault layer aren't thread-safe
+    if (ctx->backend != BACKEND_EXTERNAL && !ctx->io && !ctx->fault && threads > 1) {
+        if (threads > READ_THREADS_MAX) threads = READ_THREADS_MAX;
+        if (threads > count) threads = count;
+        if (!ctx->readers) {
+            ctx->readers = (lfs_wasm_reader_t *)calloc(READ_THREADS_MAX - 1, sizeof(lfs_wasm_reader_t));
+        }
+        while (ctx->readers && spawned + 1 < threads) {
+            args[spawned].batch = &batch;
+            args[spawned].reader = &ctx->readers[spawned];
+            if (pthread_create(&workers[spawned], NULL, read_batch_thread, &args[spawned]) != 0) break;
+            spawned++;
+        }
+    }
+    read_batch_drain(&ctx->lfs, &batch);
+    for (uint32_t i = 0; i < spawned; i++) {
+        pthread_join(workers[i], NULL);
+    }
+#else
+    (void)threads;
+    read_batch_drain(&ctx->lfs, &batch);
+#endif
+    CTX_UNLOCK(ctx);
+
+    free(index);
+    return 0;
+}
+
+/**
+ * Enable or disable the directory cache used when creating parent
+ * directories (enabled by default); disabling drops its entries
+ */
+void lfs_wasm_set_dir_cache(lfs_wasm_ctx_t *ctx, int enabled) {
+    dir_cache_clear(ctx);
+    ctx->dir_cache_enabled = enabled != 0;
+}
+
+/**
+ * Get the size of a file
+ * @param path File path
+ * @return File size in bytes, or negative error code
+ */
+int lfs_wasm_file_size(lfs_wasm_ctx_t *ctx, const char *path) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
     struct lfs_info info;
-    int err = lfs_stat(&lfs, path, &info);
+    int err = lfs_stat(&ctx->lfs, path, &info);
     if (err < 0) return err;
-    
-    *out_type = (info.type == LFS_TYPE_DIR) ? 2 : 1;
-    *out_size = info.size;
+
+    return info.size;
+}
+
+/**
+ * Get the raw filesystem image
+ * @return Pointer to the image data
+ */
+uint8_t* lfs_wasm_get_image(lfs_wasm_ctx_t *ctx) {
+    return ctx->ram_storage;
+}
+
+/**
+ * Get the filesystem image size
+ * @return Size in bytes
+ */
+uint32_t lfs_wasm_get_image_size(lfs_wasm_ctx_t *ctx) {
+    return ctx->storage_size;
+}
+
+/**
+ * Get the block size of the current geometry
+ * @return Block size in bytes
+ */
+uint32_t lfs_wasm_get_block_size(lfs_wasm_ctx_t *ctx) {
+    return ctx->block_size;
+}
+
+/**
+ * Get the kind of block device behind a context
+ * @return 0 = contiguous RAM image, 1 = sparse RAM, 2 = external (JS)
+ */
+int lfs_wasm_get_backend(lfs_wasm_ctx_t *ctx) {
+    return ctx->backend;
+}
+
+/**
+ * Get the heap memory held by the block storage itself
+ * @return Bytes allocated for image data or block cache
+ */
+uint32_t lfs_wasm_get_storage_bytes(lfs_wasm_ctx_t *ctx) {
+    switch (ctx->backend) {
+        case BACKEND_SPARSE:   return ctx->sparse_allocated * ctx->block_size;
+        case BACKEND_EXTERNAL: return ctx->ext_cache_slots * ctx->block_size;
+        default:               return ctx->ram_storage ? ctx->storage_size : 0;
+    }
+}
+
+/**
+ * Get the contents of one block, for sparse export
+ * Works for RAM and sparse storage; erased blocks are reported as NULL so
+ * callers can skip them without scanning.
+ * @param block Block index
+ * @return Pointer to block_size bytes, or NULL if the block is erased
+ *         (all 0xFF), out of range or not held in WASM memory
+ */
+uint8_t* lfs_wasm_block_data(lfs_wasm_ctx_t *ctx, uint32_t block) {
+    if (block >= ctx->block_count) return NULL;
+
+    uint8_t *data = NULL;
+    if (ctx->backend == BACKEND_SPARSE && ctx->sparse_blocks) {
+        data = ctx->sparse_blocks[block];
+    } else if (ctx->backend == BACKEND_RAM && ctx->ram_storage &&
+               ((size_t)block + 1) * ctx->block_size <= ctx->storage_size) {
+        // A borrowed image may stop short of the geometry
+        data = ctx->ram_storage + (size_t)block * ctx->block_size;
+    }
+    if (!data) return NULL;
+
+    // Every byte equals the first one iff the block matches itself shifted by one
+    if (data[0] == 0xFF && memcmp(data, data + 1, ctx->block_size - 1) == 0) {
+        return NULL;
+    }
+    return data;
+}
+
+/**
+ * Get writable memory for one block, allocating it for sparse storage
+ * Used to load an image into a sparse context before mounting; the block
+ * is not marked dirty.
+ * @param block Block index
+ * @return Pointer to block_size bytes, or NULL on failure
+ */
+uint8_t* lfs_wasm_block_alloc(lfs_wasm_ctx_t *ctx, uint32_t block) {
+    if (block >= ctx->block_count) return NULL;
+    if (ctx->backend == BACKEND_SPARSE && ctx->sparse_blocks) {
+        return sparse_alloc(ctx, block);
+    }
+    if (ctx->backend == BACKEND_RAM && ctx->ram_storage) {
+        return ctx->ram_storage + (size_t)block * ctx->block_size;
+    }
+    return NULL;
+}
+
+/**
+ * Get the dirty block bitmap
+ * Bit (block & 7) of byte (block >> 3) is set if the block has been
+ * programmed or erased since init or the last lfs_wasm_clear_dirty.
+ * @return Pointer to (block_count + 7) / 8 bytes, or NULL if not initialized
+ */
+uint8_t* lfs_wasm_get_dirty_map(lfs_wasm_ctx_t *ctx) {
+    return ctx->dirty_map;
+}
+
+/**
+ * Mark every block clean, e.g. after the image has been flashed
+ */
+void lfs_wasm_clear_dirty(lfs_wasm_ctx_t *ctx) {
+    if (!ctx->dirty_map) return;
+    memset(ctx->dirty_map, 0, (ctx->block_count + 7) / 8);
+}
+
+/**
+ * Start counting block device operations on an initialized context
+ * Counters survive mount/unmount and are dropped on the next init.
+ * Calling it again resets the counters and resizes the trace.
+ * @param trace_cap Trace ring capacity in records (0 = counters only)
+ * @return 0 on success, LFS_ERR_INVAL if not initialized,
+ *         LFS_ERR_NOMEM if the counters can't be allocated
+ */
+int lfs_wasm_io_enable(lfs_wasm_ctx_t *ctx, uint32_t trace_cap) {
+    if (!ctx->dirty_map) return LFS_ERR_INVAL;
+    io_disable(ctx);
+
+    lfs_wasm_io_t *io = (lfs_wasm_io_t *)calloc(1, sizeof(lfs_wasm_io_t));
+    if (!io) return LFS_ERR_NOMEM;
+    io->erase_counts = (uint32_t *)calloc(ctx->block_count, sizeof(uint32_t));
+    if (trace_cap > 0) {
+        io->trace = (uint32_t *)malloc((size_t)trace_cap * IO_TRACE_WORDS * sizeof(uint32_t));
+        io->trace_cap = trace_cap;
+    }
+    if (!io->erase_counts || (trace_cap > 0 && !io->trace)) {
+        free(io->erase_counts);
+        free(io->trace);
+        free(io);
+        return LFS_ERR_NOMEM;
+    }
+
+    // littlefs keeps a pointer to ctx->cfg, so swapping takes effect at once
+    io->read = ctx->cfg.read;
+    io->prog = ctx->cfg.prog;
+    io->erase = ctx->cfg.erase;
+    io->sync = ctx->cfg.sync;
+    ctx->cfg.read = io_read;
+    ctx->cfg.prog = io_prog;
+    ctx->cfg.erase = io_erase;
+    ctx->cfg.sync = io_sync;
+    ctx->io = io;
     return 0;
 }
 
 /**
- * Open a directory for reading
- * @param path Directory path
- * @return Handle (>= 0) on success, negative error code on failure
+ * Stop counting and free the counters and trace
  */
-int lfs_wasm_dir_open(const char *path) {
-    if (!mounted) return LFS_ERR_INVAL;
-    
-    // Find a free directory slot
-    int slot = -1;
-    for (int i = 0; i < MAX_DIRS; i++) {
-        if (!dir_in_use[i]) {
-            slot = i;
-            break;
-        }
+void lfs_wasm_io_disable(lfs_wasm_ctx_t *ctx) {
+    io_disable(ctx);
+}
+
+/**
+ * Zero the counters, erase counts and trace
+ */
+void lfs_wasm_io_reset(lfs_wasm_ctx_t *ctx) {
+    lfs_wasm_io_t *io = ctx->io;
+    if (!io) return;
+    memset(io->counts, 0, sizeof(io->counts));
+    memset(io->bytes, 0, sizeof(io->bytes));
+    memset(io->erase_counts, 0, ctx->block_count * sizeof(uint32_t));
+    io->trace_total = 0;
+}
+
+/**
+ * Get the operation counters
+ * Layout: u64 counts[4] then u64 bytes[4], indexed read/prog/erase/sync.
+ * @return Pointer to the counters, or NULL if not enabled
+ */
+uint64_t* lfs_wasm_io_stats(lfs_wasm_ctx_t *ctx) {
+    return ctx->io ? ctx->io->counts : NULL;
+}
+
+/**
+ * Get the per-block erase counts
+ * @return Pointer to block_count u32 values, or NULL if not enabled
+ */
+uint32_t* lfs_wasm_io_erase_counts(lfs_wasm_ctx_t *ctx) {
+    return ctx->io ? ctx->io->erase_counts : NULL;
+}
+
+/**
+ * Get the trace ring
+ * Record i (oldest first) is at ((total - n + i) % cap) * 4 words, where
+ * n = min(total, cap); see lfs_wasm_io_trace_total.
+ * @return Pointer to cap records of u32 op, block, off, size, or NULL
+ */
+uint32_t* lfs_wasm_io_trace(lfs_wasm_ctx_t *ctx) {
+    return ctx->io ? ctx->io->trace : NULL;
+}
+
+/**
+ * Get the number of trace records written since the last reset
+ */
+uint32_t lfs_wasm_io_trace_total(lfs_wasm_ctx_t *ctx) {
+    return ctx->io ? ctx->io->trace_total : 0;
+}
+
+/**
+ * Get the trace ring capacity in records
+ */
+uint32_t lfs_wasm_io_trace_capacity(lfs_wasm_ctx_t *ctx) {
+    return ctx->io ? ctx->io->trace_cap : 0;
+}
+
+/**
+ * Start injecting faults on an initialized context
+ * Power is on and no block is bad until configured with lfs_wasm_fault_arm,
+ * lfs_wasm_fault_wear and lfs_wasm_fault_bad_block; the state is dropped
+ * on the next init. Calling it again resets everything.
+ * @return 0 on success, LFS_ERR_INVAL if not initialized,
+ *         LFS_ERR_NOMEM if the state can't be allocated
+ */
+int lfs_wasm_fault_enable(lfs_wasm_ctx_t *ctx) {
+    if (!ctx->dirty_map) return LFS_ERR_INVAL;
+    fault_disable(ctx);
+
+    lfs_wasm_fault_t *fault = (lfs_wasm_fault_t *)calloc(1, sizeof(lfs_wasm_fault_t));
+    if (!fault) return LFS_ERR_NOMEM;
+    fault->erases = (uint32_t *)calloc(ctx->block_count, sizeof(uint32_t));
+    fault->bad = (uint8_t *)calloc(ctx->block_count, 1);
+    if (!fault->erases || !fault->bad) {
+        free(fault->erases);
+        free(fault->bad);
+        free(fault);
+        return LFS_ERR_NOMEM;
     }
-    if (slot < 0) return LFS_ERR_NOMEM;
-    
-    int err = lfs_dir_open(&lfs, &open_dirs[slot], path);
-    if (err < 0) return err;
-    
-    dir_in_use[slot] = 1;
-    return slot;
+    fault->cut_after = FAULT_NEVER;
+
+    if (ctx->io) {
+        fault->read = ctx->io->read;
+        fault->prog = ctx->io->prog;
+        fault->erase = ctx->io->erase;
+        ctx->io->read = fault_read;
+        ctx->io->prog = fault_prog;
+        ctx->io->erase = fault_erase;
+    } else {
+        fault->read = ctx->cfg.read;
+        fault->prog = ctx->cfg.prog;
+        fault->erase = ctx->cfg.erase;
+        ctx->cfg.read = fault_read;
+        ctx->cfg.prog = fault_prog;
+        ctx->cfg.erase = fault_erase;
+    }
+    ctx->fault = fault;
+    return 0;
 }
 
 /**
- * Read next directory entry
- * @param handle Directory handle from lfs_wasm_dir_open
- * @param out_name Buffer for entry name
- * @param out_name_len Size of name buffer
- * @param out_type Output: 1 for file, 2 for directory
- * @param out_size Output: size in bytes
- * @return 1 if entry read, 0 if end of directory, negative on error
+ * Stop injecting faults; bad blocks become good again
  */
-int lfs_wasm_dir_read(int handle, char *out_name, int out_name_len, 
-                       int *out_type, uint32_t *out_size) {
-    if (handle < 0 || handle >= MAX_DIRS || !dir_in_use[handle]) {
+void lfs_wasm_fault_disable(lfs_wasm_ctx_t *ctx) {
+    fault_disable(ctx);
+}
+
+/**
+ * Schedule a power loss and restart the operation count
+ * @param after Progs and erases that still succeed (FAULT_NEVER disarms)
+ * @param mode FAULT_CUT_ATOMIC or FAULT_CUT_TORN for the one that doesn't
+ * @return 0 on success, LFS_ERR_INVAL if faults aren't enabled
+ */
+int lfs_wasm_fault_arm(lfs_wasm_ctx_t *ctx, uint32_t after, int mode) {
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (!fault || (mode != FAULT_CUT_ATOMIC && mode != FAULT_CUT_TORN)) return LFS_ERR_INVAL;
+    fault->cut_after = after;
+    fault->cut_mode = mode;
+    fault->ops = 0;
+    return 0;
+}
+
+/**
+ * Wear blocks out after a number of erases, and choose how bad blocks fail
+ * Erase counts start when faults are enabled.
+ * @param erase_cycles Erases a block survives (0 = never wears out)
+ * @param behavior FAULT_BAD_* for worn and marked blocks alike
+ * @return 0 on success, LFS_ERR_INVAL if faults aren't enabled
+ */
+int lfs_wasm_fault_wear(lfs_wasm_ctx_t *ctx, uint32_t erase_cycles, int behavior) {
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (!fault || behavior < FAULT_BAD_PROG_ERROR || behavior > FAULT_BAD_ERASE_NOOP) {
         return LFS_ERR_INVAL;
     }
-    
-    struct lfs_info info;
-    
-    int res = lfs_dir_read(&lfs, &open_dirs[handle], &info);
-    if (res <= 0) return res;
-    
-    // Skip . and ..
-    if (strcmp(info.name, ".") == 0 || strcmp(info.name, "..") == 0) {
-        return lfs_wasm_dir_read(handle, out_name, out_name_len, out_type, out_size);
+    fault->erase_cycles = erase_cycles;
+    fault->bad_behavior = behavior;
+    return 0;
+}
+
+/**
+ * Mark a block bad (or good again)
+ * Clearing also resets its erase count, so a worn block becomes usable.
+ * @return 0 on success, LFS_ERR_INVAL if faults aren't enabled or the
+ *         block is out of range
+ */
+int lfs_wasm_fault_bad_block(lfs_wasm_ctx_t *ctx, uint32_t block, int bad) {
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (!fault || block >= ctx->block_count) return LFS_ERR_INVAL;
+    fault->bad[block] = bad ? 1 : 0;
+    if (!bad) fault->erases[block] = 0;
+    return 0;
+}
+
+/**
+ * Get the fault state
+ * @param out_ops Output: progs and erases counted since the last arm
+ * @return 1 if power has been lost, 0 if not, LFS_ERR_INVAL if faults
+ *         aren't enabled
+ */
+int lfs_wasm_fault_state(lfs_wasm_ctx_t *ctx, uint32_t *out_ops) {
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (!fault) return LFS_ERR_INVAL;
+    *out_ops = fault->ops;
+    return fault->power_lost;
+}
+
+/**
+ * Cut power if it is still on, restore it, and remount what reached the
+ * device
+ * Open handles are dropped (their unsynced data is lost with the power),
+ * and the power loss is disarmed.
+ * @return 0 on success, LFS_ERR_INVAL if faults aren't enabled, or the
+ *         mount error: LFS_ERR_CORRUPT means the image didn't survive
+ */
+int lfs_wasm_power_cycle(lfs_wasm_ctx_t *ctx) {
+    lfs_wasm_fault_t *fault = ctx->fault;
+    if (!fault) return LFS_ERR_INVAL;
+
+    CTX_LOCK(ctx);
+    fault->power_lost = 1;
+    if (ctx->mounted) {
+        // Without power, so closing can't write anything
+        ctx_close_handles(ctx);
+        lfs_unmount(&ctx->lfs);
+        ctx->mounted = 0;
     }
-    
-    strncpy(out_name, info.name, out_name_len - 1);
-    out_name[out_name_len - 1] = '\0';
-    *out_type = (info.type == LFS_TYPE_DIR) ? 2 : 1;
-    *out_size = info.size;
-    
-    return 1;
+    fault->power_lost = 0;
+    fault->cut_after = FAULT_NEVER;
+    fault->ops = 0;
+    int err = lfs_wasm_mount(ctx);
+    CTX_UNLOCK(ctx);
+    return err;
 }
 
 /**
- * Close a directory
- * @param handle Directory handle
- * @return 0 on success, negative error code on failure
+ * Prepare the mounted filesystem for a fast first mount on the target
+ * Completes pending orphan/move cleanup and gstate (lfs_fs_mkconsistent),
+ * then compacts every metadata log past the threshold (lfs_fs_gc).
+ * Open files stay valid.
+ * @param compact_thresh Compaction threshold in bytes for this call:
+ *        < 0 keeps the configured one, 0 is the littlefs default
+ *        (7/8 of a block), otherwise at most block_size
+ * @return Number of metadata blocks rewritten (one per compacted pair,
+ *         plus any relocations), or negative error code on failure
  */
-int lfs_wasm_dir_close(int handle) {
-    if (handle < 0 || handle >= MAX_DIRS || !dir_in_use[handle]) {
+int lfs_wasm_optimize(lfs_wasm_ctx_t *ctx, int32_t compact_thresh) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+    if (compact_thresh > 0 && (uint32_t)compact_thresh > ctx->block_size) {
         return LFS_ERR_INVAL;
     }
-    
-    int err = lfs_dir_close(&lfs, &open_dirs[handle]);
-    dir_in_use[handle] = 0;
-    return err;
+
+    // littlefs reads both through its pointer to ctx->cfg
+    lfs_size_t configured = ctx->cfg.compact_thresh;
+    if (compact_thresh >= 0) ctx->cfg.compact_thresh = (lfs_size_t)compact_thresh;
+    ctx->optimize_erase = ctx->cfg.erase;
+    ctx->cfg.erase = optimize_erase;
+    ctx->optimize_erases = 0;
+
+    int err = lfs_fs_mkconsistent(&ctx->lfs);
+    if (err == 0) err = lfs_fs_gc(&ctx->lfs);
+
+    ctx->cfg.erase = ctx->optimize_erase;
+    ctx->cfg.compact_thresh = configured;
+    return err < 0 ? err : (int)ctx->optimize_erases;
 }
 
 /**
- * Write a file (creates parent directories if needed)
- * @param path File path
- * @param data File data
- * @param size Data size in bytes
- * @return 0 on success, negative error code on failure
+ * Rebuild the contents of src into a freshly formatted dst
+ * Directories are created first, then files are written one at a time,
+ * grouped by directory in name order, so every file's blocks are
+ * allocated contiguously from block 0 and the result depends only on the
+ * contents. Packing at the low end lets the copy be shrunk afterwards.
+ * dst must be initialized; it is formatted (with src's disk version
+ * unless one was set) and left mounted.
+ * @param types Custom attribute types to carry over (at most
+ *              MAX_FILE_ATTRS); others are dropped
+ * @return Number of entries copied, or negative error code on failure
  */
-int lfs_wasm_write_file(const char *path, const uint8_t *data, uint32_t size) {
-    if (!mounted) return LFS_ERR_INVAL;
-    
-    // Create parent directories
-    char dir_path[MAX_PATH_LENGTH];
-    strncpy(dir_path, path, MAX_PATH_LENGTH - 1);
-    dir_path[MAX_PATH_LENGTH - 1] = '\0';
-    
-    for (char *p = dir_path + 1; *p; p++) {
-        if (*p == '/') {
-            *p = '\0';
-            lfs_mkdir(&lfs, dir_path); // Ignore errors (may already exist)
-            *p = '/';
+int lfs_wasm_repack(lfs_wasm_ctx_t *dst, lfs_wasm_ctx_t *src,
+                    const uint8_t *types, uint32_t type_count) {
+    if (!src->mounted || dst == src) return LFS_ERR_INVAL;
+    if (type_count > MAX_FILE_ATTRS) return LFS_ERR_INVAL;
+
+    if (!dst->disk_version) dst->disk_version = src->disk_version;
+    int err = lfs_wasm_format(dst);
+    if (err < 0) return err;
+    err = lfs_wasm_mount(dst);
+    if (err < 0) return err;
+    ctx_alloc_rewind(dst);
+
+    int len = lfs_wasm_list_tree(src, "/", 1);
+    if (len < 0) return len;
+
+    uint32_t count = 0;
+    const uint8_t **entries = NULL;
+    err = entry_index(src->list_buf, len, 0, &entries, &count);
+    if (err < 0) return err;
+    attr_carry_t carry;
+    uint8_t *buf = (uint8_t *)malloc(dst->block_size);
+    err = buf ? attr_carry_init(&carry, types, type_count) : LFS_ERR_NOMEM;
+    if (err < 0) {
+        free(entries);
+        free(buf);
+        return err;
+    }
+    qsort(entries, count, sizeof(*entries), repack_compare);
+
+    char path[MAX_PATH_LENGTH];
+    for (uint32_t i = 0; i < count && err >= 0; i++) {
+        uint32_t path_len = ENTRY_PATH_LEN(entries[i]);
+        memcpy(path, entries[i] + LIST_ENTRY_HEADER, path_len);
+        path[path_len] = '\0';
+        if (entries[i][0] == 2) {
+            err = lfs_mkdir(&dst->lfs, path);
+            if (err >= 0) err = attr_carry_dir(&carry, dst, path, src, path, 0);
+        } else {
+            err = ctx_copy_file(dst, path, src, path, LFS_O_EXCL, buf, dst->block_size, &carry);
         }
     }
-    
-    lfs_file_t file;
-    int err = lfs_file_open(&lfs, &file, path, 
-                            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+
+    free(entries);
+    free(buf);
+    attr_carry_free(&carry);
+    return err < 0 ? err : (int)count;
+}
+
+/**
+ * Compute the changes that turn the tree of a into the tree of b
+ * Both trees are listed and merged in path order. Files of equal size are
+ * compared by content, stopping at the first difference, so unchanged
+ * files cost one read of each side and changed sizes cost nothing.
+ * Entries whose attributes of the given types differ are modified too,
+ * directories included.
+ * The change set goes to a's list buffer (lfs_wasm_list_buffer), packed as
+ *   u8 op (1 added, 2 removed, 3 modified), then a listing entry
+ *   (u8 type, u32 size, u16 path_len, path) describing the entry in b,
+ *   or in a for removals
+ * in path order. A path that changes type is removed and added.
+ * @param types Custom attribute types to compare (at most MAX_FILE_ATTRS)
+ * @return Packed size in bytes, or negative error code
+ */
+int lfs_wasm_diff(lfs_wasm_ctx_t *a, lfs_wasm_ctx_t *b,
+                  const uint8_t *types, uint32_t type_count) {
+    if (!a->mounted || !b->mounted) return LFS_ERR_INVAL;
+    if (type_count > MAX_FILE_ATTRS) return LFS_ERR_INVAL;
+
+    int len_a = lfs_wasm_list_tree(a, "/", 1);
+    if (len_a < 0) return len_a;
+    // Keep a's listing while b is listed; a and b may be the same context
+    uint8_t *list_a = list_take(a);
+    int len_b = lfs_wasm_list_tree(b, "/", 1);
+    uint8_t *list_b = list_take(b);
+
+    const uint8_t **ea = NULL, **eb = NULL;
+    uint32_t na = 0, nb = 0;
+    uint32_t chunk = a->block_size;
+    uint8_t *buf = (uint8_t *)malloc(2 * (size_t)chunk);
+    attr_carry_t ca, cb;
+    int err = len_b < 0 ? len_b : buf ? 0 : LFS_ERR_NOMEM;
+    int err_a = attr_carry_init(&ca, types, type_count);
+    int err_b = attr_carry_init(&cb, types, type_count);
+    if (err == 0) err = err_a < 0 ? err_a : err_b;
+    if (err == 0) err = entry_index(list_a, len_a, 0, &ea, &na);
+    if (err == 0) err = entry_index(list_b, len_b, 0, &eb, &nb);
+    if (err == 0) {
+        qsort(ea, na, sizeof(*ea), path_order);
+        qsort(eb, nb, sizeof(*eb), path_order);
+    }
+
+    char path[MAX_PATH_LENGTH];
+    uint32_t i = 0, j = 0;
+    while (err == 0 && (i < na || j < nb)) {
+        int cmp = i == na ? 1 : j == nb ? -1 : entry_path_cmp(ea[i], eb[j]);
+        if (cmp < 0) {
+            err = change_append(a, CHANGE_REMOVED, ea[i++]);
+        } else if (cmp > 0) {
+            err = change_append(a, CHANGE_ADDED, eb[j++]);
+        } else {
+            const uint8_t *x = ea[i++], *y = eb[j++];
+            if (x[0] != y[0]) {
+                err = change_append(a, CHANGE_REMOVED, x);
+                if (err == 0) err = change_append(a, CHANGE_ADDED, y);
+            } else if (x[0] == 1 || type_count) {
+                // Sizes first, then attributes, then contents
+                int same = x[0] == 2 || memcmp(x + 1, y + 1, 4) == 0;
+                uint32_t path_len = ENTRY_PATH_LEN(x);
+                memcpy(path, x + LIST_ENTRY_HEADER, path_len);
+                path[path_len] = '\0';
+                if (same == 1 && type_count) same = attrs_equal(&ca, &cb, a, b, path);
+                if (same == 1 && x[0] == 1) same = files_equal(a, b, path, buf, buf + chunk, chunk);
+                if (same < 0) {
+                    err = same;
+                } else if (!same) {
+                    err = change_append(a, CHANGE_MODIFIED, y);
+                }
+            }
+        }
+    }
+
+    free(ea);
+    free(eb);
+    free(buf);
+    free(list_a);
+    free(list_b);
+    attr_carry_free(&ca);
+    attr_carry_free(&cb);
+    if (err < 0) {
+        a->list_len = 0;
+        return err;
+    }
+    return a->list_len;
+}
+
+/**
+ * Apply a change set from lfs_wasm_diff(dst, src) to dst, copying added
+ * and modified files from src
+ * Removals run first, deepest path first; then directories are created
+ * and files copied in path order. Only the listed paths are touched.
+ * Removing a path that is already gone is not an error. Added and
+ * modified entries take src's attributes of the given types, and lose
+ * those of the types src doesn't have.
+ * @param changes Packed change set (see lfs_wasm_diff)
+ * @param len Size of the change set in bytes
+ * @param types Custom attribute types to carry (at most MAX_FILE_ATTRS)
+ * @return Number of changes applied, or negative error code
+ */
+int lfs_wasm_apply(lfs_wasm_ctx_t *dst, lfs_wasm_ctx_t *src, const uint8_t *changes, uint32_t len,
+                   const uint8_t *types, uint32_t type_count) {
+    if (!dst->mounted || !src->mounted || dst == src) return LFS_ERR_INVAL;
+    if (type_count > MAX_FILE_ATTRS) return LFS_ERR_INVAL;
+
+    const uint8_t **entries = NULL;
+    uint32_t count = 0;
+    int err = entry_index(changes, len, 1, &entries, &count);
     if (err < 0) return err;
-    
-    lfs_ssize_t written = lfs_file_write(&lfs, &file, data, size);
-    lfs_file_close(&lfs, &file);
-    
-    if (written < 0) return written;
-    if ((uint32_t)written != size) return LFS_ERR_IO;
-    
+    attr_carry_t carry;
+    uint8_t *buf = (uint8_t *)malloc(dst->block_size);
+    err = buf ? attr_carry_init(&carry, types, type_count) : LFS_ERR_NOMEM;
+    if (err < 0) {
+        free(entries);
+        free(buf);
+        return err;
+    }
+
+    char path[MAX_PATH_LENGTH];
+    // Pass 0 removes in reverse order (children before parents), pass 1 adds
+    for (int pass = 0; pass < 2 && err >= 0; pass++) {
+        for (uint32_t k = 0; k < count && err >= 0; k++) {
+            const uint8_t *change = entries[pass == 0 ? count - 1 - k : k];
+            uint8_t op = change[0];
+            const uint8_t *entry = change + 1;
+            if ((op == CHANGE_REMOVED) != (pass == 0)) continue;
+
+            uint32_t path_len = ENTRY_PATH_LEN(entry);
+            if (path_len >= MAX_PATH_LENGTH) {
+                err = LFS_ERR_NAMETOOLONG;
+                break;
+            }
+            memcpy(path, entry + LIST_ENTRY_HEADER, path_len);
+            path[path_len] = '\0';
+
+            if (op == CHANGE_REMOVED) {
+                err = lfs_remove(&dst->lfs, path);
+                if (err == LFS_ERR_NOENT) err = 0;
+                dir_cache_forget(dst, path);
+            } else if (op != CHANGE_ADDED && op != CHANGE_MODIFIED) {
+                err = LFS_ERR_INVAL;
+            } else if (entry[0] == 2) {
+                err = op == CHANGE_ADDED ? lfs_mkdir(&dst->lfs, path) : 0;
+                if (err == LFS_ERR_EXIST) err = 0;
+                if (err == 0) dir_cache_add(dst, path, path_len);
+                if (err == 0) err = attr_carry_dir(&carry, dst, path, src, path, 1);
+            } else {
+                ctx_mkdir_parents(dst, path);
+                err = ctx_copy_file(dst, path, src, path, LFS_O_TRUNC, buf, dst->block_size, &carry);
+            }
+        }
+    }
+
+    free(entries);
+    free(buf);
+    attr_carry_free(&carry);
+    return err < 0 ? err : (int)count;
+}
+
+// lfs_wasm_resize with the context lock held
+static int ctx_resize(lfs_wasm_ctx_t *ctx, uint32_t block_count) {
+    if (!ctx->mounted || ctx->backend == BACKEND_EXTERNAL) return LFS_ERR_INVAL;
+    // A borrowed image can't be reallocated; read-only ones fail in lfs_fs_grow
+    if (ctx->borrowed) return LFS_ERR_INVAL;
+    // Snapshot block tables are sized to the device
+    if (ctx->snapshots) return LFS_ERR_INVAL;
+    // Once the superblock has expanded out of blocks 0 and 1, every pair
+    // on the way to the root holds a copy, but lfs_fs_grow only rewrites
+    // the root's and the image no longer mounts
+    if (ctx->lfs.root[0] > 1 || ctx->lfs.root[1] > 1) return LFS_ERR_INVAL;
+    if (block_count < 2 || (uint64_t)block_count * ctx->block_size > UINT32_MAX) {
+        return LFS_ERR_INVAL;
+    }
+    uint32_t old_count = ctx->block_count;
+    if (block_count == old_count) return 0;
+
+    int err;
+    if (block_count > old_count) {
+        // Storage must exist before littlefs can commit the new superblock
+        err = ctx_resize_storage(ctx, block_count);
+        if (err < 0) return err;
+        ctx->block_count = ctx->cfg.block_count = block_count;
+        ctx->storage_size = ctx->block_size * block_count;
+        // lfs_fs_grow commits the superblock with the new count already
+        // set; a window scanned for the old count, mapped modulo the new
+        // one, would hand out blocks in use
+        ctx_alloc_rewind(ctx);
+        err = lfs_fs_grow(&ctx->lfs, block_count);
+        if (err < 0) {
+            // The extra storage is harmless; just hide it again
+            ctx->block_count = ctx->cfg.block_count = ctx->lfs.block_count = old_count;
+            ctx->storage_size = ctx->block_size * old_count;
+            ctx_alloc_rewind(ctx);
+            return err;
+        }
+    } else {
+        // Checks that nothing lives past the new end before changing
+        // anything. Rewind as above, checkpointed at the new count so the
+        // first scan stays below the new end.
+        ctx_alloc_rewind(ctx);
+        ctx->lfs.lookahead.ckpoint = block_count;
+        err = lfs_fs_grow(&ctx->lfs, block_count);
+        if (err < 0) {
+            ctx->lfs.block_count = old_count;
+            ctx_alloc_rewind(ctx);
+            return err;
+        }
+        // A failed shrinking realloc just keeps the larger buffer
+        (void)ctx_resize_storage(ctx, block_count);
+        ctx->block_count = ctx->cfg.block_count = block_count;
+        ctx->storage_size = ctx->block_size * block_count;
+    }
+
+    // Keep a full-device lookahead covering the device; on failure the old
+    // buffer stays and littlefs just scans in more than one window
+    if (ctx->full_lookahead) {
+        uint32_t la_size = full_lookahead_size(block_count);
+        void *buffer = lfs_malloc(la_size);
+        if (buffer) {
+            lfs_free(ctx->lfs.lookahead.buffer);
+            ctx->lfs.lookahead.buffer = (uint8_t *)buffer;
+            ctx->cfg.lookahead_size = la_size;
+        }
+    }
+
+    ctx_alloc_rewind(ctx);
     return 0;
 }
 
 /**
- * Read a file
- * @param path File path
- * @param out_data Output buffer (caller allocates)
- * @param max_size Maximum bytes to read
- * @return Number of bytes read, or negative error code
+ * Change the block count of a mounted RAM or sparse filesystem in place
+ * Storage is reallocated (new blocks read as erased) and the superblock
+ * updated with lfs_fs_grow. Shrinking only succeeds if no block past the
+ * new end is in use, which is typically the case after lfs_wasm_repack.
+ * Open files stay valid.
+ * @return 0 on success, LFS_ERR_NOTEMPTY if shrinking would drop blocks
+ *         in use, LFS_ERR_INVAL for external devices, a zero count,
+ *         while snapshots exist or once the superblock has expanded
+ *         (repack into a context of the new size instead),
+ *         LFS_ERR_NOMEM, or another negative error code
  */
-int lfs_wasm_read_file(const char *path, uint8_t *out_data, uint32_t max_size) {
-    if (!mounted) return LFS_ERR_INVAL;
-    
-    lfs_file_t file;
-    int err = lfs_file_open(&lfs, &file, path, LFS_O_RDONLY);
-    if (err < 0) return err;
-    
-    lfs_ssize_t read = lfs_file_read(&lfs, &file, out_data, max_size);
-    lfs_file_close(&lfs, &file);
-    
-    return read;
+int lfs_wasm_resize(lfs_wasm_ctx_t *ctx, uint32_t block_count) {
+    // The storage is reallocated outside any littlefs call
+    CTX_LOCK(ctx);
+    int err = ctx_resize(ctx, block_count);
+    CTX_UNLOCK(ctx);
+    return err;
 }
 
 /**
- * Get the size of a file
- * @param path File path
- * @return File size in bytes, or negative error code
+ * Take a copy-on-write snapshot of a RAM or sparse filesystem
+ * Costs one pointer per block up front; after that each block is copied
+ * the first time it is written, so memory and time scale with the blocks
+ * modified. Unsynced data in open files is not part of the snapshot.
+ * @return Snapshot id (positive), or negative error code
  */
-int lfs_wasm_file_size(const char *path) {
-    if (!mounted) return LFS_ERR_INVAL;
-    
-    struct lfs_info info;
-    int err = lfs_stat(&lfs, path, &info);
-    if (err < 0) return err;
-    
-    return info.size;
+int lfs_wasm_snapshot(lfs_wasm_ctx_t *ctx) {
+    if (!ctx_has_storage(ctx) || ctx->backend == BACKEND_EXTERNAL) return LFS_ERR_INVAL;
+
+    lfs_wasm_snapshot_t *snap = (lfs_wasm_snapshot_t *)calloc(1, sizeof(*snap));
+    if (!snap) return LFS_ERR_NOMEM;
+    snap->blocks = (uint8_t **)calloc(ctx->block_count, sizeof(*snap->blocks));
+    if (!snap->blocks) {
+        free(snap);
+        return LFS_ERR_NOMEM;
+    }
+
+    CTX_LOCK(ctx);
+    snap->id = ++ctx->next_snapshot_id;
+    snap->older = ctx->snapshots;
+    ctx->snapshots = snap;
+    CTX_UNLOCK(ctx);
+    return snap->id;
 }
 
 /**
- * Get the raw filesystem image
- * @return Pointer to the image data
+ * Roll the storage back to a snapshot and remount
+ * Open file and directory handles are closed. The snapshot stays valid
+ * (the filesystem now matches it again); newer snapshots are released.
+ * @param id Snapshot from lfs_wasm_snapshot
+ * @return 0 on success, LFS_ERR_NOENT for an unknown or released id, or
+ *         the mount error
+ */
+int lfs_wasm_restore(lfs_wasm_ctx_t *ctx, uint32_t id) {
+    lfs_wasm_snapshot_t *target = snap_find(ctx, id);
+    if (!target) return LFS_ERR_NOENT;
+
+    CTX_LOCK(ctx);
+    int remount = ctx->mounted;
+    if (ctx->mounted) {
+        ctx_close_handles(ctx);
+        lfs_unmount(&ctx->lfs);
+        ctx->mounted = 0;
+    }
+
+    // Newest first, so the copy from the oldest snapshot involved wins
+    for (lfs_wasm_snapshot_t *snap = ctx->snapshots; ; snap = snap->older) {
+        for (uint32_t i = 0; snap->saved && i < ctx->block_count; i++) {
+            if (!snap->blocks[i]) continue;
+            snap_write_back(ctx, i, snap->blocks[i]);
+            snap->blocks[i] = NULL;
+            snap->saved--;
+        }
+        if (snap == target) break;
+    }
+    while (ctx->snapshots != target) snap_drop(ctx, ctx->snapshots);
+
+    int err = remount ? lfs_wasm_mount(ctx) : 0;
+    CTX_UNLOCK(ctx);
+    return err;
+}
+
+/**
+ * Release a snapshot; its blocks move to the next older one where needed
+ * @return 0 on success, LFS_ERR_NOENT for an unknown or released id
  */
-uint8_t* lfs_wasm_get_image(void) {
-    return ram_storage;
+int lfs_wasm_snapshot_release(lfs_wasm_ctx_t *ctx, uint32_t id) {
+    lfs_wasm_snapshot_t *snap = snap_find(ctx, id);
+    if (!snap) return LFS_ERR_NOENT;
+    CTX_LOCK(ctx);
+    snap_drop(ctx, snap);
+    CTX_UNLOCK(ctx);
+    return 0;
 }
 
 /**
- * Get the filesystem image size
- * @return Size in bytes
+ * Blocks saved by a snapshot so far (memory held: this times block_size)
+ * @return Block count, or LFS_ERR_NOENT
  */
-uint32_t lfs_wasm_get_image_size(void) {
-    return storage_size;
+int lfs_wasm_snapshot_blocks(lfs_wasm_ctx_t *ctx, uint32_t id) {
+    lfs_wasm_snapshot_t *snap = snap_find(ctx, id);
+    return snap ? (int)snap->saved : LFS_ERR_NOENT;
 }
 
 /**
@@ -544,28 +4155,22 @@ uint32_t lfs_wasm_get_image_size(void) {
  * @param out_total Output: total blocks
  * @return 0 on success, negative error code on failure
  */
-int lfs_wasm_fs_stat(uint32_t *out_used, uint32_t *out_total) {
-    if (!mounted) return LFS_ERR_INVAL;
-    
-    lfs_ssize_t used = lfs_fs_size(&lfs);
+int lfs_wasm_fs_stat(lfs_wasm_ctx_t *ctx, uint32_t *out_used, uint32_t *out_total) {
+    if (!ctx->mounted) return LFS_ERR_INVAL;
+
+    lfs_ssize_t used = lfs_fs_size(&ctx->lfs);
     if (used < 0) return used;
-    
+
     *out_used = used;
-    *out_total = block_count;
+    *out_total = ctx->block_count;
     return 0;
 }
 
 /**
- * Clean up and free all resources
+ * Clean up and free the storage of a context
+ * The context can be re-initialized afterwards; use lfs_wasm_ctx_destroy
+ * to release the context itself.
  */
-void lfs_wasm_cleanup(void) {
-    if (mounted) {
-        lfs_unmount(&lfs);
-        mounted = 0;
-    }
-    if (ram_storage) {
-        free(ram_storage);
-        ram_storage = NULL;
-    }
-    storage_size = 0;
+void lfs_wasm_cleanup(lfs_wasm_ctx_t *ctx) {
+    ctx_release(ctx);
 }
@@ -33,15 +33,71 @@
 export {
   createLittleFS,
   createLittleFSFromImage,
+  createLittleFSFromStream,
+  createLittleFSOnDevice,
+  createLittleFSFromSparse,
+  compileLittleFSModule,
+  preloadLittleFS,
+  createSyncAccessHandleDevice,
+  createNodeFileDevice,
+  diffImages,
+  sweepPowerLoss,
+  checkImages,
   LittleFSError,
   DISK_VERSION_2_0,
   DISK_VERSION_2_1,
   formatDiskVersion,
+  ESP_IDF_MTIME_ATTR,
   type LittleFS,
   type LittleFSEntry,
+  type LittleFSAttributes,
+  type LittleFSListOptions,
+  type LittleFSDeltaRange,
+  type LittleFSSparseImage,
+  type LittleFSIOStats,
+  type LittleFSRepackOptions,
+  type LittleFSChange,
+  type LittleFSSyncOptions,
+  type LittleFSCopyOptions,
+  type LittleFSSnapshot,
+  type LittleFSFaultOptions,
+  type LittleFSFaultState,
+  type LittleFSBadBlockBehavior,
+  type LittleFSPowerLossOptions,
+  type LittleFSPowerLossReport,
+  type LittleFSCheckEntry,
+  type LittleFSCheckReport,
+  type LittleFSFileEntry,
+  type LittleFSFileHandle,
+  type LittleFSOpenMode,
+  type LittleFSSeekWhence,
+  type LittleFSStreamOptions,
+  type LittleFSExportFormat,
+  type LittleFSExportStreamOptions,
   type LittleFSOptions,
+  type LittleFSPreset,
+  type LittleFSVariant,
+  type LittleFSBlockDevice,
+  type LittleFSDeviceOptions,
+  type SyncAccessHandleLike,
+  type NodeFileSystemLike,
 } from './littlefs/index';
 
+export {
+  createLittleFSPool,
+  type LittleFSPool,
+  type LittleFSPoolOptions,
+  type LittleFSPoolStats,
+} from './littlefs/pool';
+
+export { type LittleFSBuildJob } from './littlefs/rpc';
+
+export {
+  createLittleFSWorker,
+  type LittleFSWorker,
+  type LittleFSWorkerOptions,
+} from './littlefs/remote';
+
 export {
   type FileSource,
   type BinarySource,
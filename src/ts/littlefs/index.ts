@@ -42,16 +42,224 @@ export interface LittleFSEntry {
   path: string;
   size: number;
   type: 'file' | 'dir';
+  /** Values of the attribute types requested from `list()` that are set. */
+  attrs?: LittleFSAttributes;
 }
 
+/**
+ * Custom attributes by type (0-255), e.g. an mtime or a content hash.
+ * Values are at most 1022 bytes.
+ */
+export type LittleFSAttributes = Record<number, Uint8Array>;
+
+/**
+ * Attribute type ESP-IDF's littlefs driver stores file mtimes under ('t')
+ */
+export const ESP_IDF_MTIME_ATTR = 0x74;
+
+// Attribute types copied along by repack() and applyChanges() by default
+const DEFAULT_CARRIED_ATTRS = [ESP_IDF_MTIME_ATTR];
+
+/**
+ * One file for `writeFiles()`.
+ */
+export interface LittleFSFileEntry {
+  path: string;
+  data: FileSource;
+  /** Attributes committed together with the file. */
+  attrs?: Record<number, FileSource>;
+}
+
+export interface LittleFSListOptions {
+  /** Attribute types to return with every entry, read in the same walk. */
+  attrs?: number[];
+}
+
+/**
+ * A contiguous run of modified bytes in the image, as returned by
+ * `exportDelta()`. `offset` is relative to the start of the partition.
+ */
+export interface LittleFSDeltaRange {
+  offset: number;
+  data: Uint8Array;
+}
+
+/**
+ * An image stored as its non-erased ranges only, as returned by
+ * `exportSparse()`. Every byte outside `ranges` is 0xFF.
+ */
+export interface LittleFSSparseImage {
+  size: number;
+  blockSize: number;
+  ranges: LittleFSDeltaRange[];
+}
+
+/**
+ * fopen-style open modes for `openFile()`.
+ * Modes that create the file also create missing parent directories.
+ */
+export type LittleFSOpenMode = 'r' | 'r+' | 'w' | 'w+' | 'a' | 'a+';
+
+export type LittleFSSeekWhence = 'set' | 'cur' | 'end';
+
+/**
+ * An open file. Data moves through a fixed-size staging buffer in WASM
+ * memory, so heap use does not grow with the file size.
+ */
+export interface LittleFSFileHandle {
+  readonly path: string;
+  /** Read into `buffer`, returning the number of bytes read (0 at EOF). */
+  read(buffer: Uint8Array): number;
+  /** Write `data` at the current position, returning the bytes written. */
+  write(data: FileSource): number;
+  /** Move the file position, returning the new position. */
+  seek(offset: number, whence?: LittleFSSeekWhence): number;
+  tell(): number;
+  /** Current size, including writes not yet synced. */
+  size(): number;
+  truncate(size: number): void;
+  sync(): void;
+  close(): void;
+}
+
+export interface LittleFSStreamOptions {
+  /**
+   * Size of the WASM staging buffer and of the chunks produced by read
+   * streams (default 64 KiB).
+   */
+  chunkSize?: number;
+}
+
+/**
+ * - `raw`: the flat image, as `toImage()` returns it
+ * - `sparse`: Android sparse image (as read by fastboot and `simg2img`),
+ *   with every run of erased blocks stored as a 0xFFFFFFFF fill chunk
+ * - `deflate`: the raw image as a zlib stream, as esptool and esptool-js
+ *   send with `--compress` (`flash_defl_begin`)
+ */
+export type LittleFSExportFormat = 'raw' | 'sparse' | 'deflate';
+
+export interface LittleFSExportStreamOptions {
+  format?: LittleFSExportFormat;
+  /** Image bytes read per chunk, rounded down to whole blocks (default 64 KiB). */
+  chunkSize?: number;
+}
+
+/**
+ * Named tuning presets for `LittleFSOptions.preset`:
+ * - `default`: byte-granular read/prog, full-block cache, 32-byte lookahead
+ * - `host-fast`: large read/prog units and a lookahead covering the whole
+ *   device, no wear leveling; fastest mount and bulk writes on the host
+ * - `esp-idf`: the esp_littlefs defaults (128-byte read/prog, 512-byte
+ *   cache, 128-byte lookahead, 512 block cycles, 64-char names)
+ * - `low-memory`: small caches for running many instances at once
+ */
+export type LittleFSPreset = 'default' | 'host-fast' | 'esp-idf' | 'low-memory';
+
 export interface LittleFSOptions {
   blockSize?: number;
   blockCount?: number;
   lookaheadSize?: number;
+  /**
+   * Size the lookahead to one bit per block (overrides `lookaheadSize`), so
+   * one traversal after mount finds every free block and writes only
+   * rescan after allocating their way around the whole device. Costs
+   * blockCount / 8 bytes; kept full-size across `resize()`. On by default
+   * in the `host-fast` preset.
+   */
+  fullLookahead?: boolean;
+  /**
+   * Remember directories known to exist so writes skip re-creating their
+   * parents (default true). Dropped on remove/rename and remount.
+   */
+  dirCache?: boolean;
+  /**
+   * Tuning preset; individual options below override its values.
+   */
+  preset?: LittleFSPreset;
+  /** Minimum read size in bytes (default 1). */
+  readSize?: number;
+  /** Minimum program size in bytes (default 1). */
+  progSize?: number;
+  /** Read/program cache size in bytes; must divide blockSize (default blockSize). */
+  cacheSize?: number;
+  /** Erase cycles before metadata is relocated; -1 disables wear leveling (default 500). */
+  blockCycles?: number;
+  /** Metadata compaction threshold in bytes; -1 never compacts (default littlefs). */
+  compactThreshold?: number;
+  /** Metadata log size limit in bytes (default blockSize). */
+  metadataMax?: number;
+  /** Inline file size limit in bytes; -1 disables inline files (default littlefs). */
+  inlineMax?: number;
+  /** File name length limit, stored in the superblock on format (default 255). */
+  nameMax?: number;
   /**
    * Optional override for the wasm asset location.
    */
   wasmURL?: string | URL;
+  /**
+   * `true` loads the `simd` build, which keeps littlefs's asserts, and
+   * `false` the `baseline` one; `variant` takes precedence. Left unset,
+   * the loader detects SIMD support and picks `fast` or `baseline`.
+   * Ignored when `wasmURL` is given; like `variant`, it must match the
+   * build already loaded.
+   */
+  simd?: boolean;
+  /**
+   * Build variant to load; see `LittleFSVariant`. Defaults to `fast` when
+   * the runtime supports SIMD and `baseline` otherwise. A realm loads one
+   * build: once it has, asking for another one through `variant`, `simd`
+   * or `threads` fails with LFS_ERR_INVAL.
+   */
+  variant?: LittleFSVariant;
+  /**
+   * Load the multi-threaded build (`littlefs-threads.wasm`, SIMD included),
+   * in which `readFiles()` reads on several threads at once. Needs
+   * SharedArrayBuffer, i.e. cross-origin isolation in browsers. A number
+   * caps the threads per batch (default: `navigator.hardwareConcurrency`,
+   * at most 8). Like `variant`, it must match the build already loaded.
+   */
+  threads?: boolean | number;
+  /**
+   * Precompiled module from `compileLittleFSModule()`, e.g. one compiled on
+   * the main thread and posted to workers. Skips fetching and compiling;
+   * pass the `variant` it returned alongside it.
+   */
+  wasmModule?: WebAssembly.Module;
+  /**
+   * Keep the .wasm response in the Cache API so later page loads compile
+   * it without a network round trip. `true` uses a cache named after this
+   * release (`littlefs-wasm-<version>`); a string names the cache. Entries
+   * are keyed by URL and release, and a release that misses deletes the
+   * `littlefs-wasm-*` caches and entries older ones left. Ignored where the
+   * Cache API is unavailable (Node, opaque origins).
+   */
+  wasmCache?: boolean | string;
+  /**
+   * Allocate image memory per block on first write instead of all at once;
+   * untouched blocks cost nothing. `toImageView()` is unavailable.
+   */
+  sparse?: boolean;
+  /**
+   * Count block device operations from the start, including format and
+   * mount; see `getIOStats()`.
+   */
+  ioStats?: boolean;
+  /**
+   * Also keep the last `ioTraceSize` operations for `exportIOTrace()`.
+   * Implies `ioStats`.
+   */
+  ioTraceSize?: number;
+  /**
+   * Inject faults from the start, including format and mount; see
+   * `enableFaults()`.
+   */
+  faults?: LittleFSFaultOptions;
+  /**
+   * Mount without prog or erase: every write fails with LFS_ERR_IO, so
+   * the image is never modified, not even by mount-time cleanup.
+   */
+  readOnly?: boolean;
   /**
    * Formats the filesystem immediately after initialization.
    */
@@ -64,27 +272,415 @@ export interface LittleFSOptions {
    * - 0 or undefined - Use latest version
    * 
    * IMPORTANT: Setting this prevents automatic migration of older filesystems.
+   * Other versions (another major, or a minor newer than 2.1) make
+   * `format()` fail with LFS_ERR_INVAL.
    */
   diskVersion?: number;
 }
 
+/**
+ * A block device implemented in JS, used by `createLittleFSOnDevice()`.
+ * Every call must complete synchronously; throw a `LittleFSError` to report
+ * a specific error code (anything else is reported as LFS_ERR_IO).
+ * `buffer`/`data` are views into WASM memory, valid only during the call.
+ */
+export interface LittleFSBlockDevice {
+  read(block: number, offset: number, buffer: Uint8Array): void;
+  prog(block: number, offset: number, data: Uint8Array): void;
+  /** Erase a block; subsequent reads of it must return 0xFF. */
+  erase(block: number): void;
+  sync?(): void;
+}
+
+/**
+ * The subset of `FileSystemSyncAccessHandle` (OPFS, workers only) used by
+ * `createSyncAccessHandleDevice()`.
+ */
+export interface SyncAccessHandleLike {
+  read(buffer: Uint8Array, options: { at: number }): number;
+  write(buffer: Uint8Array, options: { at: number }): number;
+  flush(): void;
+}
+
+/**
+ * The subset of Node's `fs` module used by `createNodeFileDevice()`.
+ */
+export interface NodeFileSystemLike {
+  readSync(fd: number, buffer: Uint8Array, offset: number, length: number, position: number): number;
+  writeSync(fd: number, buffer: Uint8Array, offset: number, length: number, position: number): number;
+  fsyncSync(fd: number): void;
+}
+
+export interface LittleFSDeviceOptions extends LittleFSOptions {
+  /**
+   * Whole blocks cached in WASM memory in front of the device (default 16).
+   * Writes always go straight through to the device.
+   */
+  cacheBlocks?: number;
+}
+
+/**
+ * Block device operations counted below littlefs's caches, i.e. what the
+ * flash itself would see.
+ */
+export interface LittleFSIOStats {
+  reads: { count: number; bytes: number };
+  progs: { count: number; bytes: number };
+  erases: { count: number; bytes: number };
+  syncs: { count: number };
+  /** Erases per block since enabling or the last reset. */
+  eraseCounts: Uint32Array;
+  /** Highest value in `eraseCounts`, the wear hot spot. */
+  maxBlockErases: number;
+  /** Trace records available to `exportIOTrace()`. */
+  traceRecords: number;
+}
+
+/**
+ * How bad blocks fail, as `lfs_emubd_badblock_behavior_t` in littlefs's
+ * emulated block device: with an LFS_ERR_CORRUPT error from prog, erase or
+ * read, or by silently ignoring progs or erases.
+ */
+export type LittleFSBadBlockBehavior = 'prog-error' | 'erase-error' | 'read-error' | 'prog-noop' | 'erase-noop';
+
+/**
+ * Simulated flash failures for `enableFaults()`.
+ */
+export interface LittleFSFaultOptions {
+  /** Progs and erases that succeed before power is lost; omit to keep power on. */
+  powerLossAfter?: number;
+  /**
+   * What the interrupted operation leaves behind: nothing (`'atomic'`,
+   * default), or for a prog, its first half (`'torn'`).
+   */
+  powerLossMode?: 'atomic' | 'torn';
+  /** Erases a block survives before it goes bad (default: never wears out). */
+  eraseCycles?: number;
+  /** How bad and worn-out blocks fail (default `'prog-error'`). */
+  badBlockBehavior?: LittleFSBadBlockBehavior;
+  /** Blocks that are bad from the start. */
+  badBlocks?: number[];
+}
+
+export interface LittleFSFaultState {
+  /** Whether the scheduled power loss has happened. */
+  powerLost: boolean;
+  /** Progs and erases since the power loss was last scheduled. */
+  operations: number;
+}
+
+/**
+ * One entry of a `check()` report.
+ */
+export interface LittleFSCheckEntry {
+  path: string;
+  type: 'file' | 'dir';
+  size: number;
+  /**
+   * A directory's metadata pair blocks; a file's data blocks from the last
+   * one back (none for files inlined in their directory).
+   */
+  blocks: number[];
+  /** First problem found in this entry (e.g. LFS_ERR_CORRUPT), or 0. */
+  error: number;
+}
+
+export interface LittleFSCheckReport {
+  /** No entry errors, traversal error, shared or out-of-range blocks. */
+  ok: boolean;
+  /** Every entry, each directory after its contents. */
+  entries: LittleFSCheckEntry[];
+  /** Entries with an error, with a readable message. */
+  errors: Array<{ path: string; code: number; message: string }>;
+  /** `lfs_fs_traverse()` over the whole metadata thread, or 0. */
+  traverseError: number;
+  /** Distinct blocks in use by the traversal. */
+  usedBlocks: number;
+  /** Block references past the end of the device. */
+  outOfRangeBlocks: number;
+  /** Blocks claimed by more than one entry (cross-linked). */
+  sharedBlocks: number;
+  /** Blocks in use but owned by no entry, e.g. orphans awaiting cleanup. */
+  unreferencedBlocks: number;
+}
+
+/**
+ * Overrides for `repack()`; anything omitted is taken from the source
+ * filesystem. Runtime options (wasm loading, storage, instrumentation)
+ * don't apply.
+ */
+export interface LittleFSRepackOptions
+  extends Omit<
+    LittleFSOptions,
+    'wasmURL' | 'simd' | 'variant' | 'wasmModule' | 'wasmCache' | 'sparse' | 'formatOnInit' | 'ioStats' | 'ioTraceSize' | 'faults' | 'readOnly'
+  > {
+  /**
+   * Custom attribute types to carry over, at most 16 (default: the
+   * ESP-IDF mtime). littlefs can't enumerate attributes, so every other
+   * type is dropped.
+   */
+  attrs?: number[];
+}
+
+/**
+ * Options for `copy()`
+ */
+export interface LittleFSCopyOptions {
+  /**
+   * Custom attribute types to copy along with each entry, at most 16
+   * (default: the ESP-IDF mtime)
+   */
+  attrs?: number[];
+}
+
+/**
+ * Attribute handling for `diff()` and `applyChanges()`
+ */
+export interface LittleFSSyncOptions {
+  /**
+   * Custom attribute types, at most 16. `diff()` reports entries whose
+   * attributes of these types differ as modified (default: none, contents
+   * only); `applyChanges()` copies them from the source and removes those
+   * the source lacks (default: the ESP-IDF mtime).
+   */
+  attrs?: number[];
+}
+
+/**
+ * One step of a `diff()` change set. `type` and `size` describe the entry
+ * in the newer tree, or in the older one for removals.
+ */
+export interface LittleFSChange {
+  op: 'added' | 'removed' | 'modified';
+  path: string;
+  type: 'file' | 'dir';
+  size: number;
+}
+
+/**
+ * WASM build variants:
+ * - `baseline`: no SIMD, runs everywhere
+ * - `simd`: `-msimd128`, with littlefs's asserts and logging kept
+ * - `fast`: SIMD and bulk memory, without littlefs's asserts and logging
+ * - `readonly`: `LFS_READONLY`, optimized for size and about half the
+ *   code; every write fails with LFS_ERR_IO. For pages that only view
+ *   images.
+ * - `threads`: SIMD plus pthreads, as loaded by the `threads` option; name
+ *   it to pass on a module that `compileLittleFSModule()` compiled for
+ *   `threads`
+ */
+export type LittleFSVariant = 'baseline' | 'simd' | 'fast' | 'readonly' | 'threads';
+
+/**
+ * Handle to a `snapshot()`; plain data, so it can cross a worker boundary.
+ */
+export interface LittleFSSnapshot {
+  readonly id: number;
+}
+
 export interface LittleFS {
   format(): void;
-  list(path?: string): LittleFSEntry[];
+  list(path?: string, options?: LittleFSListOptions): LittleFSEntry[];
   addFile(path: string, data: FileSource): void;
-  writeFile(path: string, data: FileSource): void;
+  /**
+   * Create or replace a file. `attrs` are set in the same metadata commit
+   * as the file itself.
+   */
+  writeFile(path: string, data: FileSource, options?: { attrs?: Record<number, FileSource> }): void;
+  /**
+   * Write many files in as few WASM calls as possible. Entries are grouped
+   * by directory so shared parents are created once.
+   */
+  writeFiles(files: Iterable<LittleFSFileEntry>): void;
   deleteFile(path: string): void;
   delete(path: string, options?: { recursive?: boolean }): void;
   mkdir(path: string): void;
   rename(oldPath: string, newPath: string): void;
+  /**
+   * Copy a file or directory tree to `to`, creating missing parents.
+   * `to` must not exist or lie inside `from`. Contents are streamed block
+   * by block inside WASM, along with the attributes of the types in
+   * `options.attrs`. Returns the number of entries copied.
+   */
+  copy(from: string, to: string, options?: LittleFSCopyOptions): number;
+  /**
+   * `rename()` that creates missing parents of `to` and refuses to move a
+   * directory into itself. Directories move without copying.
+   */
+  move(from: string, to: string): void;
+  /**
+   * Copy of the whole image. Throws for filesystems on an external block
+   * device, as do `toImageView()`, `exportDelta()` and `exportSparse()`.
+   * `toImageView()` also throws for sparse storage.
+   */
   toImage(): Uint8Array;
+  /**
+   * Zero-copy view of the image inside WASM memory.
+   * Only valid until the next write to this filesystem or until WASM
+   * memory grows (which can happen on any allocation in the module).
+   */
+  toImageView(): Uint8Array;
+  /**
+   * Indices of blocks programmed or erased since init or the last
+   * `clearDirtyBlocks()`, in ascending order.
+   */
+  getDirtyBlocks(): number[];
+  /**
+   * Mark every block clean, e.g. after the image has been flashed.
+   */
+  clearDirtyBlocks(): void;
+  /**
+   * Copy out only the dirty blocks, merged into contiguous byte ranges.
+   * Pass `{ clear: true }` to mark them clean afterwards.
+   */
+  exportDelta(options?: { clear?: boolean }): LittleFSDeltaRange[];
+  /**
+   * Copy out only the non-erased blocks, merged into contiguous ranges.
+   * Load it back with `createLittleFSFromSparse()`.
+   */
+  exportSparse(): LittleFSSparseImage;
+  /**
+   * Stream the image, copying a chunk of blocks at a time out of WASM
+   * memory as the consumer pulls, so memory use doesn't grow with the
+   * partition. Don't write to the filesystem until the stream is done.
+   * Not available on external block devices.
+   */
+  exportStream(options?: LittleFSExportStreamOptions): ReadableStream<Uint8Array>;
+  /**
+   * Rebuild the contents into a freshly formatted image: directories
+   * first, then files grouped by directory in name order, each written in
+   * one pass. The result is defragmented and depends only on the contents
+   * and options, so equal trees give byte-identical images.
+   * Custom attributes are kept for the types in `options.attrs` only.
+   * This filesystem is left unchanged.
+   */
+  repack(options?: LittleFSRepackOptions): Uint8Array;
+  /**
+   * Grow or shrink the partition in place, keeping the mount and open
+   * files. Shrinking fails with LFS_ERR_NOTEMPTY while any block past the
+   * new end is in use; repacked images are packed at the start, so load a
+   * `repack()` result to shrink to the smallest partition that fits.
+   * Not available on external block devices, nor (LFS_ERR_INVAL) once
+   * wear has expanded the superblock out of blocks 0 and 1; `repack()`
+   * output starts unexpanded.
+   */
+  resize(blockCount: number): void;
+  /**
+   * Changes that turn this tree into `target`'s, in path order. Files of
+   * equal size are compared by content, and entries by the attribute types
+   * in `options.attrs`. A path that changes between file and directory is
+   * removed and added. Both filesystems must come from the same module
+   * (realm), as must `source` below.
+   */
+  diff(target: LittleFS, options?: LittleFSSyncOptions): LittleFSChange[];
+  /**
+   * Apply a change set, copying added and modified files from `source`
+   * (normally the `target` it was computed against) together with their
+   * attributes of the types in `options.attrs`. Paths not listed are left
+   * alone. Returns the number of changes applied.
+   */
+  applyChanges(changes: LittleFSChange[], source: LittleFS, options?: LittleFSSyncOptions): number;
+  /**
+   * Take a copy-on-write snapshot. Blocks are copied the first time they
+   * are written afterwards, so the cost scales with what changes, not the
+   * partition size. Not available on external block devices.
+   */
+  snapshot(): LittleFSSnapshot;
+  /**
+   * Roll back to a snapshot and remount. Open file handles are closed and
+   * newer snapshots released; this one stays valid for another rollback.
+   * Resizing is refused while snapshots exist.
+   */
+  restore(snapshot: LittleFSSnapshot): void;
+  releaseSnapshot(snapshot: LittleFSSnapshot): void;
+  /** Bytes of block copies a snapshot currently holds. */
+  getSnapshotSize(snapshot: LittleFSSnapshot): number;
   readFile(path: string): Uint8Array;
+  /**
+   * Read many files in one call, in order. With the `threads` build the
+   * batch is spread over several threads, each reading through its own
+   * read-only mount; writes wait until it finishes.
+   */
+  readFiles(paths: string[]): Uint8Array[];
+  /**
+   * Open a persistent file handle for incremental reads and writes.
+   */
+  openFile(path: string, mode?: LittleFSOpenMode, options?: LittleFSStreamOptions): LittleFSFileHandle;
+  /**
+   * Stream a file's contents in chunks of at most `chunkSize` bytes.
+   */
+  createReadStream(path: string, options?: LittleFSStreamOptions): ReadableStream<Uint8Array>;
+  /**
+   * Stream data into a file (created or truncated). The file is closed
+   * when the stream closes.
+   */
+  createWriteStream(path: string, options?: LittleFSStreamOptions): WritableStream<Uint8Array>;
   getUsage(): { used: number; total: number; free: number };
+  /**
+   * Custom attribute of a file or directory, or null if it isn't set.
+   * Attributes survive `rename()`/`move()` and rewriting the file, but
+   * littlefs can't enumerate them, so `copy()`, `repack()` and
+   * `applyChanges()` carry only the types they are given.
+   */
+  getAttr(path: string, type: number): Uint8Array | null;
+  setAttr(path: string, type: number, value: FileSource): void;
+  removeAttr(path: string, type: number): void;
+  /**
+   * Validate every metadata CRC and CTZ chain in one pass without writing,
+   * and map each entry to its blocks. File contents aren't checksummed by
+   * littlefs, so they aren't read.
+   */
+  check(): LittleFSCheckReport;
+  /**
+   * Finish pending cleanup and compact metadata logs, so the exported image
+   * mounts quickly on the target instead of compacting on first boot.
+   * `compactThreshold` (bytes, at most blockSize; 0 = littlefs default of
+   * 7/8 block) overrides the filesystem's setting for this call; lower
+   * values compact more logs. Returns the number of metadata blocks
+   * rewritten.
+   */
+  optimize(options?: { compactThreshold?: number }): number;
   /**
    * Get the disk version of the mounted filesystem.
    * Returns version as 32-bit number (e.g., 0x00020000 for v2.0, 0x00020001 for v2.1)
    */
   getDiskVersion(): number;
+  /**
+   * Start counting block device operations. Restarting resets the counters.
+   * `traceSize` keeps a ring of the last operations for `exportIOTrace()`.
+   */
+  enableIOStats(options?: { traceSize?: number }): void;
+  disableIOStats(): void;
+  /** Throws LFS_ERR_INVAL unless `enableIOStats()` or `ioStats` is active. */
+  getIOStats(): LittleFSIOStats;
+  resetIOStats(): void;
+  /**
+   * The trace ring, oldest first, in the text format of littlefs's
+   * `scripts/tracebd.py`.
+   */
+  exportIOTrace(): string;
+  /**
+   * Simulate flash failures: power loss after a number of progs and
+   * erases, bad blocks, and wear-out. Once power is lost every write fails
+   * with LFS_ERR_IO until `powerCycle()`. Enabling again resets all faults.
+   */
+  enableFaults(options?: LittleFSFaultOptions): void;
+  /** Restore normal operation; bad blocks become good again. */
+  disableFaults(): void;
+  /**
+   * Lose power after `after` more progs and erases (`null` keeps power on)
+   * and restart the operation count.
+   */
+  schedulePowerLoss(after: number | null, mode?: 'atomic' | 'torn'): void;
+  setBadBlock(block: number, bad?: boolean): void;
+  /** Throws LFS_ERR_INVAL unless `enableFaults()` or `faults` is active. */
+  getFaultState(): LittleFSFaultState;
+  /**
+   * Lose power now if it hasn't been lost yet, then restore it and remount
+   * whatever reached the device. Open file handles are dropped with their
+   * unsynced data. Throws the mount error if the image didn't survive.
+   */
+  powerCycle(): void;
   destroy(): void;
 }
 
@@ -99,27 +695,49 @@ export class LittleFSError extends Error {
   }
 }
 
+// LittleFS error codes (lfs_error in lfs.h)
+const LFS_ERR_IO = -5;
+const LFS_ERR_CORRUPT = -84;
+const LFS_ERR_NOENT = -2;
+const LFS_ERR_EXIST = -17;
+const LFS_ERR_NOTDIR = -20;
+const LFS_ERR_ISDIR = -21;
+const LFS_ERR_NOTEMPTY = -39;
+const LFS_ERR_BADF = -9;
+const LFS_ERR_FBIG = -27;
+const LFS_ERR_INVAL = -22;
+const LFS_ERR_NOSPC = -28;
+const LFS_ERR_NOMEM = -12;
+const LFS_ERR_NOATTR = -61;
+const LFS_ERR_NAMETOOLONG = -36;
+
 const ERROR_MESSAGES: Record<number, string> = {
-  [-1]: 'I/O error',
-  [-2]: 'Corrupted filesystem',
-  [-3]: 'No such file or directory',
-  [-4]: 'Entry already exists',
-  [-5]: 'Entry is not a directory',
-  [-6]: 'Entry is a directory',
-  [-7]: 'Directory not empty',
-  [-9]: 'Bad file descriptor',
-  [-10]: 'File too large',
-  [-11]: 'Invalid parameter',
-  [-12]: 'No space left on device',
-  [-13]: 'No memory available',
-  [-17]: 'No attribute available',
-  [-22]: 'Filename too long',
+  [LFS_ERR_IO]: 'I/O error',
+  [LFS_ERR_CORRUPT]: 'Corrupted filesystem',
+  [LFS_ERR_NOENT]: 'No such file or directory',
+  [LFS_ERR_EXIST]: 'Entry already exists',
+  [LFS_ERR_NOTDIR]: 'Entry is not a directory',
+  [LFS_ERR_ISDIR]: 'Entry is a directory',
+  [LFS_ERR_NOTEMPTY]: 'Directory not empty',
+  [LFS_ERR_BADF]: 'Bad file descriptor',
+  [LFS_ERR_FBIG]: 'File too large',
+  [LFS_ERR_INVAL]: 'Invalid parameter',
+  [LFS_ERR_NOSPC]: 'No space left on device',
+  [LFS_ERR_NOMEM]: 'No memory available',
+  [LFS_ERR_NOATTR]: 'No attribute available',
+  [LFS_ERR_NAMETOOLONG]: 'Filename too long',
 };
 
+function errorMessage(code: number): string {
+  return ERROR_MESSAGES[code] || `Unknown error (${code})`;
+}
+
 function checkError(code: number, context: string): void {
   if (code < 0) {
-    const msg = ERROR_MESSAGES[code] || `Unknown error (${code})`;
-    throw new LittleFSError(`${context}: ${msg}`, code);
+    // Every write fails this way in the read-only build, which a realm
+    // keeps once it has loaded it
+    const note = code === LFS_ERR_IO && loadedVariant === 'readonly' ? ' (the readonly build is loaded)' : '';
+    throw new LittleFSError(`${context}: ${errorMessage(code)}${note}`, code);
   }
 }
 
@@ -128,297 +746,1956 @@ function checkError(code: number, context: string): void {
 // ============================================================================
 
 interface LittleFSModule {
-  _lfs_wasm_init(blockSize: number, blockCount: number, lookahead: number): number;
-  _lfs_wasm_init_from_image(imagePtr: number, imageSize: number, blockSize: number): number;
-  _lfs_wasm_set_disk_version(version: number): void;
-  _lfs_wasm_get_disk_version(): number;
-  _lfs_wasm_get_fs_info(versionPtr: number): number;
-  _lfs_wasm_mount(): number;
-  _lfs_wasm_unmount(): number;
-  _lfs_wasm_format(): number;
-  _lfs_wasm_mkdir(pathPtr: number): number;
-  _lfs_wasm_remove(pathPtr: number): number;
-  _lfs_wasm_rename(oldPtr: number, newPtr: number): number;
-  _lfs_wasm_stat(pathPtr: number, typePtr: number, sizePtr: number): number;
-  _lfs_wasm_dir_open(pathPtr: number): number;
-  _lfs_wasm_dir_read(handle: number, namePtr: number, nameLen: number, typePtr: number, sizePtr: number): number;
-  _lfs_wasm_dir_close(handle: number): number;
-  _lfs_wasm_write_file(pathPtr: number, dataPtr: number, size: number): number;
-  _lfs_wasm_read_file(pathPtr: number, outPtr: number, maxSize: number): number;
-  _lfs_wasm_file_size(pathPtr: number): number;
-  _lfs_wasm_get_image(): number;
-  _lfs_wasm_get_image_size(): number;
-  _lfs_wasm_fs_stat(usedPtr: number, totalPtr: number): number;
-  _lfs_wasm_cleanup(): void;
+  _lfs_wasm_ctx_create(): number;
+  _lfs_wasm_ctx_destroy(ctx: number): void;
+  _lfs_wasm_init(ctx: number, blockSize: number, blockCount: number, lookahead: number): number;
+  _lfs_wasm_init_from_image(ctx: number, imagePtr: number, imageSize: number, blockSize: number, blockCount: number, lookahead: number): number;
+  _lfs_wasm_init_adopt(ctx: number, imagePtr: number, imageSize: number, blockSize: number, blockCount: number, lookahead: number): number;
+  _lfs_wasm_init_borrow(ctx: number, imagePtr: number, imageSize: number, blockSize: number, blockCount: number, lookahead: number): number;
+  _lfs_wasm_init_sparse(ctx: number, blockSize: number, blockCount: number, lookahead: number): number;
+  _lfs_wasm_init_external(ctx: number, blockSize: number, blockCount: number, lookahead: number, cacheBlocks: number): number;
+  _lfs_wasm_set_disk_version(ctx: number, version: number): void;
+  _lfs_wasm_get_disk_version(ctx: number): number;
+  _lfs_wasm_set_read_only(ctx: number, readOnly: number): void;
+  _lfs_wasm_set_tuning(
+    ctx: number,
+    readSize: number,
+    progSize: number,
+    cacheSize: number,
+    blockCycles: number,
+    compactThresh: number,
+    metadataMax: number,
+    inlineMax: number,
+    nameMax: number
+  ): void;
+  _lfs_wasm_get_fs_info(ctx: number, versionPtr: number): number;
+  _lfs_wasm_mount(ctx: number): number;
+  _lfs_wasm_unmount(ctx: number): number;
+  _lfs_wasm_format(ctx: number): number;
+  _lfs_wasm_mkdir(ctx: number, pathPtr: number): number;
+  _lfs_wasm_remove(ctx: number, pathPtr: number): number;
+  _lfs_wasm_rename(ctx: number, oldPtr: number, newPtr: number): number;
+  _lfs_wasm_remove_tree(ctx: number, pathPtr: number): number;
+  _lfs_wasm_copy_tree(ctx: number, fromPtr: number, toPtr: number, typesPtr: number, typeCount: number): number;
+  _lfs_wasm_move_tree(ctx: number, fromPtr: number, toPtr: number): number;
+  _lfs_wasm_stat(ctx: number, pathPtr: number, typePtr: number, sizePtr: number): number;
+  _lfs_wasm_dir_open(ctx: number, pathPtr: number): number;
+  _lfs_wasm_dir_read(ctx: number, handle: number, namePtr: number, nameLen: number, typePtr: number, sizePtr: number): number;
+  _lfs_wasm_dir_close(ctx: number, handle: number): number;
+  _lfs_wasm_list_tree(ctx: number, pathPtr: number, recursive: number): number;
+  _lfs_wasm_list_tree_attrs(ctx: number, pathPtr: number, recursive: number, typesPtr: number, typeCount: number): number;
+  _lfs_wasm_list_buffer(ctx: number): number;
+  _lfs_wasm_check(ctx: number, summaryPtr: number): number;
+  _lfs_wasm_file_open(ctx: number, pathPtr: number, flags: number): number;
+  _lfs_wasm_file_read(ctx: number, handle: number, outPtr: number, size: number): number;
+  _lfs_wasm_file_write(ctx: number, handle: number, dataPtr: number, size: number): number;
+  _lfs_wasm_file_seek(ctx: number, handle: number, offset: number, whence: number): number;
+  _lfs_wasm_file_tell(ctx: number, handle: number): number;
+  _lfs_wasm_file_length(ctx: number, handle: number): number;
+  _lfs_wasm_file_truncate(ctx: number, handle: number, size: number): number;
+  _lfs_wasm_file_sync(ctx: number, handle: number): number;
+  _lfs_wasm_file_close(ctx: number, handle: number): number;
+  _lfs_wasm_write_file(ctx: number, pathPtr: number, dataPtr: number, size: number): number;
+  _lfs_wasm_write_file_attrs(ctx: number, pathPtr: number, dataPtr: number, size: number, attrsPtr: number, attrsLen: number): number;
+  _lfs_wasm_getattr(ctx: number, pathPtr: number, type: number, outPtr: number, size: number): number;
+  _lfs_wasm_setattr(ctx: number, pathPtr: number, type: number, dataPtr: number, size: number): number;
+  _lfs_wasm_removeattr(ctx: number, pathPtr: number, type: number): number;
+  _lfs_wasm_write_files(ctx: number, bufPtr: number, manifestLen: number, count: number): number;
+  _lfs_wasm_batch_progress(ctx: number): number;
+  _lfs_wasm_read_file(ctx: number, pathPtr: number, outPtr: number, maxSize: number): number;
+  _lfs_wasm_file_size(ctx: number, pathPtr: number): number;
+  _lfs_wasm_read_file_alloc(ctx: number, pathPtr: number): number;
+  _lfs_wasm_read_result(ctx: number): number;
+  _lfs_wasm_read_files(ctx: number, pathsPtr: number, count: number, threads: number, outPtr: number): number;
+  _lfs_wasm_set_dir_cache(ctx: number, enabled: number): void;
+  _lfs_wasm_get_image(ctx: number): number;
+  _lfs_wasm_get_image_size(ctx: number): number;
+  _lfs_wasm_get_block_size(ctx: number): number;
+  _lfs_wasm_get_backend(ctx: number): number;
+  _lfs_wasm_get_storage_bytes(ctx: number): number;
+  _lfs_wasm_block_data(ctx: number, block: number): number;
+  _lfs_wasm_block_alloc(ctx: number, block: number): number;
+  _lfs_wasm_get_dirty_map(ctx: number): number;
+  _lfs_wasm_clear_dirty(ctx: number): void;
+  _lfs_wasm_io_enable(ctx: number, traceCap: number): number;
+  _lfs_wasm_io_disable(ctx: number): void;
+  _lfs_wasm_io_reset(ctx: number): void;
+  _lfs_wasm_io_stats(ctx: number): number;
+  _lfs_wasm_io_erase_counts(ctx: number): number;
+  _lfs_wasm_io_trace(ctx: number): number;
+  _lfs_wasm_io_trace_total(ctx: number): number;
+  _lfs_wasm_io_trace_capacity(ctx: number): number;
+  _lfs_wasm_fault_enable(ctx: number): number;
+  _lfs_wasm_fault_disable(ctx: number): void;
+  _lfs_wasm_fault_arm(ctx: number, after: number, mode: number): number;
+  _lfs_wasm_fault_wear(ctx: number, eraseCycles: number, behavior: number): number;
+  _lfs_wasm_fault_bad_block(ctx: number, block: number, bad: number): number;
+  _lfs_wasm_fault_state(ctx: number, opsPtr: number): number;
+  _lfs_wasm_power_cycle(ctx: number): number;
+  _lfs_wasm_optimize(ctx: number, compactThresh: number): number;
+  _lfs_wasm_repack(dst: number, src: number, typesPtr: number, typeCount: number): number;
+  _lfs_wasm_resize(ctx: number, blockCount: number): number;
+  _lfs_wasm_diff(a: number, b: number, typesPtr: number, typeCount: number): number;
+  _lfs_wasm_snapshot(ctx: number): number;
+  _lfs_wasm_restore(ctx: number, id: number): number;
+  _lfs_wasm_snapshot_release(ctx: number, id: number): number;
+  _lfs_wasm_snapshot_blocks(ctx: number, id: number): number;
+  _lfs_wasm_apply(
+    dst: number,
+    src: number,
+    changesPtr: number,
+    length: number,
+    typesPtr: number,
+    typeCount: number
+  ): number;
+  _lfs_wasm_fs_stat(ctx: number, usedPtr: number, totalPtr: number): number;
+  _lfs_wasm_cleanup(ctx: number): void;
   _malloc(size: number): number;
   _free(ptr: number): void;
   HEAPU8: Uint8Array;
   HEAPU32: Uint32Array;
   HEAP32: Int32Array;
+  // Called from C for contexts set up with _lfs_wasm_init_external
+  lfsBlockDevice?: (ctx: number, op: number, block: number, offset: number, ptr: number, size: number) => number;
 }
 
 // ============================================================================
 // WASM Loading
 // ============================================================================
 
+// The module is shared by every filesystem in this realm; each LittleFS
+// instance owns its own context inside the module's linear memory.
 let modulePromise: Promise<LittleFSModule> | null = null;
+// Glue import and compilation, started before the module is instantiated
+// so both overlap with fetching an image
+let compilePromise: Promise<CompiledVariant> | null = null;
+// Linear memory of the threads build, which JS creates so it can tell when
+// a pthread has grown it
+let sharedMemory: WebAssembly.Memory | null = null;
+// Build the realm compiled first; every later load gets the same one
+let loadedVariant: LittleFSVariant | null = null;
 
-async function loadModule(wasmURL?: string | URL): Promise<LittleFSModule> {
-  if (modulePromise) return modulePromise;
+type ModuleFactory = (config?: {
+  noInitialRun?: boolean;
+  INITIAL_MEMORY?: number;
+  wasmMemory?: WebAssembly.Memory;
+  instantiateWasm?: (
+    imports: WebAssembly.Imports,
+    receive: (instance: WebAssembly.Instance, module: WebAssembly.Module) => void
+  ) => object;
+}) => Promise<LittleFSModule>;
 
-  const url = wasmURL || new URL('./littlefs.wasm', import.meta.url);
-  
-  modulePromise = (async () => {
-    const response = await fetch(url);
-    const wasmBinary = await response.arrayBuffer();
-    
-    // Emscripten module factory - dynamically loaded at runtime
-    // eslint-disable-next-line @typescript-eslint/no-explicit-any
-    const createModule = (await import(/* webpackIgnore: true */ './littlefs.js' as any)).default as (
-      config?: { wasmBinary?: ArrayBuffer; noInitialRun?: boolean }
-    ) => Promise<LittleFSModule>;
-    
-    return createModule({
-      wasmBinary,
-      noInitialRun: true,
-    });
-  })();
+// Smallest module using a v128 instruction (i8x16.popcnt on a v128.const)
+const SIMD_PROBE = new Uint8Array([
+  0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253,
+  98, 11,
+]);
 
-  return modulePromise;
+function supportsSimd(): boolean {
+  try {
+    return WebAssembly.validate(SIMD_PROBE);
+  } catch {
+    return false;
+  }
 }
 
-// ============================================================================
-// Helper Functions
-// ============================================================================
+type LoadOptions = Pick<LittleFSOptions, 'wasmURL' | 'simd' | 'variant' | 'wasmModule' | 'wasmCache' | 'threads'>;
+
+const VARIANT_SIMD: Record<LittleFSVariant, boolean> = {
+  baseline: false,
+  simd: true,
+  fast: true,
+  readonly: false,
+  threads: true,
+};
 
-function allocString(module: LittleFSModule, str: string): number {
-  const encoder = new TextEncoder();
-  const bytes = encoder.encode(str + '\0');
-  const ptr = module._malloc(bytes.length);
-  module.HEAPU8.set(bytes, ptr);
-  return ptr;
+/**
+ * Pick the build variant
+ */
+function resolveVariant(options: LoadOptions): LittleFSVariant {
+  if (options.threads && !options.wasmURL) return 'threads';
+  if (options.variant) return options.variant;
+  // Custom binaries default to the baseline glue; pass the variant they
+  // were built as
+  if (options.wasmURL) return 'baseline';
+  if (options.simd !== undefined || options.wasmModule) return options.simd ? 'simd' : 'baseline';
+  return supportsSimd() ? 'fast' : 'baseline';
 }
 
-function allocBuffer(module: LittleFSModule, data: Uint8Array): number {
-  const ptr = module._malloc(data.length);
-  module.HEAPU8.set(data, ptr);
-  return ptr;
+/**
+ * URL of a variant's .wasm file
+ */
+function variantURL(variant: LittleFSVariant): URL {
+  switch (variant) {
+    case 'simd':
+      return new URL('./littlefs-simd.wasm', import.meta.url);
+    case 'fast':
+      return new URL('./littlefs-fast.wasm', import.meta.url);
+    case 'readonly':
+      return new URL('./littlefs-readonly.wasm', import.meta.url);
+    case 'threads':
+      return new URL('./littlefs-threads.wasm', import.meta.url);
+    default:
+      return new URL('./littlefs.wasm', import.meta.url);
+  }
 }
 
-// ============================================================================
-// LittleFS Implementation
-// ============================================================================
+/**
+ * Import a variant's Emscripten glue. Literal paths, so bundlers that
+ * honour webpackIgnore leave each one alone.
+ */
+async function importGlue(variant: LittleFSVariant): Promise<ModuleFactory> {
+  // eslint-disable-next-line @typescript-eslint/no-explicit-any
+  let glue: any;
+  switch (variant) {
+    case 'simd':
+      glue = await import(/* webpackIgnore: true */ './littlefs-simd.js' as any);
+      break;
+    case 'fast':
+      glue = await import(/* webpackIgnore: true */ './littlefs-fast.js' as any);
+      break;
+    case 'readonly':
+      glue = await import(/* webpackIgnore: true */ './littlefs-readonly.js' as any);
+      break;
+    case 'threads':
+      glue = await import(/* webpackIgnore: true */ './littlefs-threads.js' as any);
+      break;
+    default:
+      glue = await import(/* webpackIgnore: true */ './littlefs.js' as any);
+  }
+  return glue.default as ModuleFactory;
+}
 
-class LittleFSImpl implements LittleFS {
-  constructor(private module: LittleFSModule) {}
+// INITIAL_MEMORY and MAXIMUM_MEMORY in scripts/build-wasm.mjs
+const BUILD_INITIAL_MEMORY = 4 * 1024 * 1024;
+const MAXIMUM_MEMORY = 64 * 1024 * 1024;
+// Stack, littlefs caches and scratch buffers on top of the image
+const MEMORY_HEADROOM = 1024 * 1024;
+const WASM_PAGE_SIZE = 65536;
 
-  format(): void {
-    checkError(this.module._lfs_wasm_format(), 'format');
-    checkError(this.module._lfs_wasm_mount(), 'mount after format');
-  }
+/**
+ * Initial linear memory for an image of `imageSize` bytes, so loading it
+ * doesn't grow (and copy) the heap step by step. Undefined keeps the
+ * build default.
+ */
+function initialMemory(imageSize: number): number | undefined {
+  const bytes = Math.ceil((imageSize + MEMORY_HEADROOM) / WASM_PAGE_SIZE) * WASM_PAGE_SIZE;
+  return bytes > BUILD_INITIAL_MEMORY ? Math.min(bytes, MAXIMUM_MEMORY) : undefined;
+}
 
-  list(basePath: string = '/'): LittleFSEntry[] {
-    const entries: LittleFSEntry[] = [];
-    this.listRecursive(basePath, entries);
-    return entries;
-  }
+// "version" in package.json; a .wasm cached by another release is never used
+const PACKAGE_VERSION = '1.0.0';
+const WASM_CACHE_PREFIX = 'littlefs-wasm';
+const WASM_CACHE_PARAM = 'littlefs-wasm';
 
-  private listRecursive(dirPath: string, entries: LittleFSEntry[]): void {
-    const pathPtr = allocString(this.module, dirPath);
-    const namePtr = this.module._malloc(256);
-    const typePtr = this.module._malloc(4);
-    const sizePtr = this.module._malloc(4);
+/**
+ * Cache API name for the `wasmCache` option
+ */
+function wasmCacheName(option: LittleFSOptions['wasmCache']): string | undefined {
+  return option === true ? `${WASM_CACHE_PREFIX}-${PACKAGE_VERSION}` : option || undefined;
+}
 
-    try {
-      const handle = this.module._lfs_wasm_dir_open(pathPtr);
-      if (handle < 0) {
-        checkError(handle, `open directory '${dirPath}'`);
-      }
+/**
+ * Cache key for a .wasm URL: the URL tagged with the release, so a
+ * user-named cache kept across upgrades misses instead of serving an old
+ * build to new glue
+ */
+function wasmCacheKey(href: string): string {
+  // wasmURL may be relative to the page
+  const url = new URL(href, typeof location !== 'undefined' ? location.href : undefined);
+  url.searchParams.set(WASM_CACHE_PARAM, PACKAGE_VERSION);
+  return url.href;
+}
 
-      try {
-        while (true) {
-          const res = this.module._lfs_wasm_dir_read(handle, namePtr, 256, typePtr, sizePtr);
-          if (res <= 0) break;
-
-          const nameBytes: number[] = [];
-          for (let i = 0; i < 256; i++) {
-            const byte = this.module.HEAPU8[namePtr + i];
-            if (byte === 0) break;
-            nameBytes.push(byte);
-          }
-          const name = new TextDecoder().decode(new Uint8Array(nameBytes));
-          const type = this.module.HEAP32[typePtr >> 2];
-          const size = this.module.HEAPU32[sizePtr >> 2];
-
-          const fullPath = dirPath === '/' ? `/${name}` : `${dirPath}/${name}`;
-          
-          if (type === 2) {
-            // Directory - recurse
-            entries.push({ path: fullPath, size: 0, type: 'dir' });
-            this.listRecursive(fullPath, entries);
-          } else {
-            entries.push({ path: fullPath, size, type: 'file' });
-          }
-        }
-      } finally {
-        this.module._lfs_wasm_dir_close(handle);
-      }
-    } finally {
-      this.module._free(pathPtr);
-      this.module._free(namePtr);
-      this.module._free(typePtr);
-      this.module._free(sizePtr);
+/**
+ * Delete what older releases left: their default caches (including the
+ * unversioned `littlefs-wasm`) and their entries for `href` in `cache`
+ */
+async function pruneWasmCaches(cache: Cache, cacheName: string, href: string): Promise<void> {
+  for (const name of await caches.keys()) {
+    if (name !== cacheName && (name === WASM_CACHE_PREFIX || name.startsWith(WASM_CACHE_PREFIX + '-'))) {
+      await caches.delete(name);
     }
   }
+  const current = new URL(wasmCacheKey(href));
+  current.searchParams.delete(WASM_CACHE_PARAM);
+  for (const request of await cache.keys()) {
+    const url = new URL(request.url);
+    if (url.searchParams.get(WASM_CACHE_PARAM) === PACKAGE_VERSION) continue;
+    url.searchParams.delete(WASM_CACHE_PARAM);
+    if (url.href === current.href) await cache.delete(request);
+  }
+}
+
+/**
+ * Fetch through the Cache API: a hit skips the network, a miss is stored
+ * while the caller consumes it and clears out older releases' entries.
+ */
+async function cachedFetch(href: string, cacheName: string): Promise<Response> {
+  let cache: Cache | null = null;
+  try {
+    if (typeof caches !== 'undefined') cache = await caches.open(cacheName);
+  } catch {
+    // Opaque origins and some private modes refuse storage
+  }
+  const key = wasmCacheKey(href);
+  const hit = cache && (await cache.match(key));
+  if (hit) return hit;
+  const response = await fetch(href);
+  if (cache && response.ok) {
+    cache.put(key, response.clone()).catch(() => {});
+    pruneWasmCaches(cache, cacheName, href).catch(() => {});
+  }
+  return response;
+}
+
+/**
+ * Compile a .wasm file. Served as application/wasm it is compiled while
+ * it downloads. Node's fetch() has no file: support, so module URLs that
+ * resolve to the local filesystem are read with node:fs.
+ */
+async function compileWasm(url: string | URL, cacheName?: string): Promise<WebAssembly.Module> {
+  const href = String(url);
+  if (href.startsWith('file:')) {
+    // eslint-disable-next-line @typescript-eslint/no-explicit-any
+    const { readFile } = await import(/* webpackIgnore: true */ 'node:fs/promises' as any);
+    return WebAssembly.compile(await readFile(new URL(href)));
+  }
+
+  const response = cacheName ? await cachedFetch(href, cacheName) : await fetch(href);
+  if (!response.ok) {
+    throw new LittleFSError(`load: ${href}: HTTP ${response.status}`, LFS_ERR_IO);
+  }
+  // compileStreaming rejects any other MIME type
+  const type = response.headers.get('Content-Type') ?? '';
+  if (typeof WebAssembly.compileStreaming === 'function' && type.startsWith('application/wasm')) {
+    return WebAssembly.compileStreaming(response);
+  }
+  return WebAssembly.compile(await response.arrayBuffer());
+}
+
+/**
+ * Fetch and compile the WASM module without instantiating it. The result
+ * can be posted to workers and passed as `wasmModule` + `variant`, so N
+ * workers share one download and one compilation. With `threads` the
+ * variant is `threads`, whose glue the module needs.
+ */
+export async function compileLittleFSModule(
+  options: Pick<LittleFSOptions, 'wasmURL' | 'simd' | 'variant' | 'wasmCache' | 'threads'> = {}
+): Promise<{ module: WebAssembly.Module; simd: boolean; variant: LittleFSVariant }> {
+  const variant = resolveVariant(options);
+  const module = await compileWasm(options.wasmURL || variantURL(variant), wasmCacheName(options.wasmCache));
+  return { module, simd: VARIANT_SIMD[variant], variant };
+}
+
+interface CompiledVariant {
+  createModule: ModuleFactory;
+  module: WebAssembly.Module;
+  threads: boolean;
+}
+
+/**
+ * Error for options that ask for another build than the one the realm
+ * already loaded. Options naming no build accept whichever it is.
+ */
+function variantMismatch(options: LoadOptions): LittleFSError | null {
+  if (!loadedVariant) return null;
+  if (options.variant === undefined && options.simd === undefined && options.threads === undefined) return null;
+  const variant = resolveVariant(options);
+  if (variant === loadedVariant) return null;
+  return new LittleFSError(
+    `load: the ${loadedVariant} build is already loaded in this realm and ${variant} was requested`,
+    LFS_ERR_INVAL
+  );
+}
+
+/**
+ * Import the glue and compile the module once per realm
+ */
+function compileShared(options: LoadOptions): Promise<CompiledVariant> {
+  const mismatch = variantMismatch(options);
+  if (mismatch) return Promise.reject(mismatch);
+  if (!compilePromise) {
+    const variant = resolveVariant(options);
+    loadedVariant = variant;
+    compilePromise = Promise.all([
+      importGlue(variant),
+      options.wasmModule ?? compileWasm(options.wasmURL || variantURL(variant), wasmCacheName(options.wasmCache)),
+    ]).then(([createModule, module]) => ({ createModule, module, threads: variant === 'threads' }));
+  }
+  return compilePromise;
+}
+
+/**
+ * Load and instantiate the shared WASM module ahead of the first filesystem.
+ * Without awaiting it, the download and compilation overlap whatever the
+ * page does next, e.g. fetching the image to mount.
+ */
+export async function preloadLittleFS(options: LoadOptions = {}): Promise<void> {
+  await loadModule(options);
+}
+
+/**
+ * Instantiate the shared module, sized for an image of `imageSize` bytes
+ * if this is the first load in the realm
+ */
+async function loadModule(options: LoadOptions = {}, imageSize = 0): Promise<LittleFSModule> {
+  if (modulePromise) {
+    const mismatch = variantMismatch(options);
+    if (mismatch) throw mismatch;
+    return modulePromise;
+  }
+
+  modulePromise = compileShared(options).then(
+    ({ createModule, module, threads }) =>
+      new Promise<LittleFSModule>((resolve, reject) => {
+        const initial = initialMemory(imageSize);
+        if (threads) {
+          sharedMemory = new WebAssembly.Memory({
+            initial: (initial ?? BUILD_INITIAL_MEMORY) / WASM_PAGE_SIZE,
+            maximum: MAXIMUM_MEMORY / WASM_PAGE_SIZE,
+            shared: true,
+          });
+        }
+        createModule({
+          noInitialRun: true,
+          INITIAL_MEMORY: initial,
+          wasmMemory: sharedMemory ?? undefined,
+          instantiateWasm(imports, receive) {
+            // The factory waits on receive() forever if this fails
+            WebAssembly.instantiate(module, imports).then((instance) => receive(instance, module), reject);
+            return {};
+          },
+        }).then(resolve, reject);
+      })
+  );
+
+  return modulePromise;
+}
+
+/**
+ * Rebuild the heap views after a pthread grew memory. Emscripten refreshes
+ * `HEAPU8` and friends only when memory grows on this thread, so after
+ * growth on another one they still cover the old, shorter buffer.
+ */
+function refreshHeapViews(module: LittleFSModule): void {
+  if (!sharedMemory || module.HEAPU8.buffer === sharedMemory.buffer) return;
+  const buffer = sharedMemory.buffer;
+  module.HEAPU8 = new Uint8Array(buffer);
+  module.HEAPU32 = new Uint32Array(buffer);
+  module.HEAP32 = new Int32Array(buffer);
+}
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+// Size of the fixed part of a packed lfs_wasm_list_tree entry
+const LIST_ENTRY_HEADER = 7;
+
+// Packed custom attribute: u8 type, u16 size, value
+const ATTR_RECORD_HEADER = 3;
+
+// LFS_ATTR_MAX of the build
+const ATTR_MAX = 1022;
+
+// Size of the fixed part of a packed lfs_wasm_check record
+const CHECK_RECORD_HEADER = 15;
+
+// lfs_wasm_check_summary_t: i32 traverse error, then four u32 counts
+const CHECK_SUMMARY_SIZE = 20;
+
+// Change set ops, indexed by the op byte of lfs_wasm_diff
+const CHANGE_OPS = [undefined, 'added', 'removed', 'modified'] as const;
+
+// Size of the fixed part of a packed lfs_wasm_write_files manifest entry
+const BATCH_ENTRY_HEADER = 8;
+
+// Upper bound on the heap buffer used per lfs_wasm_write_files call
+const BATCH_MAX_BYTES = 4 * 1024 * 1024;
+
+// Threads per lfs_wasm_read_files batch: the calling thread plus the
+// threads build's PTHREAD_POOL_SIZE
+const MAX_READ_THREADS = 8;
+
+/**
+ * Run lfs_wasm_check on a mounted context and decode its records
+ */
+function runCheck(module: LittleFSModule, ctx: number): LittleFSCheckReport {
+  const summaryPtr = module._malloc(CHECK_SUMMARY_SIZE);
+  if (!summaryPtr) checkError(LFS_ERR_NOMEM, 'check');
+  try {
+    const length = module._lfs_wasm_check(ctx, summaryPtr);
+    checkError(length, 'check');
+
+    const ptr = module._lfs_wasm_list_buffer(ctx);
+    const heap = module.HEAPU8;
+    const view = new DataView(heap.buffer, heap.byteOffset + ptr, length);
+    const entries: LittleFSCheckEntry[] = [];
+    const errors: LittleFSCheckReport['errors'] = [];
+    let offset = 0;
+    while (offset < length) {
+      const type = view.getUint8(offset);
+      const error = view.getInt32(offset + 1, true);
+      const size = view.getUint32(offset + 5, true);
+      const count = view.getUint32(offset + 9, true);
+      const pathLength = view.getUint16(offset + 13, true);
+      const start = ptr + offset + CHECK_RECORD_HEADER;
+      const path = utf8Decoder.decode(heap.subarray(start, start + pathLength));
+      offset += CHECK_RECORD_HEADER + pathLength;
+
+      const blocks = new Array<number>(count);
+      for (let i = 0; i < count; i++, offset += 4) {
+        blocks[i] = view.getUint32(offset, true);
+      }
+      entries.push({ path, type: type === 2 ? 'dir' : 'file', size, blocks, error });
+      if (error) errors.push({ path, code: error, message: errorMessage(error) });
+    }
+
+    const summary = new DataView(heap.buffer, heap.byteOffset + summaryPtr, CHECK_SUMMARY_SIZE);
+    const report: LittleFSCheckReport = {
+      ok: false,
+      entries,
+      errors,
+      traverseError: summary.getInt32(0, true),
+      usedBlocks: summary.getUint32(4, true),
+      outOfRangeBlocks: summary.getUint32(8, true),
+      sharedBlocks: summary.getUint32(12, true),
+      unreferencedBlocks: summary.getUint32(16, true),
+    };
+    report.ok =
+      errors.length === 0 && report.traverseError === 0 && report.outOfRangeBlocks === 0 && report.sharedBlocks === 0;
+    return report;
+  } finally {
+    module._free(summaryPtr);
+  }
+}
+
+// lfs_wasm_get_backend results
+const BACKEND_RAM = 0;
+const BACKEND_EXTERNAL = 2;
+
+// Trace record ops, see lfs_wasm_io_trace
+const IO_OP_READ = 0;
+const IO_OP_PROG = 1;
+const IO_OP_ERASE = 2;
+
+const utf8Encoder = new TextEncoder();
+const utf8Decoder = new TextDecoder();
+
+/**
+ * Pack attributes as the C side reads them: u8 type, u16 size, value
+ */
+function packAttrs(attrs: Record<number, FileSource> | undefined): Uint8Array {
+  if (!attrs) return new Uint8Array(0);
+  const records: Array<[number, Uint8Array]> = [];
+  let length = 0;
+  for (const [key, value] of Object.entries(attrs)) {
+    const type = Number(key);
+    if (!Number.isInteger(type) || type < 0 || type > 255) {
+      throw new LittleFSError(`attribute: Type ${key} is not in 0-255`, LFS_ERR_INVAL);
+    }
+    const data = toUint8Array(value);
+    records.push([type, data]);
+    length += ATTR_RECORD_HEADER + data.length;
+  }
+
+  const out = new Uint8Array(length);
+  let offset = 0;
+  for (const [type, data] of records) {
+    out[offset] = type;
+    out[offset + 1] = data.length & 0xff;
+    out[offset + 2] = data.length >> 8;
+    out.set(data, offset + ATTR_RECORD_HEADER);
+    offset += ATTR_RECORD_HEADER + data.length;
+  }
+  return out;
+}
+
+// Per-instance scratch for paths, small payloads and out-params
+const SCRATCH_SIZE = 16 * 1024;
+
+/**
+ * Bump allocator for call arguments, set up once in WASM memory. Every
+ * method starts with `reset()`, so nothing is freed per call; requests
+ * that don't fit get their own malloc, released on the next reset.
+ * Pointers are only valid until the next `reset()`, so a method must be
+ * done with them before calling another one.
+ */
+class ScratchArena {
+  private base = 0;
+  private offset = 0;
+  private overflow: number[] = [];
+
+  constructor(private module: LittleFSModule) {}
+
+  /** Start a call, dropping everything handed out by the previous one. */
+  reset(): this {
+    this.offset = 0;
+    if (this.overflow.length) {
+      for (const ptr of this.overflow) this.module._free(ptr);
+      this.overflow.length = 0;
+    }
+    return this;
+  }
+
+  alloc(size: number): number {
+    if (!this.base) {
+      this.base = this.module._malloc(SCRATCH_SIZE);
+      if (!this.base) checkError(LFS_ERR_NOMEM, 'allocate scratch');
+    }
+    const start = (this.offset + 7) & ~7;
+    if (start + size <= SCRATCH_SIZE) {
+      this.offset = start + size;
+      return this.base + start;
+    }
+    const ptr = this.module._malloc(size);
+    if (!ptr) checkError(LFS_ERR_NOMEM, 'allocate scratch');
+    this.overflow.push(ptr);
+    return ptr;
+  }
+
+  /** NUL-terminated UTF-8, encoded straight into WASM memory. */
+  string(str: string): number {
+    // encodeInto writes at most 3 bytes per UTF-16 code unit
+    const max = str.length * 3 + 1;
+    const ptr = this.alloc(max);
+    const { written } = utf8Encoder.encodeInto(str, this.module.HEAPU8.subarray(ptr, ptr + max - 1));
+    this.module.HEAPU8[ptr + written] = 0;
+    // Hand back the unused tail if it came from the arena
+    if (ptr - this.base + max === this.offset) this.offset -= max - written - 1;
+    return ptr;
+  }
+
+  bytes(data: Uint8Array): number {
+    const ptr = this.alloc(data.length);
+    this.module.HEAPU8.set(data, ptr);
+    return ptr;
+  }
+
+  /** One u32 out-param slot; read it back through `HEAPU32[ptr >> 2]`. */
+  u32(): number {
+    return this.alloc(4);
+  }
+
+  destroy(): void {
+    this.reset();
+    this.module._free(this.base);
+    this.base = 0;
+  }
+}
+
+// ============================================================================
+// File Handles
+// ============================================================================
+
+// LittleFS open flags (lfs_open_flags in lfs.h)
+const LFS_O_RDONLY = 0x0001;
+const LFS_O_WRONLY = 0x0002;
+const LFS_O_RDWR = 0x0003;
+const LFS_O_CREAT = 0x0100;
+const LFS_O_TRUNC = 0x0400;
+const LFS_O_APPEND = 0x0800;
+
+const OPEN_FLAGS: Record<LittleFSOpenMode, number> = {
+  'r': LFS_O_RDONLY,
+  'r+': LFS_O_RDWR,
+  'w': LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC,
+  'w+': LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC,
+  'a': LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND,
+  'a+': LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND,
+};
+
+// LittleFS seek origins (lfs_whence_flags in lfs.h)
+const SEEK_WHENCE: Record<LittleFSSeekWhence, number> = {
+  set: 0,
+  cur: 1,
+  end: 2,
+};
+
+const DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+class LittleFSFileHandleImpl implements LittleFSFileHandle {
+  private stagingPtr: number;
+  private closed = false;
+
+  constructor(
+    private module: LittleFSModule,
+    private ctx: number,
+    private handle: number,
+    readonly path: string,
+    private stagingSize: number,
+    private onClose: (file: LittleFSFileHandleImpl) => void
+  ) {
+    this.stagingPtr = module._malloc(stagingSize);
+    if (!this.stagingPtr) {
+      module._lfs_wasm_file_close(ctx, handle);
+      checkError(LFS_ERR_NOMEM, `open file '${path}'`);
+    }
+  }
+
+  private ensureOpen(): void {
+    if (this.closed) {
+      checkError(LFS_ERR_BADF, `file '${this.path}'`);
+    }
+  }
+
+  read(buffer: Uint8Array): number {
+    this.ensureOpen();
+    let total = 0;
+    while (total < buffer.length) {
+      const want = Math.min(this.stagingSize, buffer.length - total);
+      const n = this.module._lfs_wasm_file_read(this.ctx, this.handle, this.stagingPtr, want);
+      checkError(n, `read file '${this.path}'`);
+      if (n === 0) break;
+      buffer.set(this.module.HEAPU8.subarray(this.stagingPtr, this.stagingPtr + n), total);
+      total += n;
+      if (n < want) break;
+    }
+    return total;
+  }
+
+  write(data: FileSource): number {
+    this.ensureOpen();
+    const bytes = toUint8Array(data);
+    let total = 0;
+    while (total < bytes.length) {
+      const chunk = bytes.subarray(total, total + this.stagingSize);
+      this.module.HEAPU8.set(chunk, this.stagingPtr);
+      const n = this.module._lfs_wasm_file_write(this.ctx, this.handle, this.stagingPtr, chunk.length);
+      checkError(n, `write file '${this.path}'`);
+      total += n;
+    }
+    return total;
+  }
+
+  seek(offset: number, whence: LittleFSSeekWhence = 'set'): number {
+    this.ensureOpen();
+    const pos = this.module._lfs_wasm_file_seek(this.ctx, this.handle, offset, SEEK_WHENCE[whence]);
+    checkError(pos, `seek file '${this.path}'`);
+    return pos;
+  }
+
+  tell(): number {
+    this.ensureOpen();
+    const pos = this.module._lfs_wasm_file_tell(this.ctx, this.handle);
+    checkError(pos, `tell file '${this.path}'`);
+    return pos;
+  }
+
+  size(): number {
+    this.ensureOpen();
+    const size = this.module._lfs_wasm_file_length(this.ctx, this.handle);
+    checkError(size, `stat file '${this.path}'`);
+    return size;
+  }
+
+  truncate(size: number): void {
+    this.ensureOpen();
+    checkError(
+      this.module._lfs_wasm_file_truncate(this.ctx, this.handle, size),
+      `truncate file '${this.path}'`
+    );
+  }
+
+  sync(): void {
+    this.ensureOpen();
+    checkError(this.module._lfs_wasm_file_sync(this.ctx, this.handle), `sync file '${this.path}'`);
+  }
+
+  close(): void {
+    if (this.closed) return;
+    this.closed = true;
+    this.onClose(this);
+    const err = this.module._lfs_wasm_file_close(this.ctx, this.handle);
+    this.module._free(this.stagingPtr);
+    checkError(err, `close file '${this.path}'`);
+  }
+
+  /**
+   * Release the JS side after the filesystem already closed the C handle
+   */
+  detach(): void {
+    if (this.closed) return;
+    this.closed = true;
+    this.module._free(this.stagingPtr);
+  }
+}
+
+// ============================================================================
+// Tuning
+// ============================================================================
+
+type Tuning = Required<
+  Pick<
+    LittleFSOptions,
+    | 'readSize'
+    | 'progSize'
+    | 'cacheSize'
+    | 'blockCycles'
+    | 'compactThreshold'
+    | 'metadataMax'
+    | 'inlineMax'
+    | 'nameMax'
+    | 'lookaheadSize'
+  >
+>;
+
+const DEFAULT_BLOCK_SIZE = 4096;
+const DEFAULT_BLOCK_COUNT = 256;
+const DEFAULT_LOOKAHEAD = 32;
+// Lookahead size telling the C side to use one bit per block
+const LOOKAHEAD_FULL = 0xffffffff;
+
+/**
+ * Preset values; 0 means "C default" (see lfs_wasm_set_tuning).
+ */
+function presetTuning(preset: LittleFSPreset): Tuning {
+  switch (preset) {
+    case 'host-fast':
+      return {
+        readSize: 256,
+        progSize: 64,
+        cacheSize: 0,
+        blockCycles: -1,
+        compactThreshold: 0,
+        metadataMax: 0,
+        inlineMax: 0,
+        nameMax: 0,
+        lookaheadSize: LOOKAHEAD_FULL,
+      };
+    case 'esp-idf':
+      return {
+        readSize: 128,
+        progSize: 128,
+        cacheSize: 512,
+        blockCycles: 512,
+        compactThreshold: 0,
+        metadataMax: 0,
+        inlineMax: 0,
+        nameMax: 64,
+        lookaheadSize: 128,
+      };
+    case 'low-memory':
+      return {
+        readSize: 16,
+        progSize: 16,
+        cacheSize: 256,
+        blockCycles: 0,
+        compactThreshold: 0,
+        metadataMax: 0,
+        inlineMax: 0,
+        nameMax: 0,
+        lookaheadSize: 16,
+      };
+    default:
+      return {
+        readSize: 0,
+        progSize: 0,
+        cacheSize: 0,
+        blockCycles: 0,
+        compactThreshold: 0,
+        metadataMax: 0,
+        inlineMax: 0,
+        nameMax: 0,
+        lookaheadSize: DEFAULT_LOOKAHEAD,
+      };
+  }
+}
+
+/**
+ * Merge preset and explicit options and hand them to the context.
+ * Must run before init; returns the lookahead size to pass to init.
+ */
+function applyTuning(module: LittleFSModule, ctx: number, options: LittleFSOptions): number {
+  const t = presetTuning(options.preset ?? 'default');
+  module._lfs_wasm_set_tuning(
+    ctx,
+    options.readSize ?? t.readSize,
+    options.progSize ?? t.progSize,
+    options.cacheSize ?? t.cacheSize,
+    options.blockCycles ?? t.blockCycles,
+    (options.compactThreshold ?? t.compactThreshold) >>> 0,
+    options.metadataMax ?? t.metadataMax,
+    (options.inlineMax ?? t.inlineMax) >>> 0,
+    options.nameMax ?? t.nameMax
+  );
+  module._lfs_wasm_set_dir_cache(ctx, options.dirCache === false ? 0 : 1);
+  module._lfs_wasm_set_read_only(ctx, options.readOnly ? 1 : 0);
+  if (options.fullLookahead) return LOOKAHEAD_FULL;
+  return options.lookaheadSize ?? t.lookaheadSize;
+}
+
+/**
+ * Turn on I/O counting if the options ask for it.
+ * Must run after init and before format/mount so those are counted too.
+ */
+function applyInstrumentation(module: LittleFSModule, ctx: number, options: LittleFSOptions): void {
+  if (options.ioStats || options.ioTraceSize) {
+    checkError(module._lfs_wasm_io_enable(ctx, options.ioTraceSize ?? 0), 'enable I/O stats');
+  }
+  if (options.faults) {
+    enableFaults(module, ctx, options.faults);
+  }
+}
+
+// Indexed by the C side's FAULT_CUT_* and FAULT_BAD_* values
+const POWER_LOSS_MODES = ['atomic', 'torn'] as const;
+const BAD_BLOCK_BEHAVIORS: LittleFSBadBlockBehavior[] = [
+  'prog-error',
+  'erase-error',
+  'read-error',
+  'prog-noop',
+  'erase-noop',
+];
+
+// lfs_wasm_fault_arm: never lose power
+const FAULT_NEVER = 0xffffffff;
+
+function powerLossMode(mode: 'atomic' | 'torn' | undefined): number {
+  const index = POWER_LOSS_MODES.indexOf(mode ?? 'atomic');
+  if (index < 0) checkError(LFS_ERR_INVAL, `power loss mode ${mode}`);
+  return index;
+}
+
+function enableFaults(module: LittleFSModule, ctx: number, options: LittleFSFaultOptions): void {
+  checkError(module._lfs_wasm_fault_enable(ctx), 'enable faults');
+  const behavior = BAD_BLOCK_BEHAVIORS.indexOf(options.badBlockBehavior ?? 'prog-error');
+  if (behavior < 0) checkError(LFS_ERR_INVAL, `bad block behavior ${options.badBlockBehavior}`);
+  checkError(module._lfs_wasm_fault_wear(ctx, options.eraseCycles ?? 0, behavior), 'set wear');
+  for (const block of options.badBlocks ?? []) {
+    checkError(module._lfs_wasm_fault_bad_block(ctx, block, 1), `mark block ${block} bad`);
+  }
+  const after = options.powerLossAfter ?? FAULT_NEVER;
+  checkError(module._lfs_wasm_fault_arm(ctx, after, powerLossMode(options.powerLossMode)), 'schedule power loss');
+}
+
+// ============================================================================
+// Block Devices
+// ============================================================================
+
+// Operations passed to Module.lfsBlockDevice (EXT_OP_* in littlefs_wasm.c)
+const DEVICE_OP_READ = 0;
+const DEVICE_OP_PROG = 1;
+const DEVICE_OP_ERASE = 2;
+const DEVICE_OP_SYNC = 3;
+
+const DEFAULT_CACHE_BLOCKS = 16;
+
+// JS block devices by context pointer; the module is shared per realm
+const blockDevices = new Map<number, LittleFSBlockDevice>();
+
+function registerBlockDevice(module: LittleFSModule, ctx: number, device: LittleFSBlockDevice): void {
+  blockDevices.set(ctx, device);
+  if (module.lfsBlockDevice) return;
+
+  module.lfsBlockDevice = (devCtx, op, block, offset, ptr, size) => {
+    const dev = blockDevices.get(devCtx);
+    if (!dev) return LFS_ERR_IO;
+    try {
+      // Fresh view each call: the device may be the one growing memory
+      const view = () => module.HEAPU8.subarray(ptr >>> 0, (ptr >>> 0) + size);
+      switch (op) {
+        case DEVICE_OP_READ:
+          dev.read(block, offset, view());
+          break;
+        case DEVICE_OP_PROG:
+          dev.prog(block, offset, view());
+          break;
+        case DEVICE_OP_ERASE:
+          dev.erase(block);
+          break;
+        case DEVICE_OP_SYNC:
+          dev.sync?.();
+          break;
+        default:
+          return LFS_ERR_INVAL;
+      }
+      return 0;
+    } catch (error) {
+      return error instanceof LittleFSError ? error.code : LFS_ERR_IO;
+    }
+  };
+}
+
+/**
+ * Split ascending block indices into runs of adjacent blocks
+ * @returns [first, count] per run
+ */
+function blockRuns(blocks: number[]): Array<[number, number]> {
+  const runs: Array<[number, number]> = [];
+  let i = 0;
+  while (i < blocks.length) {
+    let j = i + 1;
+    while (j < blocks.length && blocks[j] === blocks[j - 1] + 1) j++;
+    runs.push([blocks[i], j - i]);
+    i = j;
+  }
+  return runs;
+}
+
+// Android sparse image format (system/core/libsparse/sparse_format.h)
+const SPARSE_MAGIC = 0xed26ff3a;
+const SPARSE_FILE_HEADER = 28;
+const SPARSE_CHUNK_HEADER = 12;
+const SPARSE_CHUNK_RAW = 0xcac1;
+const SPARSE_CHUNK_FILL = 0xcac2;
+
+/**
+ * Write a sparse chunk header (type, reserved, blocks, bytes including the
+ * header) at the start of `out`
+ */
+function sparseChunkHeader(out: Uint8Array, type: number, blocks: number, totalSize: number): void {
+  const view = new DataView(out.buffer, out.byteOffset, SPARSE_CHUNK_HEADER);
+  view.setUint16(0, type, true);
+  view.setUint16(2, 0, true);
+  view.setUint32(4, blocks, true);
+  view.setUint32(8, totalSize, true);
+}
+
+function isErased(data: Uint8Array): boolean {
+  for (let i = 0; i < data.length; i++) {
+    if (data[i] !== 0xff) return false;
+  }
+  return true;
+}
+
+/**
+ * Shared erase-by-overwrite for file-backed devices, which have no native
+ * erase: a block full of 0xFF is written in its place.
+ */
+function erasedBlock(blockSize: number): Uint8Array {
+  return new Uint8Array(blockSize).fill(0xff);
+}
+
+/**
+ * Block device over an OPFS `FileSystemSyncAccessHandle`
+ * (from `fileHandle.createSyncAccessHandle()` in a worker).
+ * Regions past the end of the file read as erased.
+ */
+export function createSyncAccessHandleDevice(
+  handle: SyncAccessHandleLike,
+  blockSize: number = DEFAULT_BLOCK_SIZE
+): LittleFSBlockDevice {
+  const erased = erasedBlock(blockSize);
+  return {
+    read(block, offset, buffer) {
+      const n = handle.read(buffer, { at: block * blockSize + offset });
+      if (n < buffer.length) buffer.fill(0xff, Math.max(n, 0));
+    },
+    prog(block, offset, data) {
+      handle.write(data, { at: block * blockSize + offset });
+    },
+    erase(block) {
+      handle.write(erased, { at: block * blockSize });
+    },
+    sync() {
+      handle.flush();
+    },
+  };
+}
+
+/**
+ * Block device over a Node file descriptor, e.g.
+ * `createNodeFileDevice(fs, fs.openSync('fs.bin', 'r+'))`.
+ * Regions past the end of the file read as erased.
+ */
+export function createNodeFileDevice(
+  fs: NodeFileSystemLike,
+  fd: number,
+  blockSize: number = DEFAULT_BLOCK_SIZE
+): LittleFSBlockDevice {
+  const erased = erasedBlock(blockSize);
+  return {
+    read(block, offset, buffer) {
+      const n = fs.readSync(fd, buffer, 0, buffer.length, block * blockSize + offset);
+      if (n < buffer.length) buffer.fill(0xff, n);
+    },
+    prog(block, offset, data) {
+      fs.writeSync(fd, data, 0, data.length, block * blockSize + offset);
+    },
+    erase(block) {
+      fs.writeSync(fd, erased, 0, blockSize, block * blockSize);
+    },
+    sync() {
+      fs.fsyncSync(fd);
+    },
+  };
+}
+
+// ============================================================================
+// LittleFS Implementation
+// ============================================================================
+
+class LittleFSImpl implements LittleFS {
+  private openHandles = new Set<LittleFSFileHandleImpl>();
+  private scratch: ScratchArena;
+
+  /**
+   * @param module Shared WASM module (one per realm)
+   * @param ctx Pointer to this instance's lfs_wasm_ctx_t inside the module
+   */
+  constructor(
+    private module: LittleFSModule,
+    private ctx: number,
+    private options: LittleFSOptions = {}
+  ) {
+    this.scratch = new ScratchArena(module);
+  }
+
+  format(): void {
+    checkError(this.module._lfs_wasm_format(this.ctx), 'format');
+    checkError(this.module._lfs_wasm_mount(this.ctx), 'mount after format');
+  }
+
+  list(basePath: string = '/', options?: LittleFSListOptions): LittleFSEntry[] {
+    return this.listTree(basePath, true, options?.attrs);
+  }
+
+  /**
+   * Walk the tree in C and decode the packed entries in a single pass
+   * (see lfs_wasm_list_tree for the layout).
+   */
+  private listTree(dirPath: string, recursive: boolean, attrTypes?: number[]): LittleFSEntry[] {
+    const scratch = this.scratch.reset();
+    const pathPtr = scratch.string(dirPath);
+    let length: number;
+    if (attrTypes?.length) {
+      const typesPtr = scratch.bytes(Uint8Array.from(attrTypes));
+      length = this.module._lfs_wasm_list_tree_attrs(this.ctx, pathPtr, recursive ? 1 : 0, typesPtr, attrTypes.length);
+    } else {
+      length = this.module._lfs_wasm_list_tree(this.ctx, pathPtr, recursive ? 1 : 0);
+    }
+    checkError(length, `open directory '${dirPath}'`);
+
+    const entries: LittleFSEntry[] = [];
+    if (length === 0) return entries;
+
+    const ptr = this.module._lfs_wasm_list_buffer(this.ctx);
+    const heap = this.module.HEAPU8;
+    const view = new DataView(heap.buffer, heap.byteOffset + ptr, length);
+
+    let offset = 0;
+    while (offset < length) {
+      const type = view.getUint8(offset);
+      const size = view.getUint32(offset + 1, true);
+      const pathLength = view.getUint16(offset + 5, true);
+      const start = ptr + offset + LIST_ENTRY_HEADER;
+      const path = utf8Decoder.decode(heap.subarray(start, start + pathLength));
+
+      const entry: LittleFSEntry = type === 2 ? { path, size: 0, type: 'dir' } : { path, size, type: 'file' };
+      offset += LIST_ENTRY_HEADER + pathLength;
+
+      if (attrTypes?.length) {
+        // u8 count, then the attributes that are set
+        const attrs: LittleFSAttributes = {};
+        const count = view.getUint8(offset++);
+        for (let i = 0; i < count; i++) {
+          const attrSize = view.getUint16(offset + 1, true);
+          const value = ptr + offset + ATTR_RECORD_HEADER;
+          attrs[view.getUint8(offset)] = heap.slice(value, value + attrSize);
+          offset += ATTR_RECORD_HEADER + attrSize;
+        }
+        entry.attrs = attrs;
+      }
+      entries.push(entry);
+    }
+    return entries;
+  }
 
   addFile(path: string, data: FileSource): void {
     this.writeFile(path, data);
   }
 
-  writeFile(path: string, data: FileSource): void {
+  writeFile(path: string, data: FileSource, options?: { attrs?: Record<number, FileSource> }): void {
     const bytes = toUint8Array(data);
-    const pathPtr = allocString(this.module, path);
-    const dataPtr = allocBuffer(this.module, bytes);
+    const scratch = this.scratch.reset();
+    const pathPtr = scratch.string(path);
+    const dataPtr = scratch.bytes(bytes);
+    try {
+      let err: number;
+      if (options?.attrs) {
+        const attrs = packAttrs(options.attrs);
+        const attrsPtr = scratch.bytes(attrs);
+        err = this.module._lfs_wasm_write_file_attrs(this.ctx, pathPtr, dataPtr, bytes.length, attrsPtr, attrs.length);
+      } else {
+        err = this.module._lfs_wasm_write_file(this.ctx, pathPtr, dataPtr, bytes.length);
+      }
+      checkError(err, `write file '${path}'`);
+    } finally {
+      // Release a large payload now rather than on the next call
+      scratch.reset();
+    }
+  }
+
+  writeFiles(files: Iterable<LittleFSFileEntry>): void {
+    const prepared = Array.from(files, (file) => {
+      const slash = file.path.lastIndexOf('/');
+      return {
+        path: file.path,
+        dir: slash > 0 ? file.path.slice(0, slash) : '',
+        pathBytes: utf8Encoder.encode(file.path),
+        attrs: packAttrs(file.attrs),
+        data: toUint8Array(file.data),
+      };
+    });
+
+    // Group by directory so parent mkdirs and metadata commits stay local
+    prepared.sort((a, b) =>
+      a.dir < b.dir ? -1 : a.dir > b.dir ? 1 : a.path < b.path ? -1 : a.path > b.path ? 1 : 0
+    );
+
+    let start = 0;
+    while (start < prepared.length) {
+      // Fill one packed buffer up to BATCH_MAX_BYTES (always at least one file)
+      let end = start;
+      let manifestLen = 0;
+      let payloadLen = 0;
+      const entryLen = (i: number) => BATCH_ENTRY_HEADER + prepared[i].pathBytes.length + prepared[i].attrs.length;
+      do {
+        manifestLen += entryLen(end);
+        payloadLen += prepared[end].data.length;
+        end++;
+      } while (
+        end < prepared.length &&
+        manifestLen + payloadLen + entryLen(end) + prepared[end].data.length <= BATCH_MAX_BYTES
+      );
+
+      const bufPtr = this.module._malloc(manifestLen + payloadLen);
+      if (!bufPtr) {
+        checkError(LFS_ERR_NOMEM, `write file '${prepared[start].path}'`);
+      }
+
+      try {
+        const heap = this.module.HEAPU8;
+        const view = new DataView(heap.buffer, heap.byteOffset + bufPtr, manifestLen);
+        let m = 0;
+        let d = bufPtr + manifestLen;
+        for (let i = start; i < end; i++) {
+          const { pathBytes, attrs, data } = prepared[i];
+          view.setUint32(m, data.length, true);
+          view.setUint16(m + 4, pathBytes.length, true);
+          view.setUint16(m + 6, attrs.length, true);
+          heap.set(pathBytes, bufPtr + m + BATCH_ENTRY_HEADER);
+          heap.set(attrs, bufPtr + m + BATCH_ENTRY_HEADER + pathBytes.length);
+          m += BATCH_ENTRY_HEADER + pathBytes.length + attrs.length;
+          heap.set(data, d);
+          d += data.length;
+        }
+
+        const res = this.module._lfs_wasm_write_files(this.ctx, bufPtr, manifestLen, end - start);
+        if (res < 0) {
+          const failed = prepared[start + this.module._lfs_wasm_batch_progress(this.ctx)];
+          checkError(res, `write file '${failed ? failed.path : prepared[start].path}'`);
+        }
+      } finally {
+        this.module._free(bufPtr);
+      }
+
+      start = end;
+    }
+  }
+
+  readFile(path: string): Uint8Array {
+    // One path lookup: the C side sizes the buffer from the open file
+    const dataPtr = this.module._lfs_wasm_read_file_alloc(this.ctx, this.scratch.reset().string(path));
+    const size = this.module._lfs_wasm_read_result(this.ctx);
+    checkError(size, `read file '${path}'`);
+    if (!dataPtr) {
+      return new Uint8Array(0);
+    }
+
+    try {
+      // Copy data out
+      return this.module.HEAPU8.slice(dataPtr, dataPtr + size);
+    } finally {
+      this.module._free(dataPtr);
+    }
+  }
+
+  readFiles(paths: string[]): Uint8Array[] {
+    const { module } = this;
+    if (paths.length === 0) return [];
+
+    const encoded = paths.map((path) => utf8Encoder.encode(path + '\0'));
+    const pathsPtr = module._malloc(encoded.reduce((sum, path) => sum + path.length, 0));
+    let offset = pathsPtr;
+    for (const path of encoded) {
+      module.HEAPU8.set(path, offset);
+      offset += path.length;
+    }
+    // One lfs_wasm_read_slot_t per path: u32 data pointer, i32 size
+    const outPtr = module._malloc(paths.length * 8);
 
     try {
       checkError(
-        this.module._lfs_wasm_write_file(pathPtr, dataPtr, bytes.length),
-        `write file '${path}'`
+        module._lfs_wasm_read_files(this.ctx, pathsPtr, paths.length, this.readThreads(), outPtr),
+        'read files'
       );
+      // Buffers malloc'd on a pthread may lie past the views' old end
+      refreshHeapViews(module);
+
+      // Copy every buffer out (and free it) before reporting a failure
+      const files: Uint8Array[] = [];
+      let failed = -1;
+      for (let i = 0; i < paths.length; i++) {
+        const dataPtr = module.HEAPU32[(outPtr >> 2) + 2 * i];
+        const size = module.HEAP32[(outPtr >> 2) + 2 * i + 1];
+        if (size < 0 && failed < 0) failed = i;
+        files.push(dataPtr ? module.HEAPU8.slice(dataPtr, dataPtr + size) : new Uint8Array(0));
+        if (dataPtr) module._free(dataPtr);
+      }
+      if (failed >= 0) {
+        checkError(module.HEAP32[(outPtr >> 2) + 2 * failed + 1], `read file '${paths[failed]}'`);
+      }
+      return files;
     } finally {
-      this.module._free(pathPtr);
-      this.module._free(dataPtr);
+      module._free(pathsPtr);
+      module._free(outPtr);
+    }
+  }
+
+  /**
+   * Threads per readFiles() batch; the C side reads sequentially in
+   * builds without thread support
+   */
+  private readThreads(): number {
+    const { threads, variant } = this.options;
+    if (threads === false || (!threads && variant !== 'threads')) return 1;
+    const hardware = typeof navigator !== 'undefined' ? navigator.hardwareConcurrency : 0;
+    const limit = typeof threads === 'number' ? threads : hardware || 4;
+    return Math.max(1, Math.min(limit, MAX_READ_THREADS));
+  }
+
+  openFile(
+    path: string,
+    mode: LittleFSOpenMode = 'r',
+    options?: LittleFSStreamOptions
+  ): LittleFSFileHandle {
+    const flags = OPEN_FLAGS[mode];
+    if (flags === undefined) {
+      checkError(LFS_ERR_INVAL, `open file '${path}'`);
+    }
+
+    const handle = this.module._lfs_wasm_file_open(this.ctx, this.scratch.reset().string(path), flags);
+    checkError(handle, `open file '${path}'`);
+
+    const file = new LittleFSFileHandleImpl(
+      this.module,
+      this.ctx,
+      handle,
+      path,
+      options?.chunkSize ?? DEFAULT_CHUNK_SIZE,
+      (f) => this.openHandles.delete(f)
+    );
+    this.openHandles.add(file);
+    return file;
+  }
+
+  createReadStream(path: string, options?: LittleFSStreamOptions): ReadableStream<Uint8Array> {
+    const chunkSize = options?.chunkSize ?? DEFAULT_CHUNK_SIZE;
+    let file: LittleFSFileHandle | null = null;
+
+    return new ReadableStream<Uint8Array>({
+      start: () => {
+        file = this.openFile(path, 'r', { chunkSize });
+      },
+      pull: (controller) => {
+        const chunk = new Uint8Array(chunkSize);
+        const n = file!.read(chunk);
+        if (n > 0) {
+          controller.enqueue(n === chunkSize ? chunk : chunk.slice(0, n));
+        }
+        if (n < chunkSize) {
+          file!.close();
+          controller.close();
+        }
+      },
+      cancel: () => {
+        file?.close();
+      },
+    });
+  }
+
+  createWriteStream(path: string, options?: LittleFSStreamOptions): WritableStream<Uint8Array> {
+    let file: LittleFSFileHandle | null = null;
+
+    return new WritableStream<Uint8Array>({
+      start: () => {
+        file = this.openFile(path, 'w', options);
+      },
+      write: (chunk) => {
+        file!.write(chunk);
+      },
+      close: () => {
+        file!.close();
+      },
+      abort: () => {
+        file?.close();
+      },
+    });
+  }
+
+  deleteFile(path: string): void {
+    this.delete(path);
+  }
+
+  delete(path: string, options?: { recursive?: boolean }): void {
+    const pathPtr = this.scratch.reset().string(path);
+    // A recursive delete is one depth-first walk in C
+    const err = options?.recursive
+      ? this.module._lfs_wasm_remove_tree(this.ctx, pathPtr)
+      : this.module._lfs_wasm_remove(this.ctx, pathPtr);
+    checkError(err, `delete '${path}'`);
+  }
+
+  mkdir(path: string): void {
+    const err = this.module._lfs_wasm_mkdir(this.ctx, this.scratch.reset().string(path));
+    // Ignore "already exists" error
+    if (err !== 0 && err !== LFS_ERR_EXIST) {
+      checkError(err, `mkdir '${path}'`);
+    }
+  }
+
+  rename(oldPath: string, newPath: string): void {
+    const scratch = this.scratch.reset();
+    const oldPtr = scratch.string(oldPath);
+    const newPtr = scratch.string(newPath);
+    checkError(
+      this.module._lfs_wasm_rename(this.ctx, oldPtr, newPtr),
+      `rename '${oldPath}' to '${newPath}'`
+    );
+  }
+
+  copy(from: string, to: string, options: LittleFSCopyOptions = {}): number {
+    return this.treeOp('copy', from, to, Uint8Array.from(options.attrs ?? DEFAULT_CARRIED_ATTRS));
+  }
+
+  move(from: string, to: string): void {
+    this.treeOp('move', from, to);
+  }
+
+  private treeOp(op: 'copy' | 'move', from: string, to: string, types = new Uint8Array(0)): number {
+    const scratch = this.scratch.reset();
+    const fromPtr = scratch.string(from);
+    const toPtr = scratch.string(to);
+    const result =
+      op === 'copy'
+        ? this.module._lfs_wasm_copy_tree(this.ctx, fromPtr, toPtr, scratch.bytes(types), types.length)
+        : this.module._lfs_wasm_move_tree(this.ctx, fromPtr, toPtr);
+    checkError(result, `${op} '${from}' to '${to}'`);
+    return result;
+  }
+
+  toImage(): Uint8Array {
+    const backend = this.module._lfs_wasm_get_backend(this.ctx);
+    if (backend === BACKEND_RAM) {
+      // Copy the data (don't return a view into WASM memory)
+      return this.toImageView().slice();
+    }
+    this.assertResident(backend, 'export image');
+    const blockSize = this.module._lfs_wasm_get_block_size(this.ctx);
+    return this.copyBlocks(0, this.module._lfs_wasm_get_image_size(this.ctx) / blockSize, blockSize);
+  }
+
+  toImageView(): Uint8Array {
+    const ptr = this.module._lfs_wasm_get_image(this.ctx);
+    if (!ptr) {
+      throw new LittleFSError('export image view: Image is not contiguous in WASM memory', LFS_ERR_INVAL);
+    }
+    const size = this.module._lfs_wasm_get_image_size(this.ctx);
+    return this.module.HEAPU8.subarray(ptr, ptr + size);
+  }
+
+  private assertResident(backend: number, context: string): void {
+    if (backend === BACKEND_EXTERNAL) {
+      throw new LittleFSError(`${context}: Image is not in WASM memory (external block device)`, LFS_ERR_INVAL);
+    }
+  }
+
+  /**
+   * Copy `count` blocks starting at `first` out of RAM or sparse storage;
+   * erased blocks are filled in rather than read.
+   */
+  private copyBlocks(first: number, count: number, blockSize: number): Uint8Array {
+    const out = new Uint8Array(count * blockSize).fill(0xff);
+    for (let i = 0; i < count; i++) {
+      const ptr = this.module._lfs_wasm_block_data(this.ctx, first + i);
+      if (ptr) {
+        out.set(this.module.HEAPU8.subarray(ptr, ptr + blockSize), i * blockSize);
+      }
+    }
+    return out;
+  }
+
+  getDirtyBlocks(): number[] {
+    const mapPtr = this.module._lfs_wasm_get_dirty_map(this.ctx);
+    if (!mapPtr) return [];
+
+    const blockSize = this.module._lfs_wasm_get_block_size(this.ctx);
+    const blockCount = this.module._lfs_wasm_get_image_size(this.ctx) / blockSize;
+    const map = this.module.HEAPU8.subarray(mapPtr, mapPtr + ((blockCount + 7) >> 3));
+
+    const blocks: number[] = [];
+    for (let i = 0; i < map.length; i++) {
+      const bits = map[i];
+      if (bits === 0) continue;
+      for (let bit = 0; bit < 8; bit++) {
+        if (bits & (1 << bit)) blocks.push(i * 8 + bit);
+      }
+    }
+    return blocks;
+  }
+
+  clearDirtyBlocks(): void {
+    this.module._lfs_wasm_clear_dirty(this.ctx);
+  }
+
+  exportDelta(options?: { clear?: boolean }): LittleFSDeltaRange[] {
+    this.assertResident(this.module._lfs_wasm_get_backend(this.ctx), 'export delta');
+    const blockSize = this.module._lfs_wasm_get_block_size(this.ctx);
+
+    const ranges: LittleFSDeltaRange[] = blockRuns(this.getDirtyBlocks()).map(([first, count]) => ({
+      offset: first * blockSize,
+      data: this.copyBlocks(first, count, blockSize),
+    }));
+
+    if (options?.clear) {
+      this.clearDirtyBlocks();
     }
+    return ranges;
   }
 
-  readFile(path: string): Uint8Array {
-    const pathPtr = allocString(this.module, path);
+  exportSparse(): LittleFSSparseImage {
+    this.assertResident(this.module._lfs_wasm_get_backend(this.ctx), 'export sparse');
+    const blockSize = this.module._lfs_wasm_get_block_size(this.ctx);
+    const size = this.module._lfs_wasm_get_image_size(this.ctx);
 
-    try {
-      // First get file size
-      const size = this.module._lfs_wasm_file_size(pathPtr);
-      checkError(size, `stat file '${path}'`);
+    const used: number[] = [];
+    for (let block = 0; block < size / blockSize; block++) {
+      if (this.module._lfs_wasm_block_data(this.ctx, block)) used.push(block);
+    }
 
-      if (size === 0) {
-        return new Uint8Array(0);
-      }
+    const ranges = blockRuns(used).map(([first, count]) => ({
+      offset: first * blockSize,
+      data: this.copyBlocks(first, count, blockSize),
+    }));
+    return { size, blockSize, ranges };
+  }
 
-      // Allocate buffer and read
-      const outPtr = this.module._malloc(size);
-      try {
-        const bytesRead = this.module._lfs_wasm_read_file(pathPtr, outPtr, size);
-        checkError(bytesRead, `read file '${path}'`);
+  exportStream(options: LittleFSExportStreamOptions = {}): ReadableStream<Uint8Array> {
+    this.assertResident(this.module._lfs_wasm_get_backend(this.ctx), 'export stream');
+    const format = options.format ?? 'raw';
+    const blockSize = this.module._lfs_wasm_get_block_size(this.ctx);
+    const blockCount = this.module._lfs_wasm_get_image_size(this.ctx) / blockSize;
+    const chunkBlocks = Math.max(1, Math.floor((options.chunkSize ?? DEFAULT_CHUNK_SIZE) / blockSize));
 
-        // Copy data out
-        const result = new Uint8Array(bytesRead);
-        result.set(this.module.HEAPU8.subarray(outPtr, outPtr + bytesRead));
-        return result;
-      } finally {
-        this.module._free(outPtr);
+    let pieces: Iterator<Uint8Array>;
+    if (format === 'sparse') {
+      if (blockSize % 4) {
+        throw new LittleFSError('export stream: Sparse images need a block size that is a multiple of 4', LFS_ERR_INVAL);
       }
-    } finally {
-      this.module._free(pathPtr);
+      pieces = this.sparsePieces(blockSize, blockCount, chunkBlocks);
+    } else if (format === 'raw' || format === 'deflate') {
+      pieces = this.rawPieces(blockSize, blockCount, chunkBlocks);
+    } else {
+      throw new LittleFSError(`export stream: Unknown format '${format}'`, LFS_ERR_INVAL);
+    }
+
+    const stream = new ReadableStream<Uint8Array>({
+      pull: (controller) => {
+        const next = pieces.next();
+        if (next.done) {
+          controller.close();
+        } else {
+          controller.enqueue(next.value);
+        }
+      },
+    });
+    if (format !== 'deflate') return stream;
+
+    if (typeof CompressionStream === 'undefined') {
+      throw new LittleFSError('export stream: CompressionStream is not available', LFS_ERR_INVAL);
     }
+    // The platform's zlib compresses far better than anything small enough
+    // to ship in the module; backpressure keeps one chunk in flight
+    return stream.pipeThrough(new CompressionStream('deflate'));
   }
 
-  deleteFile(path: string): void {
-    this.delete(path);
+  private *rawPieces(blockSize: number, blockCount: number, chunkBlocks: number): Generator<Uint8Array> {
+    for (let first = 0; first < blockCount; first += chunkBlocks) {
+      yield this.copyBlocks(first, Math.min(chunkBlocks, blockCount - first), blockSize);
+    }
   }
 
-  delete(path: string, options?: { recursive?: boolean }): void {
-    if (options?.recursive) {
-      // List all entries and delete from deepest first
-      const entries = this.list(path);
-      entries.sort((a, b) => b.path.length - a.path.length);
-      
-      for (const entry of entries) {
-        const ptr = allocString(this.module, entry.path);
-        try {
-          this.module._lfs_wasm_remove(ptr);
-        } finally {
-          this.module._free(ptr);
-        }
+  /**
+   * Android sparse image: a file header, then RAW chunks of at most
+   * `chunkBlocks` blocks and one FILL chunk per erased run. The header
+   * holds the chunk count, so the runs are found before the first chunk.
+   */
+  private *sparsePieces(blockSize: number, blockCount: number, chunkBlocks: number): Generator<Uint8Array> {
+    const runs: Array<[number, number, boolean]> = [];
+    for (let block = 0; block < blockCount; block++) {
+      const resident = this.module._lfs_wasm_block_data(this.ctx, block) !== 0;
+      const last = runs[runs.length - 1];
+      if (last && last[2] === resident) {
+        last[1]++;
+      } else {
+        runs.push([block, 1, resident]);
       }
     }
+    let chunks = 0;
+    for (const [, count, resident] of runs) {
+      chunks += resident ? Math.ceil(count / chunkBlocks) : 1;
+    }
 
-    const pathPtr = allocString(this.module, path);
-    try {
-      checkError(this.module._lfs_wasm_remove(pathPtr), `delete '${path}'`);
-    } finally {
-      this.module._free(pathPtr);
+    const header = new Uint8Array(SPARSE_FILE_HEADER);
+    const view = new DataView(header.buffer);
+    view.setUint32(0, SPARSE_MAGIC, true);
+    view.setUint16(4, 1, true); // major version
+    view.setUint16(6, 0, true); // minor version
+    view.setUint16(8, SPARSE_FILE_HEADER, true);
+    view.setUint16(10, SPARSE_CHUNK_HEADER, true);
+    view.setUint32(12, blockSize, true);
+    view.setUint32(16, blockCount, true);
+    view.setUint32(20, chunks, true);
+    view.setUint32(24, 0, true); // no image checksum
+    yield header;
+
+    for (const [first, count, resident] of runs) {
+      if (!resident) {
+        const fill = new Uint8Array(SPARSE_CHUNK_HEADER + 4);
+        sparseChunkHeader(fill, SPARSE_CHUNK_FILL, count, fill.length);
+        fill.fill(0xff, SPARSE_CHUNK_HEADER);
+        yield fill;
+        continue;
+      }
+      for (let block = first; block < first + count; block += chunkBlocks) {
+        const n = Math.min(chunkBlocks, first + count - block);
+        const chunk = new Uint8Array(SPARSE_CHUNK_HEADER + n * blockSize);
+        sparseChunkHeader(chunk, SPARSE_CHUNK_RAW, n, chunk.length);
+        chunk.set(this.copyBlocks(block, n, blockSize), SPARSE_CHUNK_HEADER);
+        yield chunk;
+      }
     }
   }
 
-  mkdir(path: string): void {
-    const pathPtr = allocString(this.module, path);
+  repack(options: LittleFSRepackOptions = {}): Uint8Array {
+    const { module } = this;
+    const size = module._lfs_wasm_get_image_size(this.ctx);
+    const blockSize = options.blockSize ?? module._lfs_wasm_get_block_size(this.ctx);
+    const blockCount = options.blockCount ?? Math.floor(size / blockSize);
+    const merged: LittleFSOptions = { ...this.options, ...options };
+
+    const target = createContext(module);
     try {
-      const err = this.module._lfs_wasm_mkdir(pathPtr);
-      // Ignore "already exists" error
-      if (err !== 0 && err !== -4) {
-        checkError(err, `mkdir '${path}'`);
+      const lookahead = applyTuning(module, target, merged);
+      // Without an explicit version the source's is kept
+      if (merged.diskVersion !== undefined) {
+        module._lfs_wasm_set_disk_version(target, merged.diskVersion);
       }
+      checkError(module._lfs_wasm_init(target, blockSize, blockCount, lookahead), 'repack');
+      const types = Uint8Array.from(options.attrs ?? DEFAULT_CARRIED_ATTRS);
+      const typesPtr = this.scratch.reset().bytes(types);
+      checkError(module._lfs_wasm_repack(target, this.ctx, typesPtr, types.length), 'repack');
+      const ptr = module._lfs_wasm_get_image(target);
+      return module.HEAPU8.slice(ptr, ptr + module._lfs_wasm_get_image_size(target));
     } finally {
-      this.module._free(pathPtr);
+      module._lfs_wasm_ctx_destroy(target);
     }
   }
 
-  rename(oldPath: string, newPath: string): void {
-    const oldPtr = allocString(this.module, oldPath);
-    const newPtr = allocString(this.module, newPath);
-    try {
-      checkError(
-        this.module._lfs_wasm_rename(oldPtr, newPtr),
-        `rename '${oldPath}' to '${newPath}'`
-      );
-    } finally {
-      this.module._free(oldPtr);
-      this.module._free(newPtr);
+  resize(blockCount: number): void {
+    checkError(this.module._lfs_wasm_resize(this.ctx, blockCount), 'resize');
+  }
+
+  snapshot(): LittleFSSnapshot {
+    const id = this.module._lfs_wasm_snapshot(this.ctx);
+    checkError(id, 'snapshot');
+    return { id };
+  }
+
+  restore(snapshot: LittleFSSnapshot): void {
+    // The C side closes the handles; just release their staging buffers
+    for (const file of this.openHandles) {
+      file.detach();
     }
+    this.openHandles.clear();
+    checkError(this.module._lfs_wasm_restore(this.ctx, snapshot.id), 'restore snapshot');
   }
 
-  toImage(): Uint8Array {
-    const ptr = this.module._lfs_wasm_get_image();
-    const size = this.module._lfs_wasm_get_image_size();
-    
-    // Copy the data (don't return a view into WASM memory)
-    const result = new Uint8Array(size);
-    result.set(this.module.HEAPU8.subarray(ptr, ptr + size));
-    return result;
+  releaseSnapshot(snapshot: LittleFSSnapshot): void {
+    checkError(this.module._lfs_wasm_snapshot_release(this.ctx, snapshot.id), 'release snapshot');
   }
 
-  getUsage(): { used: number; total: number; free: number } {
-    const usedPtr = this.module._malloc(4);
-    const totalPtr = this.module._malloc(4);
+  getSnapshotSize(snapshot: LittleFSSnapshot): number {
+    const blocks = this.module._lfs_wasm_snapshot_blocks(this.ctx, snapshot.id);
+    checkError(blocks, 'snapshot size');
+    return blocks * this.module._lfs_wasm_get_block_size(this.ctx);
+  }
+
+  /**
+   * Another instance's context, which must live in this module
+   */
+  private peerContext(other: LittleFS, context: string): number {
+    if (!(other instanceof LittleFSImpl) || other.module !== this.module) {
+      throw new LittleFSError(`${context}: filesystem from another module`, LFS_ERR_INVAL);
+    }
+    return other.ctx;
+  }
+
+  diff(target: LittleFS, options: LittleFSSyncOptions = {}): LittleFSChange[] {
+    const { module } = this;
+    const types = Uint8Array.from(options.attrs ?? []);
+    const typesPtr = this.scratch.reset().bytes(types);
+    const length = module._lfs_wasm_diff(this.ctx, this.peerContext(target, 'diff'), typesPtr, types.length);
+    checkError(length, 'diff');
+
+    const changes: LittleFSChange[] = [];
+    if (length === 0) return changes;
+
+    // Change set layout: u8 op, then a listing entry (see listTree)
+    const ptr = module._lfs_wasm_list_buffer(this.ctx);
+    const heap = module.HEAPU8;
+    const view = new DataView(heap.buffer, heap.byteOffset + ptr, length);
+
+    let offset = 0;
+    while (offset < length) {
+      const op = CHANGE_OPS[view.getUint8(offset)]!;
+      const type = view.getUint8(offset + 1);
+      const size = view.getUint32(offset + 2, true);
+      const pathLength = view.getUint16(offset + 6, true);
+      const start = ptr + offset + 1 + LIST_ENTRY_HEADER;
+      const path = utf8Decoder.decode(heap.subarray(start, start + pathLength));
+
+      changes.push({ op, path, type: type === 2 ? 'dir' : 'file', size: type === 2 ? 0 : size });
+      offset += 1 + LIST_ENTRY_HEADER + pathLength;
+    }
+    return changes;
+  }
+
+  applyChanges(changes: LittleFSChange[], source: LittleFS, options: LittleFSSyncOptions = {}): number {
+    const { module } = this;
+    const sourceCtx = this.peerContext(source, 'apply changes');
+    if (changes.length === 0) return 0;
+
+    const paths = changes.map((change) => utf8Encoder.encode(change.path));
+    const length = paths.reduce((sum, path) => sum + 1 + LIST_ENTRY_HEADER + path.length, 0);
+    const ptr = module._malloc(length);
 
     try {
-      checkError(this.module._lfs_wasm_fs_stat(usedPtr, totalPtr), 'get usage');
-      
-      const used = this.module.HEAPU32[usedPtr >> 2];
-      const total = this.module.HEAPU32[totalPtr >> 2];
-      
-      return {
-        used,
-        total,
-        free: total - used,
-      };
+      const heap = module.HEAPU8;
+      const view = new DataView(heap.buffer, heap.byteOffset + ptr, length);
+      let offset = 0;
+      changes.forEach((change, i) => {
+        const op = CHANGE_OPS.indexOf(change.op);
+        if (op < 1) throw new LittleFSError(`apply changes: Unknown op '${change.op}'`, LFS_ERR_INVAL);
+        view.setUint8(offset, op);
+        view.setUint8(offset + 1, change.type === 'dir' ? 2 : 1);
+        view.setUint32(offset + 2, change.size, true);
+        view.setUint16(offset + 6, paths[i].length, true);
+        heap.set(paths[i], ptr + offset + 1 + LIST_ENTRY_HEADER);
+        offset += 1 + LIST_ENTRY_HEADER + paths[i].length;
+      });
+
+      const types = Uint8Array.from(options.attrs ?? DEFAULT_CARRIED_ATTRS);
+      const typesPtr = this.scratch.reset().bytes(types);
+      const applied = module._lfs_wasm_apply(this.ctx, sourceCtx, ptr, length, typesPtr, types.length);
+      checkError(applied, 'apply changes');
+      return applied;
     } finally {
-      this.module._free(usedPtr);
-      this.module._free(totalPtr);
+      module._free(ptr);
     }
   }
 
+  getUsage(): { used: number; total: number; free: number } {
+    const scratch = this.scratch.reset();
+    const usedPtr = scratch.u32();
+    const totalPtr = scratch.u32();
+    checkError(this.module._lfs_wasm_fs_stat(this.ctx, usedPtr, totalPtr), 'get usage');
+
+    const used = this.module.HEAPU32[usedPtr >> 2];
+    const total = this.module.HEAPU32[totalPtr >> 2];
+
+    return {
+      used,
+      total,
+      free: total - used,
+    };
+  }
+
+  getAttr(path: string, type: number): Uint8Array | null {
+    const scratch = this.scratch.reset();
+    const pathPtr = scratch.string(path);
+    const outPtr = scratch.alloc(ATTR_MAX);
+    const size = this.module._lfs_wasm_getattr(this.ctx, pathPtr, type, outPtr, ATTR_MAX);
+    if (size === LFS_ERR_NOATTR) return null;
+    checkError(size, `get attribute ${type} of '${path}'`);
+    return this.module.HEAPU8.slice(outPtr, outPtr + Math.min(size, ATTR_MAX));
+  }
+
+  setAttr(path: string, type: number, value: FileSource): void {
+    const data = toUint8Array(value);
+    const scratch = this.scratch.reset();
+    const pathPtr = scratch.string(path);
+    const dataPtr = scratch.bytes(data);
+    checkError(
+      this.module._lfs_wasm_setattr(this.ctx, pathPtr, type, dataPtr, data.length),
+      `set attribute ${type} of '${path}'`
+    );
+  }
+
+  removeAttr(path: string, type: number): void {
+    checkError(
+      this.module._lfs_wasm_removeattr(this.ctx, this.scratch.reset().string(path), type),
+      `remove attribute ${type} of '${path}'`
+    );
+  }
+
+  check(): LittleFSCheckReport {
+    return runCheck(this.module, this.ctx);
+  }
+
+  optimize(options: { compactThreshold?: number } = {}): number {
+    const rewritten = this.module._lfs_wasm_optimize(this.ctx, options.compactThreshold ?? -1);
+    checkError(rewritten, 'optimize');
+    return rewritten;
+  }
+
   getDiskVersion(): number {
-    const versionPtr = this.module._malloc(4);
-    try {
-      checkError(this.module._lfs_wasm_get_fs_info(versionPtr), 'get disk version');
-      return this.module.HEAPU32[versionPtr >> 2];
-    } finally {
-      this.module._free(versionPtr);
+    const versionPtr = this.scratch.reset().u32();
+    checkError(this.module._lfs_wasm_get_fs_info(this.ctx, versionPtr), 'get disk version');
+    return this.module.HEAPU32[versionPtr >> 2];
+  }
+
+  enableIOStats(options: { traceSize?: number } = {}): void {
+    checkError(this.module._lfs_wasm_io_enable(this.ctx, options.traceSize ?? 0), 'enable I/O stats');
+  }
+
+  disableIOStats(): void {
+    this.module._lfs_wasm_io_disable(this.ctx);
+  }
+
+  resetIOStats(): void {
+    this.module._lfs_wasm_io_reset(this.ctx);
+  }
+
+  getIOStats(): LittleFSIOStats {
+    const statsPtr = this.module._lfs_wasm_io_stats(this.ctx);
+    if (!statsPtr) {
+      checkError(LFS_ERR_INVAL, 'get I/O stats');
+    }
+    // u64 counts[4] then u64 bytes[4]; exact up to 2^53
+    const heap = this.module.HEAPU32;
+    const u64 = (index: number) =>
+      heap[(statsPtr >> 2) + index * 2] + heap[(statsPtr >> 2) + index * 2 + 1] * 2 ** 32;
+
+    const blockSize = this.module._lfs_wasm_get_block_size(this.ctx);
+    const blockCount = this.module._lfs_wasm_get_image_size(this.ctx) / blockSize;
+    const countsPtr = this.module._lfs_wasm_io_erase_counts(this.ctx);
+    const eraseCounts = heap.slice(countsPtr >> 2, (countsPtr >> 2) + blockCount);
+    let maxBlockErases = 0;
+    for (const count of eraseCounts) {
+      if (count > maxBlockErases) maxBlockErases = count;
+    }
+
+    return {
+      reads: { count: u64(0), bytes: u64(4) },
+      progs: { count: u64(1), bytes: u64(5) },
+      erases: { count: u64(2), bytes: u64(6) },
+      syncs: { count: u64(3) },
+      eraseCounts,
+      maxBlockErases,
+      traceRecords: Math.min(
+        this.module._lfs_wasm_io_trace_total(this.ctx),
+        this.module._lfs_wasm_io_trace_capacity(this.ctx)
+      ),
+    };
+  }
+
+  exportIOTrace(): string {
+    const tracePtr = this.module._lfs_wasm_io_trace(this.ctx);
+    if (!tracePtr) {
+      checkError(LFS_ERR_INVAL, 'export I/O trace');
     }
+    const total = this.module._lfs_wasm_io_trace_total(this.ctx) >>> 0;
+    const capacity = this.module._lfs_wasm_io_trace_capacity(this.ctx);
+    const records = Math.min(total, capacity);
+    const blockSize = this.module._lfs_wasm_get_block_size(this.ctx);
+    const blockCount = this.module._lfs_wasm_get_image_size(this.ctx) / blockSize;
+
+    // Same shape as lfs_emubd's LFS_EMUBD_TRACE output
+    const prefix = 'littlefs_wasm.c:0:trace: ';
+    const cfg = `0x${this.ctx.toString(16)}`;
+    const hex = (value: number) => `0x${value.toString(16)}`;
+    const lines = [`${prefix}lfs_wasm_bd_create(block_size=${blockSize}, block_count=${blockCount})`];
+    const heap = this.module.HEAPU32;
+    for (let i = 0; i < records; i++) {
+      const rec = (tracePtr >> 2) + ((total - records + i) % capacity) * 4;
+      const [op, block, off, size] = [heap[rec], heap[rec + 1], heap[rec + 2], heap[rec + 3]];
+      switch (op) {
+        case IO_OP_READ:
+          lines.push(`${prefix}lfs_wasm_bd_read(${cfg}, ${hex(block)}, ${off}, 0x0, ${size})`);
+          break;
+        case IO_OP_PROG:
+          lines.push(`${prefix}lfs_wasm_bd_prog(${cfg}, ${hex(block)}, ${off}, 0x0, ${size})`);
+          break;
+        case IO_OP_ERASE:
+          lines.push(`${prefix}lfs_wasm_bd_erase(${cfg}, ${hex(block)} (${size}))`);
+          break;
+        default:
+          lines.push(`${prefix}lfs_wasm_bd_sync(${cfg})`);
+      }
+    }
+    return lines.join('\n') + '\n';
+  }
+
+  enableFaults(options: LittleFSFaultOptions = {}): void {
+    enableFaults(this.module, this.ctx, options);
+  }
+
+  disableFaults(): void {
+    this.module._lfs_wasm_fault_disable(this.ctx);
+  }
+
+  schedulePowerLoss(after: number | null, mode?: 'atomic' | 'torn'): void {
+    checkError(
+      this.module._lfs_wasm_fault_arm(this.ctx, after ?? FAULT_NEVER, powerLossMode(mode)),
+      'schedule power loss'
+    );
+  }
+
+  setBadBlock(block: number, bad = true): void {
+    checkError(this.module._lfs_wasm_fault_bad_block(this.ctx, block, bad ? 1 : 0), `mark block ${block}`);
+  }
+
+  getFaultState(): LittleFSFaultState {
+    const opsPtr = this.scratch.reset().u32();
+    const lost = this.module._lfs_wasm_fault_state(this.ctx, opsPtr);
+    checkError(lost, 'get fault state');
+    return { powerLost: lost === 1, operations: this.module.HEAPU32[opsPtr >> 2] };
+  }
+
+  powerCycle(): void {
+    // The C side drops the handles; just release their staging buffers
+    for (const file of this.openHandles) {
+      file.detach();
+    }
+    this.openHandles.clear();
+    checkError(this.module._lfs_wasm_power_cycle(this.ctx), 'power cycle');
   }
 
   destroy(): void {
-    this.module._lfs_wasm_cleanup();
+    if (!this.ctx) return;
+    // The C side closes the handles; just release their staging buffers
+    for (const file of this.openHandles) {
+      file.detach();
+    }
+    this.openHandles.clear();
+    this.module._lfs_wasm_ctx_destroy(this.ctx);
+    blockDevices.delete(this.ctx);
+    this.scratch.destroy();
+    this.ctx = 0;
   }
 }
 
@@ -426,51 +2703,487 @@ class LittleFSImpl implements LittleFS {
 // Public API
 // ============================================================================
 
+/**
+ * Allocate a fresh filesystem context inside the shared module
+ */
+function createContext(module: LittleFSModule): number {
+  const ctx = module._lfs_wasm_ctx_create();
+  if (!ctx) {
+    checkError(LFS_ERR_NOMEM, 'create context');
+  }
+  return ctx;
+}
+
 export async function createLittleFS(options: LittleFSOptions = {}): Promise<LittleFS> {
-  const module = await loadModule(options.wasmURL);
-  
-  const blockSize = options.blockSize ?? 4096;
-  const blockCount = options.blockCount ?? 256;
-  const lookahead = options.lookaheadSize ?? 32;
+  const blockSize = options.blockSize ?? DEFAULT_BLOCK_SIZE;
+  const blockCount = options.blockCount ?? DEFAULT_BLOCK_COUNT;
+
+  const module = await loadModule(options, options.sparse ? 0 : blockSize * blockCount);
+  const ctx = createContext(module);
+
+  try {
+    const lookahead = applyTuning(module, ctx, options);
+
+    // Set disk version before init if specified
+    // This prevents automatic migration of older filesystems
+    if (options.diskVersion !== undefined) {
+      module._lfs_wasm_set_disk_version(ctx, options.diskVersion);
+    }
+
+    checkError(
+      options.sparse
+        ? module._lfs_wasm_init_sparse(ctx, blockSize, blockCount, lookahead)
+        : module._lfs_wasm_init(ctx, blockSize, blockCount, lookahead),
+      'init'
+    );
+    
+    applyInstrumentation(module, ctx, options);
+
+    if (options.formatOnInit) {
+      checkError(module._lfs_wasm_format(ctx), 'format');
+    }
+    
+    checkError(module._lfs_wasm_mount(ctx), 'mount');
+  } catch (error) {
+    module._lfs_wasm_ctx_destroy(ctx);
+    throw error;
+  }
+
+  return new LittleFSImpl(module, ctx, options);
+}
+
+/**
+ * Hand a filled heap buffer to a fresh context and mount it.
+ * The RAM block device adopts the buffer on success; on failure it is
+ * freed here together with the context.
+ */
+function adoptImage(
+  module: LittleFSModule,
+  ctx: number,
+  imagePtr: number,
+  imageSize: number,
+  options: LittleFSOptions
+): LittleFS {
+  try {
+    const lookahead = applyTuning(module, ctx, options);
+
+    const err = module._lfs_wasm_init_adopt(
+      ctx,
+      imagePtr,
+      imageSize,
+      options.blockSize ?? 0,
+      options.blockCount ?? 0,
+      lookahead
+    );
+    if (err < 0) {
+      module._free(imagePtr);
+      checkError(err, 'init from image');
+    }
 
-  // Set disk version before init if specified
-  // This prevents automatic migration of older filesystems
-  if (options.diskVersion !== undefined) {
-    module._lfs_wasm_set_disk_version(options.diskVersion);
+    applyInstrumentation(module, ctx, options);
+
+    checkError(module._lfs_wasm_mount(ctx), 'mount');
+  } catch (error) {
+    module._lfs_wasm_ctx_destroy(ctx);
+    throw error;
   }
 
-  checkError(module._lfs_wasm_init(blockSize, blockCount, lookahead), 'init');
-  
-  if (options.formatOnInit) {
-    checkError(module._lfs_wasm_format(), 'format');
+  return new LittleFSImpl(module, ctx, options);
+}
+
+/**
+ * Mount an image held as ranges in JS on a sparse context, copying only
+ * the blocks that are not erased.
+ */
+function loadSparse(
+  module: LittleFSModule,
+  ctx: number,
+  size: number,
+  ranges: Iterable<LittleFSDeltaRange>,
+  options: LittleFSOptions
+): LittleFS {
+  try {
+    const blockSize = options.blockSize ?? DEFAULT_BLOCK_SIZE;
+    const blockCount = options.blockCount ?? Math.floor(size / blockSize);
+    const lookahead = applyTuning(module, ctx, options);
+    checkError(module._lfs_wasm_init_sparse(ctx, blockSize, blockCount, lookahead), 'init sparse');
+
+    for (const { offset, data } of ranges) {
+      if (offset % blockSize) {
+        throw new LittleFSError('init sparse: Range offset is not block aligned', LFS_ERR_INVAL);
+      }
+      for (let pos = 0; pos < data.length; pos += blockSize) {
+        const index = (offset + pos) / blockSize;
+        // Like init_from_image, bytes past the partition are ignored
+        if (index >= blockCount) break;
+        const block = data.subarray(pos, pos + blockSize);
+        if (isErased(block)) continue;
+        const ptr = module._lfs_wasm_block_alloc(ctx, index);
+        if (!ptr) checkError(LFS_ERR_NOMEM, 'init sparse');
+        module.HEAPU8.set(block, ptr);
+      }
+    }
+
+    applyInstrumentation(module, ctx, options);
+
+    checkError(module._lfs_wasm_mount(ctx), 'mount');
+  } catch (error) {
+    module._lfs_wasm_ctx_destroy(ctx);
+    throw error;
   }
-  
-  checkError(module._lfs_wasm_mount(), 'mount');
 
-  return new LittleFSImpl(module);
+  return new LittleFSImpl(module, ctx, options);
 }
 
+/**
+ * Mount a copy of an image. `image` may be a promise (e.g. from `fetch()`),
+ * in which case the WASM module compiles while the image downloads and is
+ * instantiated with room for it once its size is known.
+ */
 export async function createLittleFSFromImage(
-  image: BinarySource,
+  image: BinarySource | PromiseLike<BinarySource>,
+  options: LittleFSOptions = {}
+): Promise<LittleFS> {
+  // Reported by loadModule() below if it fails
+  compileShared(options).catch(() => {});
+  const source = await image;
+  const imageData = source instanceof ArrayBuffer ? new Uint8Array(source) : source;
+
+  const module = await loadModule(options, options.sparse ? 0 : imageData.length);
+  const ctx = createContext(module);
+
+  if (options.sparse) {
+    return loadSparse(module, ctx, imageData.length, [{ offset: 0, data: imageData }], options);
+  }
+
+  // Copy once into the heap; the block device then uses that buffer directly
+  const imagePtr = module._malloc(imageData.length);
+  if (!imagePtr) {
+    module._lfs_wasm_ctx_destroy(ctx);
+    checkError(LFS_ERR_NOMEM, 'allocate image');
+  }
+  module.HEAPU8.set(imageData, imagePtr);
+
+  return adoptImage(module, ctx, imagePtr, imageData.length, options);
+}
+
+/**
+ * Create a LittleFS instance by streaming an image straight into WASM memory.
+ * The heap region is allocated once up front and filled chunk by chunk, so
+ * the image is never buffered in JS. Bytes not supplied by the stream are
+ * left erased (0xFF).
+ *
+ * @param source Image chunks, e.g. `response.body` or a Node read stream
+ * @param imageSize Total image size in bytes
+ */
+export async function createLittleFSFromStream(
+  source: ReadableStream<Uint8Array> | AsyncIterable<Uint8Array>,
+  imageSize: number,
   options: LittleFSOptions = {}
 ): Promise<LittleFS> {
-  const module = await loadModule(options.wasmURL);
-  
-  const imageData = image instanceof ArrayBuffer ? new Uint8Array(image) : image;
-  const imagePtr = allocBuffer(module, imageData);
-  
+  const module = await loadModule(options, imageSize);
+  const ctx = createContext(module);
+
+  const imagePtr = module._malloc(imageSize);
+  if (!imagePtr) {
+    module._lfs_wasm_ctx_destroy(ctx);
+    checkError(LFS_ERR_NOMEM, 'allocate image');
+  }
+
+  let offset = 0;
+  try {
+    const write = (chunk: Uint8Array) => {
+      if (offset + chunk.length > imageSize) {
+        throw new LittleFSError('init from stream: Image larger than declared size', LFS_ERR_FBIG);
+      }
+      // Re-read HEAPU8 per chunk: another instance may have grown memory
+      module.HEAPU8.set(chunk, imagePtr + offset);
+      offset += chunk.length;
+    };
+
+    if ('getReader' in source) {
+      const reader = source.getReader();
+      try {
+        while (true) {
+          const { done, value } = await reader.read();
+          if (done) break;
+          write(value);
+        }
+      } finally {
+        reader.releaseLock();
+      }
+    } else {
+      for await (const chunk of source) {
+        write(chunk);
+      }
+    }
+  } catch (error) {
+    module._free(imagePtr);
+    module._lfs_wasm_ctx_destroy(ctx);
+    throw error;
+  }
+
+  if (offset < imageSize) {
+    module.HEAPU8.fill(0xff, imagePtr + offset, imagePtr + imageSize);
+  }
+
+  return adoptImage(module, ctx, imagePtr, imageSize, options);
+}
+
+/**
+ * Create a LittleFS instance on a JS block device instead of a heap image,
+ * e.g. an OPFS file via `createSyncAccessHandleDevice()` or a Node file via
+ * `createNodeFileDevice()`. Only a small block cache lives in WASM memory,
+ * so the partition size is bounded by the backing store, not the heap.
+ */
+export async function createLittleFSOnDevice(
+  device: LittleFSBlockDevice,
+  options: LittleFSDeviceOptions = {}
+): Promise<LittleFS> {
+  const module = await loadModule(options);
+  const ctx = createContext(module);
+
+  const blockSize = options.blockSize ?? DEFAULT_BLOCK_SIZE;
+  const blockCount = options.blockCount ?? DEFAULT_BLOCK_COUNT;
+
   try {
+    registerBlockDevice(module, ctx, device);
+    const lookahead = applyTuning(module, ctx, options);
+
+    if (options.diskVersion !== undefined) {
+      module._lfs_wasm_set_disk_version(ctx, options.diskVersion);
+    }
+
     checkError(
-      module._lfs_wasm_init_from_image(imagePtr, imageData.length, options.blockSize ?? 0),
-      'init from image'
+      module._lfs_wasm_init_external(
+        ctx,
+        blockSize,
+        blockCount,
+        lookahead,
+        options.cacheBlocks ?? DEFAULT_CACHE_BLOCKS
+      ),
+      'init device'
     );
+
+    applyInstrumentation(module, ctx, options);
+
+    if (options.formatOnInit) {
+      checkError(module._lfs_wasm_format(ctx), 'format');
+    }
+
+    checkError(module._lfs_wasm_mount(ctx), 'mount');
+  } catch (error) {
+    module._lfs_wasm_ctx_destroy(ctx);
+    blockDevices.delete(ctx);
+    throw error;
+  }
+
+  return new LittleFSImpl(module, ctx, options);
+}
+
+/**
+ * Create a LittleFS instance from `exportSparse()` output. Storage is sparse
+ * regardless of `options.sparse`; geometry defaults to the exported one.
+ */
+export async function createLittleFSFromSparse(
+  image: LittleFSSparseImage,
+  options: LittleFSOptions = {}
+): Promise<LittleFS> {
+  const module = await loadModule(options);
+  const ctx = createContext(module);
+  return loadSparse(module, ctx, image.size, image.ranges, {
+    blockSize: image.blockSize,
+    ...options,
+  });
+}
+
+/**
+ * Changes between two images, e.g. a device dump and a build output.
+ * Both are mounted side by side in the shared module and compared in one
+ * native pass; see `LittleFS.diff()` (`options.attrs` is passed on).
+ *
+ * @example
+ * ```typescript
+ * const changes = await diffImages(deviceDump, buildImage, { blockSize: 4096 });
+ * console.log(changes.filter((c) => c.op !== 'removed').map((c) => c.path));
+ * ```
+ */
+export async function diffImages(
+  a: BinarySource,
+  b: BinarySource,
+  options: LittleFSOptions & LittleFSSyncOptions = {}
+): Promise<LittleFSChange[]> {
+  const before = await createLittleFSFromImage(a, options);
+  try {
+    const after = await createLittleFSFromImage(b, options);
+    try {
+      return before.diff(after, options);
+    } finally {
+      after.destroy();
+    }
   } finally {
-    module._free(imagePtr);
+    before.destroy();
+  }
+}
+
+/**
+ * Check many images (e.g. device dumps from the field) with one context and
+ * one heap buffer. Each image is mounted in place without prog or erase, so
+ * nothing is allocated or written per image; see `LittleFS.check()`.
+ * An image that fails to mount is reported with the error on `/`.
+ *
+ * @example
+ * ```typescript
+ * const reports = await checkImages(dumps, { blockSize: 4096 });
+ * reports.forEach((r, i) => r.ok || console.warn(i, r.errors));
+ * ```
+ */
+export async function checkImages(
+  images: Iterable<BinarySource>,
+  options: LittleFSOptions = {}
+): Promise<LittleFSCheckReport[]> {
+  const module = await loadModule(options);
+  const ctx = createContext(module);
+  let bufferPtr = 0;
+  let bufferSize = 0;
+
+  try {
+    const lookahead = applyTuning(module, ctx, options);
+    const reports: LittleFSCheckReport[] = [];
+
+    for (const image of images) {
+      const data = image instanceof ArrayBuffer ? new Uint8Array(image) : image;
+      if (data.length > bufferSize) {
+        module._free(bufferPtr);
+        bufferPtr = module._malloc(data.length);
+        bufferSize = bufferPtr ? data.length : 0;
+        if (!bufferPtr) checkError(LFS_ERR_NOMEM, 'allocate image');
+      }
+      module.HEAPU8.set(data, bufferPtr);
+
+      let err = module._lfs_wasm_init_borrow(
+        ctx,
+        bufferPtr,
+        data.length,
+        options.blockSize ?? 0,
+        options.blockCount ?? 0,
+        lookahead
+      );
+      if (err >= 0) err = module._lfs_wasm_mount(ctx);
+      if (err < 0) {
+        reports.push({
+          ok: false,
+          entries: [],
+          errors: [{ path: '/', code: err, message: errorMessage(err) }],
+          traverseError: err,
+          usedBlocks: 0,
+          outOfRangeBlocks: 0,
+          sharedBlocks: 0,
+          unreferencedBlocks: 0,
+        });
+        continue;
+      }
+      reports.push(runCheck(module, ctx));
+    }
+    return reports;
+  } finally {
+    // The context borrows the buffer, so it goes first
+    module._lfs_wasm_ctx_destroy(ctx);
+    module._free(bufferPtr);
+  }
+}
+
+export interface LittleFSPowerLossOptions {
+  /**
+   * Validate the remounted filesystem after each cut; throw to report a
+   * failure. By default every file is read back.
+   */
+  check?: (fs: LittleFS, cutAfter: number) => void;
+  /** Test every `step`-th cut point (default 1, i.e. all of them). */
+  step?: number;
+  mode?: 'atomic' | 'torn';
+}
+
+export interface LittleFSPowerLossReport {
+  /** Progs and erases of one uninterrupted run of the update. */
+  operations: number;
+  /** Cut points tested. */
+  runs: number;
+  failures: Array<{ cutAfter: number; error: unknown }>;
+}
+
+/**
+ * Cut power at every prog and erase of an update in turn and check that
+ * the filesystem remounts each time. The starting state is captured with
+ * `snapshot()`, so each run rolls back only the blocks the last one wrote.
+ * `update` must be deterministic. Faults are enabled if they aren't
+ * already; `fs` is left as it was before the call.
+ *
+ * @example
+ * ```typescript
+ * const report = sweepPowerLoss(fs, (fs) => fs.writeFile('/config.json', next), {
+ *   check: (fs) => JSON.parse(new TextDecoder().decode(fs.readFile('/config.json'))),
+ * });
+ * if (report.failures.length) throw report.failures[0].error;
+ * ```
+ */
+export function sweepPowerLoss(
+  fs: LittleFS,
+  update: (fs: LittleFS) => void,
+  options: LittleFSPowerLossOptions = {}
+): LittleFSPowerLossReport {
+  const step = Math.max(1, Math.floor(options.step ?? 1));
+  const check =
+    options.check ??
+    ((fs: LittleFS) => {
+      for (const entry of fs.list('/')) {
+        if (entry.type === 'file') fs.readFile(entry.path);
+      }
+    });
+
+  let enabled = false;
+  try {
+    fs.getFaultState();
+  } catch {
+    fs.enableFaults();
+    enabled = true;
   }
-  
-  checkError(module._lfs_wasm_mount(), 'mount');
 
-  return new LittleFSImpl(module);
+  const start = fs.snapshot();
+  try {
+    fs.schedulePowerLoss(null);
+    update(fs);
+    const operations = fs.getFaultState().operations;
+    fs.restore(start);
+
+    const failures: LittleFSPowerLossReport['failures'] = [];
+    let runs = 0;
+    for (let cutAfter = 0; cutAfter < operations; cutAfter += step) {
+      runs++;
+      fs.schedulePowerLoss(cutAfter, options.mode);
+      try {
+        update(fs);
+      } catch (error) {
+        // Errors are expected once the power is gone, not before
+        if (!fs.getFaultState().powerLost) failures.push({ cutAfter, error });
+      }
+      let remounted = false;
+      try {
+        fs.powerCycle();
+        remounted = true;
+        check(fs, cutAfter);
+      } catch (error) {
+        failures.push({ cutAfter, error });
+      }
+      fs.restore(start);
+      // restore() only remounts a mounted filesystem
+      if (!remounted) fs.powerCycle();
+    }
+    return { operations, runs, failures };
+  } finally {
+    fs.releaseSnapshot(start);
+    if (enabled) fs.disableFaults();
+  }
 }
 
 // Re-export types
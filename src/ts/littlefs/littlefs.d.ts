@@ -2,30 +2,103 @@
 
 declare module '*/littlefs.js' {
   interface LittleFSModule extends EmscriptenModule {
-    _lfs_wasm_init(blockSize: number, blockCount: number, lookahead: number): number;
-    _lfs_wasm_init_from_image(imagePtr: number, imageSize: number, blockSize: number): number;
-    _lfs_wasm_mount(): number;
-    _lfs_wasm_unmount(): number;
-    _lfs_wasm_format(): number;
-    _lfs_wasm_mkdir(pathPtr: number): number;
-    _lfs_wasm_remove(pathPtr: number): number;
-    _lfs_wasm_rename(oldPtr: number, newPtr: number): number;
-    _lfs_wasm_stat(pathPtr: number, typePtr: number, sizePtr: number): number;
-    _lfs_wasm_dir_open(pathPtr: number): number;
-    _lfs_wasm_dir_read(handle: number, namePtr: number, nameLen: number, typePtr: number, sizePtr: number): number;
-    _lfs_wasm_dir_close(handle: number): number;
-    _lfs_wasm_write_file(pathPtr: number, dataPtr: number, size: number): number;
-    _lfs_wasm_read_file(pathPtr: number, outPtr: number, maxSize: number): number;
-    _lfs_wasm_file_size(pathPtr: number): number;
-    _lfs_wasm_get_image(): number;
-    _lfs_wasm_get_image_size(): number;
-    _lfs_wasm_fs_stat(usedPtr: number, totalPtr: number): number;
-    _lfs_wasm_cleanup(): void;
+    _lfs_wasm_ctx_create(): number;
+    _lfs_wasm_ctx_destroy(ctx: number): void;
+    _lfs_wasm_init(ctx: number, blockSize: number, blockCount: number, lookahead: number): number;
+    _lfs_wasm_set_tuning(ctx: number, readSize: number, progSize: number, cacheSize: number, blockCycles: number, compactThresh: number, metadataMax: number, inlineMax: number, nameMax: number): void;
+    _lfs_wasm_init_from_image(ctx: number, imagePtr: number, imageSize: number, blockSize: number, blockCount: number, lookahead: number): number;
+    _lfs_wasm_init_adopt(ctx: number, imagePtr: number, imageSize: number, blockSize: number, blockCount: number, lookahead: number): number;
+    _lfs_wasm_init_borrow(ctx: number, imagePtr: number, imageSize: number, blockSize: number, blockCount: number, lookahead: number): number;
+    _lfs_wasm_set_read_only(ctx: number, readOnly: number): void;
+    _lfs_wasm_init_sparse(ctx: number, blockSize: number, blockCount: number, lookahead: number): number;
+    _lfs_wasm_init_external(ctx: number, blockSize: number, blockCount: number, lookahead: number, cacheBlocks: number): number;
+    _lfs_wasm_mount(ctx: number): number;
+    _lfs_wasm_unmount(ctx: number): number;
+    _lfs_wasm_format(ctx: number): number;
+    _lfs_wasm_mkdir(ctx: number, pathPtr: number): number;
+    _lfs_wasm_remove(ctx: number, pathPtr: number): number;
+    _lfs_wasm_rename(ctx: number, oldPtr: number, newPtr: number): number;
+    _lfs_wasm_remove_tree(ctx: number, pathPtr: number): number;
+    _lfs_wasm_copy_tree(ctx: number, fromPtr: number, toPtr: number, typesPtr: number, typeCount: number): number;
+    _lfs_wasm_move_tree(ctx: number, fromPtr: number, toPtr: number): number;
+    _lfs_wasm_stat(ctx: number, pathPtr: number, typePtr: number, sizePtr: number): number;
+    _lfs_wasm_dir_open(ctx: number, pathPtr: number): number;
+    _lfs_wasm_dir_read(ctx: number, handle: number, namePtr: number, nameLen: number, typePtr: number, sizePtr: number): number;
+    _lfs_wasm_dir_close(ctx: number, handle: number): number;
+    _lfs_wasm_list_tree(ctx: number, pathPtr: number, recursive: number): number;
+    _lfs_wasm_list_tree_attrs(ctx: number, pathPtr: number, recursive: number, typesPtr: number, typeCount: number): number;
+    _lfs_wasm_list_buffer(ctx: number): number;
+    _lfs_wasm_check(ctx: number, summaryPtr: number): number;
+    _lfs_wasm_file_open(ctx: number, pathPtr: number, flags: number): number;
+    _lfs_wasm_file_read(ctx: number, handle: number, outPtr: number, size: number): number;
+    _lfs_wasm_file_write(ctx: number, handle: number, dataPtr: number, size: number): number;
+    _lfs_wasm_file_seek(ctx: number, handle: number, offset: number, whence: number): number;
+    _lfs_wasm_file_tell(ctx: number, handle: number): number;
+    _lfs_wasm_file_length(ctx: number, handle: number): number;
+    _lfs_wasm_file_truncate(ctx: number, handle: number, size: number): number;
+    _lfs_wasm_file_sync(ctx: number, handle: number): number;
+    _lfs_wasm_file_close(ctx: number, handle: number): number;
+    _lfs_wasm_write_file(ctx: number, pathPtr: number, dataPtr: number, size: number): number;
+    _lfs_wasm_write_file_attrs(ctx: number, pathPtr: number, dataPtr: number, size: number, attrsPtr: number, attrsLen: number): number;
+    _lfs_wasm_getattr(ctx: number, pathPtr: number, type: number, outPtr: number, size: number): number;
+    _lfs_wasm_setattr(ctx: number, pathPtr: number, type: number, dataPtr: number, size: number): number;
+    _lfs_wasm_removeattr(ctx: number, pathPtr: number, type: number): number;
+    _lfs_wasm_write_files(ctx: number, bufPtr: number, manifestLen: number, count: number): number;
+    _lfs_wasm_batch_progress(ctx: number): number;
+    _lfs_wasm_read_file(ctx: number, pathPtr: number, outPtr: number, maxSize: number): number;
+    _lfs_wasm_file_size(ctx: number, pathPtr: number): number;
+    _lfs_wasm_read_file_alloc(ctx: number, pathPtr: number): number;
+    _lfs_wasm_read_result(ctx: number): number;
+    _lfs_wasm_read_files(ctx: number, pathsPtr: number, count: number, threads: number, outPtr: number): number;
+    _lfs_wasm_set_dir_cache(ctx: number, enabled: number): void;
+    _lfs_wasm_get_image(ctx: number): number;
+    _lfs_wasm_get_image_size(ctx: number): number;
+    _lfs_wasm_get_block_size(ctx: number): number;
+    _lfs_wasm_get_backend(ctx: number): number;
+    _lfs_wasm_get_storage_bytes(ctx: number): number;
+    _lfs_wasm_block_data(ctx: number, block: number): number;
+    _lfs_wasm_block_alloc(ctx: number, block: number): number;
+    _lfs_wasm_get_dirty_map(ctx: number): number;
+    _lfs_wasm_clear_dirty(ctx: number): void;
+    _lfs_wasm_io_enable(ctx: number, traceCap: number): number;
+    _lfs_wasm_io_disable(ctx: number): void;
+    _lfs_wasm_io_reset(ctx: number): void;
+    _lfs_wasm_io_stats(ctx: number): number;
+    _lfs_wasm_io_erase_counts(ctx: number): number;
+    _lfs_wasm_io_trace(ctx: number): number;
+    _lfs_wasm_io_trace_total(ctx: number): number;
+    _lfs_wasm_io_trace_capacity(ctx: number): number;
+    _lfs_wasm_fault_enable(ctx: number): number;
+    _lfs_wasm_fault_disable(ctx: number): void;
+    _lfs_wasm_fault_arm(ctx: number, after: number, mode: number): number;
+    _lfs_wasm_fault_wear(ctx: number, eraseCycles: number, behavior: number): number;
+    _lfs_wasm_fault_bad_block(ctx: number, block: number, bad: number): number;
+    _lfs_wasm_fault_state(ctx: number, opsPtr: number): number;
+    _lfs_wasm_power_cycle(ctx: number): number;
+    _lfs_wasm_optimize(ctx: number, compactThresh: number): number;
+    _lfs_wasm_repack(dst: number, src: number, typesPtr: number, typeCount: number): number;
+    _lfs_wasm_resize(ctx: number, blockCount: number): number;
+    _lfs_wasm_diff(a: number, b: number, typesPtr: number, typeCount: number): number;
+    _lfs_wasm_snapshot(ctx: number): number;
+    _lfs_wasm_restore(ctx: number, id: number): number;
+    _lfs_wasm_snapshot_release(ctx: number, id: number): number;
+    _lfs_wasm_snapshot_blocks(ctx: number, id: number): number;
+    _lfs_wasm_apply(
+      dst: number,
+      src: number,
+      changesPtr: number,
+      length: number,
+      typesPtr: number,
+      typeCount: number
+    ): number;
+    _lfs_wasm_fs_stat(ctx: number, usedPtr: number, totalPtr: number): number;
+    _lfs_wasm_cleanup(ctx: number): void;
     _malloc(size: number): number;
     _free(ptr: number): void;
     HEAPU8: Uint8Array;
     HEAPU32: Uint32Array;
     HEAP32: Int32Array;
+    lfsBlockDevice?: (ctx: number, op: number, block: number, offset: number, ptr: number, size: number) => number;
   }
 
   type ModuleFactory = (config?: Partial<EmscriptenModule>) => Promise<LittleFSModule>;
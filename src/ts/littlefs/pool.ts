@@ -0,0 +1,212 @@
+/**
+ * Pool of LittleFS workers for building many images in parallel
+ *
+ * The WASM module is fetched and compiled once on the calling thread and
+ * posted to every worker, so adding workers costs one instantiation each.
+ */
+
+import { compileLittleFSModule, type LittleFSOptions } from './index';
+import { WorkerClient, spawnWorker } from './remote';
+import type { CloneableOptions, LittleFSBuildJob } from './rpc';
+
+// ============================================================================
+// Types
+// ============================================================================
+
+export interface LittleFSPoolOptions extends Pick<LittleFSOptions, 'wasmURL' | 'simd' | 'variant' | 'wasmCache'> {
+  /** Number of workers (default `navigator.hardwareConcurrency`, at least 1). */
+  size?: number;
+  /** Worker factory, e.g. for bundlers; defaults to `worker.js` next to this module. */
+  createWorker?: () => Worker;
+  /**
+   * Transfer job file data to the workers instead of copying it.
+   * The caller's buffers are detached. Default true.
+   */
+  transfer?: boolean;
+}
+
+export interface LittleFSPoolStats {
+  /** Jobs completed successfully. */
+  jobs: number;
+  /** Jobs that failed. */
+  failed: number;
+  /** Total bytes of images produced. */
+  bytes: number;
+  /** Wall time from the first job starting to the last one finishing. */
+  elapsedMs: number;
+  jobsPerSecond: number;
+  bytesPerSecond: number;
+  /** Per-worker completed jobs and time spent busy, to judge core scaling. */
+  workers: Array<{ jobs: number; busyMs: number }>;
+}
+
+export interface LittleFSPool {
+  readonly size: number;
+  /** Queue one image build; resolves with the image, transferred from the worker. */
+  build(job: LittleFSBuildJob): Promise<Uint8Array>;
+  /** Queue several builds; resolves with the images in job order. */
+  buildAll(jobs: Iterable<LittleFSBuildJob>): Promise<Uint8Array[]>;
+  stats(): LittleFSPoolStats;
+  /** Terminate all workers; queued jobs are rejected. */
+  close(): void;
+}
+
+// ============================================================================
+// Implementation
+// ============================================================================
+
+interface QueuedJob {
+  job: LittleFSBuildJob;
+  resolve(image: Uint8Array): void;
+  reject(error: unknown): void;
+}
+
+interface PoolWorker {
+  client: WorkerClient;
+  busy: boolean;
+  jobs: number;
+  busyMs: number;
+}
+
+const now = () => (typeof performance !== 'undefined' ? performance.now() : Date.now());
+
+class LittleFSPoolImpl implements LittleFSPool {
+  private queue: QueuedJob[] = [];
+  private closed = false;
+  private completed = 0;
+  private failed = 0;
+  private bytes = 0;
+  private firstStart = 0;
+  private lastEnd = 0;
+
+  constructor(private workers: PoolWorker[], private loadOptions: CloneableOptions) {}
+
+  get size(): number {
+    return this.workers.length;
+  }
+
+  build(job: LittleFSBuildJob): Promise<Uint8Array> {
+    if (this.closed) {
+      return Promise.reject(new Error('LittleFS pool is closed'));
+    }
+    return new Promise<Uint8Array>((resolve, reject) => {
+      this.queue.push({ job, resolve, reject });
+      this.dispatch();
+    });
+  }
+
+  buildAll(jobs: Iterable<LittleFSBuildJob>): Promise<Uint8Array[]> {
+    return Promise.all(Array.from(jobs, (job) => this.build(job)));
+  }
+
+  /**
+   * Hand queued jobs to idle workers. Workers pull from one shared queue as
+   * they finish, so a slow job never holds up jobs queued behind it.
+   */
+  private dispatch(): void {
+    for (const worker of this.workers) {
+      if (this.queue.length === 0) return;
+      if (!worker.busy) this.run(worker, this.queue.shift()!);
+    }
+  }
+
+  private run(worker: PoolWorker, queued: QueuedJob): void {
+    worker.busy = true;
+    const start = now();
+    if (!this.firstStart) this.firstStart = start;
+
+    const job: LittleFSBuildJob = {
+      files: queued.job.files,
+      options: { ...this.loadOptions, ...queued.job.options },
+    };
+
+    worker.client
+      .send<Uint8Array>({ op: 'build', job })
+      .then(
+        (image) => {
+          this.completed++;
+          this.bytes += image.length;
+          worker.jobs++;
+          queued.resolve(image);
+        },
+        (error) => {
+          this.failed++;
+          queued.reject(error);
+        }
+      )
+      .finally(() => {
+        const end = now();
+        worker.busy = false;
+        worker.busyMs += end - start;
+        this.lastEnd = end;
+        if (!this.closed) this.dispatch();
+      });
+  }
+
+  stats(): LittleFSPoolStats {
+    const elapsedMs = this.firstStart ? this.lastEnd - this.firstStart : 0;
+    const seconds = elapsedMs / 1000;
+    return {
+      jobs: this.completed,
+      failed: this.failed,
+      bytes: this.bytes,
+      elapsedMs,
+      jobsPerSecond: seconds > 0 ? this.completed / seconds : 0,
+      bytesPerSecond: seconds > 0 ? this.bytes / seconds : 0,
+      workers: this.workers.map(({ jobs, busyMs }) => ({ jobs, busyMs })),
+    };
+  }
+
+  close(): void {
+    if (this.closed) return;
+    this.closed = true;
+    for (const queued of this.queue) {
+      queued.reject(new Error('LittleFS pool is closed'));
+    }
+    this.queue = [];
+    for (const worker of this.workers) {
+      worker.client.terminate();
+    }
+  }
+}
+
+/**
+ * Create a pool of workers sharing one compiled WASM module.
+ *
+ * @example
+ * ```typescript
+ * const pool = await createLittleFSPool();
+ * const images = await pool.buildAll(
+ *   skus.map((sku) => ({ options: { blockCount: 512 }, files: filesFor(sku) }))
+ * );
+ * console.log(pool.stats().bytesPerSecond);
+ * pool.close();
+ * ```
+ */
+export async function createLittleFSPool(options: LittleFSPoolOptions = {}): Promise<LittleFSPool> {
+  const { module, simd, variant } = await compileLittleFSModule(options);
+  const loadOptions: CloneableOptions = { wasmModule: module, simd, variant };
+
+  const hardware = typeof navigator !== 'undefined' ? navigator.hardwareConcurrency : 0;
+  const size = Math.max(1, options.size ?? (hardware || 1));
+  const createWorker = options.createWorker ?? spawnWorker;
+
+  const workers: PoolWorker[] = [];
+  try {
+    for (let i = 0; i < size; i++) {
+      workers.push({
+        client: new WorkerClient(createWorker(), options.transfer !== false),
+        busy: false,
+        jobs: 0,
+        busyMs: 0,
+      });
+    }
+    // Instantiate everywhere up front so the first jobs aren't skewed
+    await Promise.all(workers.map((w) => w.client.send({ op: 'load', options: loadOptions })));
+  } catch (error) {
+    for (const worker of workers) worker.client.terminate();
+    throw error;
+  }
+
+  return new LittleFSPoolImpl(workers, loadOptions);
+}
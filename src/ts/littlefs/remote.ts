@@ -0,0 +1,172 @@
+/**
+ * LittleFS hosted in a Web Worker
+ *
+ * The page never touches WASM memory: every call is posted to the worker
+ * and resolved from its reply, with binary payloads transferred rather
+ * than copied.
+ */
+
+import { LittleFSError, type LittleFSOptions, type LittleFSSparseImage } from './index';
+import {
+  REMOTE_METHODS,
+  collectTransfers,
+  ownArgs,
+  ownedView,
+  type LittleFSWorkerInit,
+  type Remote,
+  type RemoteMethod,
+  type WorkerRequest,
+  type WorkerRequestBody,
+  type WorkerResponse,
+} from './rpc';
+import type { BinarySource } from '../shared/types';
+
+// ============================================================================
+// Types
+// ============================================================================
+
+/**
+ * Promise-based mirror of `LittleFS` running in a worker. Calls may be
+ * issued without awaiting the previous one; they run in call order.
+ */
+export type LittleFSWorker = Remote<RemoteMethod> & {
+  /** Release the filesystem and terminate the worker. */
+  destroy(): Promise<void>;
+};
+
+export interface LittleFSWorkerOptions extends LittleFSOptions {
+  /** Image to mount instead of creating a fresh filesystem. */
+  image?: BinarySource;
+  /** `exportSparse()` output to mount instead of creating a fresh filesystem. */
+  sparseImage?: LittleFSSparseImage;
+  /**
+   * Use this worker instead of spawning `worker.js` next to this module,
+   * e.g. one created by a bundler's worker loader.
+   */
+  worker?: Worker;
+  /**
+   * Transfer binary arguments (file data, images) to the worker instead of
+   * copying them. The caller's buffers are detached. Default true.
+   */
+  transfer?: boolean;
+}
+
+// ============================================================================
+// Client
+// ============================================================================
+
+const LFS_ERR_IO = -5;
+
+/**
+ * Request/response bookkeeping over one worker
+ */
+export class WorkerClient {
+  private nextId = 1;
+  private pending = new Map<number, { resolve(value: unknown): void; reject(error: unknown): void }>();
+
+  constructor(readonly worker: Worker, private transfer = true) {
+    worker.addEventListener('message', (event: MessageEvent) => {
+      const response = event.data as WorkerResponse;
+      const entry = this.pending.get(response.id);
+      if (!entry) return;
+      this.pending.delete(response.id);
+      if (response.ok) {
+        entry.resolve(response.result);
+      } else {
+        entry.reject(new LittleFSError(response.message, response.code));
+      }
+    });
+    worker.addEventListener('error', (event: ErrorEvent) => {
+      this.failAll(new LittleFSError(`worker: ${event.message}`, LFS_ERR_IO));
+    });
+  }
+
+  /** Number of requests posted but not yet answered. */
+  get inFlight(): number {
+    return this.pending.size;
+  }
+
+  send<T>(request: WorkerRequestBody): Promise<T> {
+    const id = this.nextId++;
+    let message = { ...request, id } as WorkerRequest;
+    let transfer: Transferable[] = [];
+    if (this.transfer) {
+      // Partial views would transfer (and detach) their whole buffer
+      message = ownArgs(message) as WorkerRequest;
+      transfer = collectTransfers(message);
+    }
+    return new Promise<T>((resolve, reject) => {
+      this.pending.set(id, { resolve: resolve as (value: unknown) => void, reject });
+      this.worker.postMessage(message, transfer);
+    });
+  }
+
+  call<T>(method: RemoteMethod, args: unknown[]): Promise<T> {
+    // Iterables such as generators aren't cloneable
+    if (method === 'writeFiles') args = [Array.from(args[0] as Iterable<unknown>)];
+    return this.send<T>({ op: 'call', method, args });
+  }
+
+  failAll(error: unknown): void {
+    for (const entry of this.pending.values()) entry.reject(error);
+    this.pending.clear();
+  }
+
+  terminate(): void {
+    this.worker.terminate();
+    this.failAll(new LittleFSError('worker: Terminated', LFS_ERR_IO));
+  }
+}
+
+/**
+ * Turn a worker init description into a cloneable message payload
+ */
+export function workerInit(options: LittleFSWorkerOptions): LittleFSWorkerInit {
+  const { image, sparseImage, worker: _worker, transfer, wasmURL, ...rest } = options;
+  const data = image ? (image instanceof ArrayBuffer ? new Uint8Array(image) : image) : undefined;
+  return {
+    options: { ...rest, wasmURL: wasmURL ? String(wasmURL) : undefined },
+    image: data && transfer !== false ? ownedView(data) : data,
+    sparseImage,
+  };
+}
+
+export function spawnWorker(): Worker {
+  return new Worker(new URL('./worker.js', import.meta.url), { type: 'module' });
+}
+
+/**
+ * Create a LittleFS instance inside a dedicated Web Worker.
+ *
+ * @example
+ * ```typescript
+ * const fs = await createLittleFSWorker({ blockCount: 2048, formatOnInit: true });
+ * fs.writeFile('/a.bin', a);        // pipelined, no await needed
+ * fs.writeFile('/b.bin', b);
+ * const image = await fs.toImage(); // transferred from the worker
+ * await fs.destroy();
+ * ```
+ */
+export async function createLittleFSWorker(options: LittleFSWorkerOptions = {}): Promise<LittleFSWorker> {
+  const client = new WorkerClient(options.worker ?? spawnWorker(), options.transfer !== false);
+
+  try {
+    await client.send({ op: 'create', init: workerInit(options) });
+  } catch (error) {
+    client.terminate();
+    throw error;
+  }
+
+  const remote = {} as Record<string, unknown>;
+  for (const method of REMOTE_METHODS) {
+    remote[method] = (...args: unknown[]) => client.call(method, args);
+  }
+  remote.destroy = async () => {
+    try {
+      await client.send({ op: 'destroy' });
+    } finally {
+      client.terminate();
+    }
+  };
+  return remote as LittleFSWorker;
+}
@@ -0,0 +1,180 @@
+/**
+ * Message protocol between the page and a LittleFS worker
+ *
+ * Requests are answered in the order they were posted, so callers may
+ * pipeline any number of them without waiting. Binary payloads travel as
+ * transferred ArrayBuffers in both directions.
+ */
+
+import type { LittleFS, LittleFSFileEntry, LittleFSOptions, LittleFSSparseImage } from './index';
+import type { BinarySource } from '../shared/types';
+
+// ============================================================================
+// Types
+// ============================================================================
+
+/**
+ * `LittleFS` methods available through a worker. `toImageView()`,
+ * `openFile()` and the stream adapters hand out live views into WASM memory
+ * and can't cross a thread boundary.
+ */
+export const REMOTE_METHODS = [
+  'format',
+  'list',
+  'addFile',
+  'writeFile',
+  'writeFiles',
+  'deleteFile',
+  'delete',
+  'mkdir',
+  'rename',
+  'copy',
+  'move',
+  'toImage',
+  'getDirtyBlocks',
+  'clearDirtyBlocks',
+  'exportDelta',
+  'exportSparse',
+  'repack',
+  'resize',
+  'snapshot',
+  'restore',
+  'releaseSnapshot',
+  'getSnapshotSize',
+  'readFile',
+  'readFiles',
+  'getUsage',
+  'getAttr',
+  'setAttr',
+  'removeAttr',
+  'check',
+  'optimize',
+  'getDiskVersion',
+  'enableIOStats',
+  'disableIOStats',
+  'getIOStats',
+  'resetIOStats',
+  'exportIOTrace',
+  'enableFaults',
+  'disableFaults',
+  'schedulePowerLoss',
+  'setBadBlock',
+  'getFaultState',
+  'powerCycle',
+] as const;
+
+export type RemoteMethod = (typeof REMOTE_METHODS)[number];
+
+/**
+ * `LittleFSOptions` that survive structured cloning (`wasmURL` as a string)
+ */
+export type CloneableOptions = Omit<LittleFSOptions, 'wasmURL'> & { wasmURL?: string };
+
+/**
+ * What to mount in the worker: a fresh filesystem, an image, or a sparse
+ * export.
+ */
+export interface LittleFSWorkerInit {
+  options: CloneableOptions;
+  image?: BinarySource;
+  sparseImage?: LittleFSSparseImage;
+}
+
+/**
+ * One image build: format a fresh filesystem, write `files`, export.
+ * `formatOnInit` is implied.
+ */
+export interface LittleFSBuildJob {
+  options?: CloneableOptions;
+  files: LittleFSFileEntry[];
+}
+
+export type WorkerRequest =
+  | { id: number; op: 'create'; init: LittleFSWorkerInit }
+  | { id: number; op: 'call'; method: RemoteMethod; args: unknown[] }
+  | { id: number; op: 'destroy' }
+  | { id: number; op: 'load'; options: CloneableOptions }
+  | { id: number; op: 'build'; job: LittleFSBuildJob };
+
+// Omit applied to each member of a union rather than to their common keys
+type OmitEach<T, K extends PropertyKey> = T extends unknown ? Omit<T, K> : never;
+
+// A request before the client assigns its id
+export type WorkerRequestBody = OmitEach<WorkerRequest, 'id'>;
+
+export type WorkerResponse =
+  | { id: number; ok: true; result: unknown }
+  | { id: number; ok: false; message: string; code: number };
+
+/**
+ * Promise-returning mirror of the given `LittleFS` methods
+ */
+export type Remote<K extends keyof LittleFS> = {
+  [M in K]: LittleFS[M] extends (...args: infer A) => infer R ? (...args: A) => Promise<R> : never;
+};
+
+// The slice of DedicatedWorkerGlobalScope / Worker / MessagePort in use
+export interface MessageEndpoint {
+  postMessage(message: unknown, transfer: Transferable[]): void;
+  addEventListener(type: 'message', listener: (event: MessageEvent) => void): void;
+}
+
+// ============================================================================
+// Transfers
+// ============================================================================
+
+// Deep enough for message -> args -> writeFiles array -> entry -> data,
+// and message -> job -> files -> entry -> data
+const MAX_DEPTH = 5;
+
+/**
+ * Make a view safe to transfer: a view that doesn't cover its whole buffer
+ * is copied first, so transferring never detaches unrelated bytes.
+ */
+export function ownedView(data: Uint8Array): Uint8Array {
+  if (
+    data.buffer instanceof ArrayBuffer &&
+    data.byteOffset === 0 &&
+    data.byteLength === data.buffer.byteLength
+  ) {
+    return data;
+  }
+  return data.slice();
+}
+
+/**
+ * Collect the ArrayBuffers under a message value (Uint8Arrays in nested
+ * arrays and plain objects, e.g. `exportDelta()` ranges)
+ */
+export function collectTransfers(value: unknown, out: Transferable[] = [], depth = 0): Transferable[] {
+  if (value instanceof Uint8Array) {
+    if (value.buffer instanceof ArrayBuffer && !out.includes(value.buffer)) {
+      out.push(value.buffer);
+    }
+  } else if (value instanceof ArrayBuffer) {
+    if (!out.includes(value)) out.push(value);
+  } else if (depth < MAX_DEPTH && value && typeof value === 'object') {
+    for (const item of Array.isArray(value) ? value : Object.values(value)) {
+      collectTransfers(item, out, depth + 1);
+    }
+  }
+  return out;
+}
+
+/**
+ * Replace every partial Uint8Array view in a message with an owned copy,
+ * so its buffers can be transferred
+ */
+export function ownArgs(value: unknown, depth = 0): unknown {
+  if (value instanceof Uint8Array) return ownedView(value);
+  if (depth >= MAX_DEPTH || !value || typeof value !== 'object' || value instanceof ArrayBuffer) {
+    return value;
+  }
+  if (Array.isArray(value)) return value.map((item) => ownArgs(item, depth + 1));
+  if (Object.getPrototypeOf(value) !== Object.prototype) return value;
+  const out: Record<string, unknown> = {};
+  for (const [key, item] of Object.entries(value)) {
+    out[key] = ownArgs(item, depth + 1);
+  }
+  return out;
+}
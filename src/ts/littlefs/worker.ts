@@ -0,0 +1,111 @@
+/**
+ * Worker entry point for `createLittleFSWorker()`
+ *
+ * Hosts one LittleFS instance and answers requests from rpc.ts in order.
+ * All WASM memory access happens on this thread.
+ */
+
+import {
+  createLittleFS,
+  createLittleFSFromImage,
+  createLittleFSFromSparse,
+  preloadLittleFS,
+  LittleFSError,
+  type LittleFS,
+  type LittleFSOptions,
+} from './index';
+import {
+  REMOTE_METHODS,
+  collectTransfers,
+  type LittleFSBuildJob,
+  type LittleFSWorkerInit,
+  type MessageEndpoint,
+  type WorkerRequest,
+  type WorkerResponse,
+} from './rpc';
+
+const scope = self as unknown as MessageEndpoint;
+
+// lfs_error codes reported for protocol misuse and non-LittleFS failures
+const LFS_ERR_IO = -5;
+const LFS_ERR_INVAL = -22;
+
+let fs: LittleFS | null = null;
+
+// Requests run strictly one after another, even across async creation
+let queue: Promise<void> = Promise.resolve();
+
+async function mount(init: LittleFSWorkerInit): Promise<void> {
+  fs?.destroy();
+  fs = null;
+
+  const options = init.options as LittleFSOptions;
+  if (init.sparseImage) {
+    fs = await createLittleFSFromSparse(init.sparseImage, options);
+  } else if (init.image) {
+    fs = await createLittleFSFromImage(init.image, options);
+  } else {
+    fs = await createLittleFS(options);
+  }
+}
+
+/**
+ * Run a pool job on its own context, leaving any hosted filesystem alone
+ */
+async function build(job: LittleFSBuildJob): Promise<Uint8Array> {
+  const image = await createLittleFS({ ...(job.options as LittleFSOptions), formatOnInit: true });
+  try {
+    image.writeFiles(job.files);
+    return image.toImage();
+  } finally {
+    image.destroy();
+  }
+}
+
+async function handle(request: WorkerRequest): Promise<unknown> {
+  switch (request.op) {
+    case 'create':
+      await mount(request.init);
+      return undefined;
+    case 'destroy':
+      fs?.destroy();
+      fs = null;
+      return undefined;
+    case 'load':
+      await preloadLittleFS(request.options as LittleFSOptions);
+      return undefined;
+    case 'build':
+      return build(request.job);
+    case 'call': {
+      if (!fs) {
+        throw new LittleFSError(`${request.method}: Filesystem not created`, LFS_ERR_INVAL);
+      }
+      if (!REMOTE_METHODS.includes(request.method)) {
+        throw new LittleFSError(`${request.method}: Not available in a worker`, LFS_ERR_INVAL);
+      }
+      const method = fs[request.method] as (...args: unknown[]) => unknown;
+      return method.apply(fs, request.args);
+    }
+  }
+}
+
+function reply(response: WorkerResponse): void {
+  scope.postMessage(response, response.ok ? collectTransfers(response.result) : []);
+}
+
+scope.addEventListener('message', (event: MessageEvent) => {
+  const request = event.data as WorkerRequest;
+  queue = queue.then(async () => {
+    try {
+      const result = await handle(request);
+      reply({ id: request.id, ok: true, result });
+    } catch (error) {
+      reply({
+        id: request.id,
+        ok: false,
+        message: error instanceof Error ? error.message : String(error),
+        code: error instanceof LittleFSError ? error.code : LFS_ERR_IO,
+      });
+    }
+  });
+});